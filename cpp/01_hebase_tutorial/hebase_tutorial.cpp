@@ -24,6 +24,7 @@
 
 // See more information about this demo in the readme file.
 
+#include <cstdlib>
 #include <iostream>
 
 #include "hebase_tutorial.h"
@@ -48,8 +49,12 @@ int main(int argc, char** argv)
     tut_2_plaintexts();
   else if (arg == "io")
     tut_3_io();
+  else if (arg == "asyncio")
+    tut_4_async_io(argc > 2 ? atoi(argv[2]) : 1000);
+  else if (arg == "container")
+    tut_5_container(argc > 2 ? atoi(argv[2]) : 1000);
   else {
-    cout << "Usage: " << argv[0] << " <tutName>" << endl
+    cout << "Usage: " << argv[0] << " <tutName> [<numCiphertexts>]" << endl
          << "\t<tutName> can be:" << endl;
     help();
   }
@@ -59,6 +64,12 @@ void help()
 {
   cout << "\t\tbasics" << endl
        << "\t\tplaintexts" << endl
-       << "\t\tio" << endl;
+       << "\t\tio" << endl
+       << "\t\tasyncio (optionally followed by the number of ciphertexts, "
+          "default 1000)"
+       << endl
+       << "\t\tcontainer (optionally followed by the number of ciphertexts, "
+          "default 1000)"
+       << endl;
   exit(1);
 }
\ No newline at end of file
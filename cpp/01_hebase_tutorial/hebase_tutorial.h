@@ -28,4 +28,8 @@ void tut_2_plaintexts();
 
 void tut_3_io();
 
+void tut_4_async_io(int numCiphertexts);
+
+void tut_5_container(int numCiphertexts);
+
 void help();
\ No newline at end of file
@@ -0,0 +1,172 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// See more information about this demo in the readme file.
+
+#include <chrono>
+
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/hebase.h"
+#include "AsyncCTileIo.h"
+
+using namespace std;
+using namespace chrono;
+using namespace helayers;
+
+// This tutorial repeats the client/server flow of tut_3_io, but for a batch
+// of many ciphertexts. Instead of alternating between computing and
+// saveToFile/loadFromFile, each stage hands its ciphertexts to a background
+// thread through a bounded queue (see common/AsyncCTileIo.h). This way
+// ciphertext N+1 is computed while ciphertext N is being written, and the
+// next ciphertext is already being loaded while the current one is processed.
+
+void tut_4_clientEncrypt(int numCiphertexts);
+void tut_4_serverRun(int numCiphertexts);
+void tut_4_clientDecrypt(int numCiphertexts);
+
+static const std::string asyncOutDir = getExamplesOutputDir() + "/async_io";
+
+// Number of ciphertexts that may wait in a queue. This bounds the amount of
+// memory used by the pipeline regardless of the batch size.
+static const size_t queueCapacity = 32;
+
+static string getFileName(const string& prefix, int i)
+{
+  return asyncOutDir + "/" + prefix + "_" + to_string(i) + ".bin";
+}
+
+static vector<string> getFileNames(const string& prefix, int numCiphertexts)
+{
+  vector<string> res;
+  res.reserve(numCiphertexts);
+  for (int i = 0; i < numCiphertexts; ++i)
+    res.push_back(getFileName(prefix, i));
+  return res;
+}
+
+static double secondsSince(high_resolution_clock::time_point start)
+{
+  return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+void tut_4_async_io(int numCiphertexts)
+{
+  // Same HE CKKS setup as in tut_3_io
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+  always_assert(hePtr->getSecurityLevel() >= 128);
+
+  FileUtils::createCleanDir(asyncOutDir);
+  hePtr->saveToFile(asyncOutDir + "/context.bin");
+  hePtr->saveSecretKeyToFile(asyncOutDir + "/secretKey.bin");
+
+  cout << "Running the client/server flow on " << numCiphertexts
+       << " ciphertexts" << endl;
+
+  tut_4_clientEncrypt(numCiphertexts);
+  tut_4_serverRun(numCiphertexts);
+  tut_4_clientDecrypt(numCiphertexts);
+
+  FileUtils::removeDir(asyncOutDir);
+}
+
+void tut_4_clientEncrypt(int numCiphertexts)
+{
+  shared_ptr<HeContext> hePtr =
+      loadHeContextFromFile(asyncOutDir + "/context.bin");
+  HeContext& he = *hePtr;
+  Encoder encoder(he);
+
+  // Ciphertext i encrypts the vector (v, v+1, v+2) where v = i % 100.
+  auto start = high_resolution_clock::now();
+  AsyncCTileWriter writer(queueCapacity);
+  for (int i = 0; i < numCiphertexts; ++i) {
+    CTile c(he);
+    double v = i % 100;
+    encoder.encodeEncrypt(c, vector<double>{v, v + 1, v + 2});
+    // The writer takes ownership of c. We immediately move on to encrypt the
+    // next ciphertext while this one is saved in the background.
+    writer.write(std::move(c), getFileName("data", i));
+  }
+  writer.close();
+  writer.getStats().print(cout, "Client encrypt", secondsSince(start));
+}
+
+void tut_4_serverRun(int numCiphertexts)
+{
+  shared_ptr<HeContext> hePtr =
+      loadHeContextFromFile(asyncOutDir + "/context.bin");
+  HeContext& he = *hePtr;
+
+  // The reader prefetches the next ciphertexts from disk while we square the
+  // current one, and the writer saves the results in the background.
+  auto start = high_resolution_clock::now();
+  AsyncCTileReader reader(
+      he, getFileNames("data", numCiphertexts), queueCapacity);
+  AsyncCTileWriter writer(queueCapacity);
+  CTile c(he);
+  for (int i = 0; reader.read(c); ++i) {
+    c.square();
+    writer.write(std::move(c), getFileName("result", i));
+    c = CTile(he);
+  }
+  writer.close();
+  double wallSeconds = secondsSince(start);
+  reader.getStats().print(cout, "Server load", wallSeconds);
+  writer.getStats().print(cout, "Server save", wallSeconds);
+}
+
+void tut_4_clientDecrypt(int numCiphertexts)
+{
+  shared_ptr<HeContext> hePtr =
+      loadHeContextFromFile(asyncOutDir + "/context.bin");
+  hePtr->loadSecretKeyFromFile(asyncOutDir + "/secretKey.bin");
+  HeContext& he = *hePtr;
+  Encoder encoder(he);
+
+  auto start = high_resolution_clock::now();
+  AsyncCTileReader reader(
+      he, getFileNames("result", numCiphertexts), queueCapacity);
+  CTile c(he);
+  int count = 0;
+  for (int i = 0; reader.read(c); ++i) {
+    double v = i % 100;
+    encoder.assertEquals(c,
+                         "result " + to_string(i),
+                         vector<double>{v * v, (v + 1) * (v + 1),
+                                        (v + 2) * (v + 2)},
+                         1e-3);
+    ++count;
+  }
+  always_assert(count == numCiphertexts);
+  reader.getStats().print(cout, "Client decrypt", secondsSince(start));
+  cout << "All " << count << " results are correct!" << endl;
+}
@@ -0,0 +1,152 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// See more information about this demo in the readme file.
+
+#include <chrono>
+#include <random>
+
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/hebase.h"
+#include "helayers/math/TTEncoder.h"
+#include "CiphertextContainer.h"
+
+using namespace std;
+using namespace chrono;
+using namespace helayers;
+
+// tut_3_io saves every CTile into its own file. With thousands of ciphertexts
+// this means thousands of small files, each costing several syscalls to open,
+// write and close. This tutorial stores all ciphertexts of a batch in a single
+// container file (see common/CiphertextContainer.h) with an index, per-entry
+// checksums and aligned offsets, and shows appending, random access reads
+// and memory mapped loads.
+
+static const std::string containerOutDir =
+    getExamplesOutputDir() + "/container";
+
+static double secondsSince(high_resolution_clock::time_point start)
+{
+  return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+void tut_5_container(int numCiphertexts)
+{
+  // Same HE CKKS setup as in tut_3_io
+  HeConfigRequirement requirement;
+  requirement.numSlots = 4096;
+  requirement.multiplicationDepth = 2;
+  requirement.fractionalPartPrecision = 40;
+  requirement.integerPartPrecision = 20;
+  requirement.securityLevel = 128;
+  shared_ptr<HeContext> hePtr = make_shared<SealCkksContext>();
+  hePtr->init(requirement);
+  always_assert(hePtr->getSecurityLevel() >= 128);
+  HeContext& he = *hePtr;
+
+  FileUtils::createCleanDir(containerOutDir);
+  Encoder encoder(he);
+
+  // Client side: encrypt the batch. Ciphertext i holds (v, v+1, v+2) where
+  // v = i % 100.
+  cout << "Encrypting " << numCiphertexts << " ciphertexts . . ." << endl;
+  vector<CTile> batch(numCiphertexts, CTile(he));
+  for (int i = 0; i < numCiphertexts; ++i) {
+    double v = i % 100;
+    encoder.encodeEncrypt(batch[i], vector<double>{v, v + 1, v + 2});
+  }
+
+  // For reference, save them one file per ciphertext as in tut_3_io.
+  auto start = high_resolution_clock::now();
+  for (int i = 0; i < numCiphertexts; ++i)
+    batch[i].saveToFile(containerOutDir + "/data_" + to_string(i) + ".bin");
+  cout << "Saving to " << numCiphertexts << " separate files took "
+       << secondsSince(start) << " s" << endl;
+
+  // Now save them into a single container. The vector overload serializes
+  // all ciphertexts and updates the index and header only once.
+  string dataFile = containerOutDir + "/data.hectx";
+  start = high_resolution_clock::now();
+  CiphertextContainer::create(dataFile);
+  CiphertextContainer data(dataFile);
+  data.append(batch);
+  cout << "Saving to a single container took " << secondsSince(start) << " s"
+       << endl;
+  batch.clear();
+
+  // Containers also hold tile tensors. We append one more entry that holds
+  // a small CTileTensor.
+  TTEncoder ttEncoder(he);
+  DoubleTensor matrix({4, 4});
+  for (int i = 0; i < 4; ++i)
+    for (int j = 0; j < 4; ++j)
+      matrix.at(i, j) = i * 4 + j;
+  CTileTensor encMatrix(he);
+  ttEncoder.encodeEncrypt(encMatrix, TTShape({4, he.slotCount() / 4}), matrix);
+  size_t matrixIndex = data.append(encMatrix);
+
+  // Server side: memory map the container and process a random subset of the
+  // ciphertexts. Only the pages of the entries we touch are read from disk.
+  cout << "Processing a random subset of the ciphertexts . . ." << endl;
+  MappedCiphertextContainer mappedData(dataFile);
+  vector<int> indices;
+  mt19937 rng(17);
+  uniform_int_distribution<int> dist(0, numCiphertexts - 1);
+  for (int i = 0; i < min(numCiphertexts, 100); ++i)
+    indices.push_back(dist(rng));
+
+  string resultsFile = containerOutDir + "/results.hectx";
+  CiphertextContainer::create(resultsFile);
+  CiphertextContainer results(resultsFile);
+  start = high_resolution_clock::now();
+  vector<CTile> processed;
+  CTile c(he);
+  for (int i : indices) {
+    mappedData.load(i, c);
+    c.square();
+    processed.push_back(c);
+  }
+  results.append(processed);
+  cout << "Loading, squaring and saving " << indices.size()
+       << " ciphertexts took " << secondsSince(start) << " s" << endl;
+
+  CTileTensor loadedMatrix(he);
+  mappedData.load(matrixIndex, loadedMatrix);
+  ttEncoder.decryptDecodeDouble(loadedMatrix)
+      .assertEquals(matrix, "tile tensor loaded from container", 1e-5);
+
+  // Client side: random access reads of the results.
+  for (size_t k = 0; k < indices.size(); ++k) {
+    results.load(k, c);
+    double v = indices[k] % 100;
+    encoder.assertEquals(c,
+                         "result " + to_string(k),
+                         vector<double>{v * v, (v + 1) * (v + 1),
+                                        (v + 2) * (v + 2)},
+                         1e-3);
+  }
+  cout << "All results are correct!" << endl;
+
+  FileUtils::removeDir(containerOutDir);
+}
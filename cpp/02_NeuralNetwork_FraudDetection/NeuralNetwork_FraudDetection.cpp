@@ -35,12 +35,19 @@
 #include "helayers/math/DoubleTensor.h"
 #include "helayers/math/MathGlobals.h"
 #include "helayers/math/TensorUtils.h"
+#include "DiagonalMatVec.h"
+#include "NumaExecutor.h"
+#include <H5Cpp.h>
+#include <chrono>
 #include <iomanip>
 #include <iostream>
+#include <random>
+#include <sstream>
 #include <string>
 #include <vector>
 
 using namespace std;
+using namespace chrono;
 using namespace helayers;
 
 void assessResults(const DoubleTensor& predictedLabels,
@@ -140,8 +147,367 @@ void assessResults(const DoubleTensor& predictedLabels,
 // and the results generated encrypted and confidential; only the data owner has
 // access to the private key and has the privilege to decrypt the results.
 
-int main()
+// Predicts one batch per NUMA node with the given executor. Every worker
+// encrypts its own copy of the model and its own batch, so with a bound
+// executor the ciphertexts it processes are allocated on its node. Returns
+// the prediction time in seconds; predictions of the first batch are stored
+// in firstPredictions.
+double predictSharded(NumaExecutor& executor,
+                      shared_ptr<HeContext> he,
+                      shared_ptr<PlainModel> plainNn,
+                      const HeProfile& profile,
+                      DatasetPlain& ds,
+                      DoubleTensorCPtr& firstPredictions)
 {
+  int numNodes = executor.getNumNodes();
+  vector<shared_ptr<HeModel>> models(numNodes);
+  vector<shared_ptr<EncryptedData>> inputs(numNodes);
+  vector<shared_ptr<EncryptedData>> outputs(numNodes);
+  vector<DoubleTensor> samples;
+  for (int i = 0; i < numNodes; ++i)
+    samples.push_back(ds.getSamples(i));
+
+  executor.runOnAllNodes([&](int i) {
+    models[i] = plainNn->getEmptyHeModel(*he);
+    models[i]->encodeEncrypt(*plainNn, profile);
+    ModelIoEncoder modelIoEncoder(*models[i]);
+    inputs[i] = make_shared<EncryptedData>(*he);
+    modelIoEncoder.encodeEncrypt(*inputs[i],
+                                 {make_shared<DoubleTensor>(samples[i])});
+  });
+
+  auto start = high_resolution_clock::now();
+  executor.runOnAllNodes([&](int i) {
+    outputs[i] = make_shared<EncryptedData>(*he);
+    models[i]->predict(*outputs[i], *inputs[i]);
+  });
+  double seconds =
+      duration<double>(high_resolution_clock::now() - start).count();
+
+  ModelIoEncoder modelIoEncoder(*models[0]);
+  firstPredictions = modelIoEncoder.decryptDecodeOutput(*outputs[0]);
+  return seconds;
+}
+
+// NUMA mode: the same prediction is run with one batch per NUMA node, first
+// with unpinned workers and then with workers bound to their nodes. The HE
+// context and its keys are shared by all workers and live on the node of the
+// main thread.
+void runNuma(int batchSize)
+{
+  string inputPath = getDataSetsDir() + "/net_fraud";
+  vector<NumaNode> nodes = NumaExecutor::getNodes();
+  cout << "NUMA nodes: " << nodes.size() << endl;
+  for (const NumaNode& node : nodes)
+    cout << "  node " << node.id << ": " << node.cpus.size() << " CPUs" << endl;
+
+  // Every node predicts its own batch of the test set.
+  H5::H5File samplesFile(inputPath + "/x_test.h5", H5F_ACC_RDONLY);
+  hsize_t dims[2];
+  samplesFile.openDataSet("x_test").getSpace().getSimpleExtentDims(dims);
+  always_assert_msg(dims[0] >= batchSize * nodes.size(),
+                    "The test set has " + to_string(dims[0]) +
+                        " samples, fewer than a batch of " +
+                        to_string(batchSize) + " per NUMA node");
+
+  DatasetPlain ds(batchSize);
+  ds.loadFromH5(
+      inputPath + "/x_test.h5", "x_test", inputPath + "/y_test.h5", "y_test");
+
+  // The numastat counters are system-wide, so the allocations of other
+  // processes during the runs are estimated from the rate of the counters
+  // before them, and subtracted.
+  double backgroundRate = NumaStats::getCrossNodeRate(1);
+
+  // Compile the model once, so that all workers share a single context.
+  shared_ptr<PlainModel> plainNn = PlainModel::create(
+      PlainModelHyperParams(),
+      {inputPath + "/model.json", inputPath + "/model.h5"});
+  HeRunRequirements heRunReq;
+  heRunReq.setHeContextOptions({make_shared<SealCkksContext>()});
+  heRunReq.optimizeForBatchSize(batchSize);
+  optional<HeProfile> profile = HeModel::compile(*plainNn, heRunReq);
+  always_assert(profile.has_value());
+  shared_ptr<HeContext> he = make_shared<SealCkksContext>();
+  he->init(profile->requirement);
+
+  double seconds[2];
+  long crossNode[2];
+  DoubleTensorCPtr predictions;
+  for (int bind = 0; bind <= 1; ++bind) {
+    cout << (bind ? "Bound" : "Unbound") << " run . . ." << endl;
+    NumaStats before = NumaStats::read();
+    auto start = high_resolution_clock::now();
+    NumaExecutor executor(bind);
+    seconds[bind] =
+        predictSharded(executor, he, plainNn, *profile, ds, predictions);
+    double runSeconds =
+        duration<double>(high_resolution_clock::now() - start).count();
+    crossNode[bind] = (NumaStats::read() - before).getCrossNodeAllocations() -
+                      lround(backgroundRate * runSeconds);
+  }
+
+  assessResults(*predictions, ds.getLabels(0));
+
+  int numSamples = batchSize * nodes.size();
+  cout << endl;
+  cout << "              predict (s)   samples/s   cross-node page allocations"
+       << endl;
+  for (int bind = 0; bind <= 1; ++bind)
+    cout << (bind ? "bound    " : "unbound  ") << setw(16) << seconds[bind]
+         << setw(12) << numSamples / seconds[bind] << setw(30)
+         << crossNode[bind] << endl;
+  cout << "Cross-node allocations are system-wide counts minus the "
+       << "background rate of " << backgroundRate << " pages/s" << endl;
+  cout << "Speedup of the bound run: " << seconds[0] / seconds[1] << endl;
+  cout << "used RAM = " << MemoryUtils::getUsedRam() << " (MB)" << endl;
+}
+
+// A dense layer of the model: its kernel, as a matrix of outputs rows, and
+// its bias.
+struct DenseLayer
+{
+  vector<vector<double>> kernel;
+  vector<double> bias;
+};
+
+// Reads a dataset of a H5 file into a flat vector, and its dimensions into
+// dims.
+vector<double> readDataset(const H5::DataSet& dataset, vector<hsize_t>& dims)
+{
+  H5::DataSpace space = dataset.getSpace();
+  dims.resize(space.getSimpleExtentNdims());
+  space.getSimpleExtentDims(dims.data());
+  vector<double> vals(space.getSimpleExtentNpoints());
+  dataset.read(vals.data(), H5::PredType::NATIVE_DOUBLE);
+  return vals;
+}
+
+// Collects the dense layers of a Keras weights file, in the order of their
+// groups. A kernel of shape (inputs, outputs) is returned as a matrix of
+// outputs rows.
+void collectDenseLayers(const H5::Group& group, vector<DenseLayer>& layers)
+{
+  DenseLayer layer;
+  for (hsize_t i = 0; i < group.getNumObjs(); ++i) {
+    string name = group.getObjnameByIdx(i);
+    H5G_obj_t type = group.getObjTypeByIdx(i);
+    if (type == H5G_GROUP) {
+      collectDenseLayers(group.openGroup(name), layers);
+      continue;
+    }
+    if (type != H5G_DATASET)
+      continue;
+    vector<hsize_t> dims;
+    if (name.rfind("kernel", 0) == 0) {
+      vector<double> vals = readDataset(group.openDataSet(name), dims);
+      if (dims.size() != 2)
+        continue;
+      layer.kernel.assign(dims[1], vector<double>(dims[0]));
+      for (hsize_t r = 0; r < dims[0]; ++r)
+        for (hsize_t c = 0; c < dims[1]; ++c)
+          layer.kernel[c][r] = vals[r * dims[1] + c];
+    } else if (name.rfind("bias", 0) == 0)
+      layer.bias = readDataset(group.openDataSet(name), dims);
+  }
+  if (!layer.kernel.empty()) {
+    layer.bias.resize(layer.kernel.size(), 0);
+    layers.push_back(layer);
+  }
+}
+
+// Computes the output of the model in the clear, as predict does: every
+// dense layer is followed by a square activation.
+double plainForward(const vector<DenseLayer>& layers, vector<double> x)
+{
+  for (const DenseLayer& layer : layers) {
+    vector<double> y = layer.bias;
+    for (size_t i = 0; i < y.size(); ++i)
+      for (size_t j = 0; j < x.size(); ++j)
+        y[i] += layer.kernel[i][j] * x[j];
+    for (double& v : y)
+      v *= v;
+    x = y;
+  }
+  return x[0];
+}
+
+// Whether the output of the model predicts label, see assessResults().
+bool isCorrect(double output, double label)
+{
+  return (round(output) > 0.5) == (round(label) > 0.5);
+}
+
+struct PruneResult
+{
+  double ratio;
+  int keptDiagonals = 0;
+  int rotations = 0;
+  double seconds = 0;
+  double accuracy = 0;
+  double plainAccuracy = 0;
+  double maxError = 0;
+};
+
+// Pruning mode: the model runs end to end, as predict does, with its dense
+// layers computed by the diagonal method (see ../common/DiagonalMatVec.h)
+// after pruning the given fraction of the diagonals of every kernel. Zero
+// diagonals are detected when the kernels are encoded, and their rotations
+// and multiplications are skipped. Every ratio is timed on numSamples
+// encrypted samples of the test set, one sample per ciphertext, and its
+// accuracy is measured both on these samples and, in the clear, on the whole
+// test set. The encrypted outputs are checked against the plain ones.
+void runPrune(vector<double> ratios, int numSamples)
+{
+  string inputPath = getDataSetsDir() + "/net_fraud";
+  vector<DenseLayer> layers;
+  H5::H5File file(inputPath + "/model.h5", H5F_ACC_RDONLY);
+  if (H5Lexists(file.getId(), "model_weights", H5P_DEFAULT) > 0)
+    collectDenseLayers(file.openGroup("model_weights"), layers);
+  else
+    collectDenseLayers(file, layers);
+  always_assert_msg(!layers.empty(), "no dense layers found in model.h5");
+
+  vector<hsize_t> dims;
+  H5::H5File samplesFile(inputPath + "/x_test.h5", H5F_ACC_RDONLY);
+  vector<double> samples =
+      readDataset(samplesFile.openDataSet("x_test"), dims);
+  int numFeatures = dims[1];
+  int testSize = dims[0];
+  always_assert_msg(numFeatures == layers[0].kernel[0].size(),
+                    "the samples do not match the first layer");
+  H5::H5File labelsFile(inputPath + "/y_test.h5", H5F_ACC_RDONLY);
+  vector<double> labels = readDataset(labelsFile.openDataSet("y_test"), dims);
+  numSamples = min(numSamples, testSize);
+  auto getSample = [&](int s) {
+    return vector<double>(samples.begin() + s * numFeatures,
+                          samples.begin() + (s + 1) * numFeatures);
+  };
+
+  // All kernels are padded to the same power of 2, so that every layer uses
+  // the same rotation keys, and the output of a layer, padded with zeros, is
+  // the input of the next one.
+  int n = 1;
+  for (const auto& layer : layers)
+    while (n < layer.kernel.size() || n < layer.kernel[0].size())
+      n *= 2;
+  cout << "Dense layers: " << layers.size() << ", padded to " << n << "x" << n
+       << endl;
+
+  // Every layer consumes a level for its kernel and one for its activation.
+  HeConfigRequirement req(max(8192, n), 2 * layers.size(), 40, 10);
+  DiagonalMatVec::setRotationSteps(req, n);
+  SealCkksContext he;
+  he.init(req);
+  Encoder enc(he);
+
+  // The dense model is always measured first, as the baseline.
+  if (ratios.empty() || ratios[0] != 0)
+    ratios.insert(ratios.begin(), 0);
+
+  vector<PruneResult> results;
+  for (double ratio : ratios) {
+    PruneResult res;
+    res.ratio = ratio;
+    vector<DenseLayer> pruned = layers;
+    vector<shared_ptr<DiagonalMatVec>> matVecs;
+    vector<PTile> biases;
+    for (DenseLayer& layer : pruned) {
+      DiagonalMatVec::pruneDiagonals(layer.kernel, n, ratio);
+      matVecs.push_back(make_shared<DiagonalMatVec>(he, layer.kernel, n));
+      res.keptDiagonals += matVecs.back()->getNumKeptDiagonals();
+      res.rotations += matVecs.back()->getNumRotations();
+      // The bias is replicated with period n, like the outputs.
+      vector<double> vals(he.slotCount(), 0);
+      for (int s = 0; s < he.slotCount(); ++s)
+        if (s % n < layer.bias.size())
+          vals[s] = layer.bias[s % n];
+      biases.emplace_back(he);
+      enc.encode(biases.back(), vals);
+    }
+
+    int correct = 0;
+    for (int s = 0; s < numSamples; ++s) {
+      vector<double> sample = getSample(s);
+      CTile a = matVecs[0]->encryptVector(sample);
+      CTile b(he);
+      CTile* in = &a;
+      CTile* out = &b;
+      auto start = high_resolution_clock::now();
+      for (size_t l = 0; l < matVecs.size(); ++l) {
+        matVecs[l]->multiply(*out, *in);
+        out->addPlain(biases[l]);
+        out->square();
+        swap(in, out);
+      }
+      res.seconds += duration<double>(high_resolution_clock::now() - start)
+                         .count() /
+                     numSamples;
+
+      double output = enc.decryptDecodeDouble(*in)[0];
+      double expected = plainForward(pruned, sample);
+      res.maxError = max(res.maxError, abs(output - expected));
+      correct += isCorrect(output, labels[s]);
+    }
+    res.accuracy = (double)correct / numSamples;
+
+    int plainCorrect = 0;
+    for (int s = 0; s < testSize; ++s)
+      plainCorrect += isCorrect(plainForward(pruned, getSample(s)), labels[s]);
+    res.plainAccuracy = (double)plainCorrect / testSize;
+    results.push_back(res);
+  }
+
+  cout << endl;
+  cout << "Latency and accuracy of " << numSamples
+       << " encrypted samples, and accuracy of the " << testSize
+       << " test samples in the clear:" << endl;
+  cout << "prune ratio   diagonals   rotations   latency (ms)   speedup"
+          "   accuracy   test accuracy   max error"
+       << endl;
+  for (const PruneResult& r : results)
+    cout << setw(11) << r.ratio << setw(12) << r.keptDiagonals << setw(12)
+         << r.rotations << setw(15) << r.seconds * 1000 << setw(10)
+         << results[0].seconds / r.seconds << setw(11) << r.accuracy
+         << setw(16) << r.plainAccuracy << setw(12) << r.maxError << endl;
+  for (const PruneResult& r : results)
+    always_assert_msg(r.maxError < 1e-3,
+                      "encrypted outputs differ from the plain ones");
+  cout << "used RAM = " << MemoryUtils::getUsedRam() << " (MB)" << endl;
+}
+
+vector<double> parseRatios(const string& list)
+{
+  vector<double> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(stod(item));
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  bool numa = false;
+  bool prune = false;
+  vector<double> pruneRatios;
+  int pruneSamples = 32;
+  for (int i = 1; i < argc; ++i) {
+    if (string(argv[i]) == "--numa")
+      numa = true;
+    else if (string(argv[i]) == "--prune" && i + 1 < argc) {
+      prune = true;
+      pruneRatios = parseRatios(argv[++i]);
+    } else if (string(argv[i]) == "--prune_samples" && i + 1 < argc)
+      pruneSamples = stoi(argv[++i]);
+    else
+      throw runtime_error(string("Unsupported argument: ") + argv[i]);
+  }
+  if (prune) {
+    runPrune(pruneRatios, pruneSamples);
+    return 0;
+  }
+
   int availableMemory = MemoryUtils::getAvailableMemory();
   if (availableMemory == -1) {
     cerr << "WARNING: computing the amount of available memory failed. "
@@ -161,6 +527,11 @@ int main()
   // examples/data/net_fraud folder.
 
   // 1.1 load the model and data.
+  if (numa) {
+    runNuma(4096);
+    return 0;
+  }
+
   string inputPath = getDataSetsDir() + "/net_fraud";
   string archFile = inputPath + "/model.json";
   string weightsFile = inputPath + "/model.h5";
@@ -32,13 +32,20 @@
 
 // See more information about this demo in the readme file.
 
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 
 #include "helayers/hebase/hebase.h"
 #include "helayers/hebase/openfhe/OpenFheBgvContext.h"
 #include "helayers/hebase/openfhe/OpenFheDcrtEncoder.h"
 #include "helayers/hebase/openfhe/OpenFheDcrtCiphertext.h"
 #include "helayers/math/MathUtils.h"
+#include "CiphertextOps.h"
+#include "DataGenerator.h"
+#include "PirDatabase.h"
+#include "QueryServer.h"
 #include <fstream>
 
 using namespace helayers;
@@ -46,12 +53,49 @@ using namespace std;
 
 // Forward declarations. These functions are explained later.
 vector<pair<string, string>> read_csv(const string& filename, int maxLen);
-void run(HeContext& he,
-         const string& db_filename,
-         const std::string& countryName,
-         bool debug,
-         int plaintextModulus);
+shared_ptr<HeContext> initContext(int numSlots,
+                                  int plaintextModulus,
+                                  int keyPeriod,
+                                  double& seconds);
+double run(HeContext& he,
+           const vector<pair<string, string>>& country_db,
+           const std::string& countryName,
+           bool debug,
+           int plaintextModulus,
+           int keyPeriod);
+void serve(HeContext& he,
+           const vector<pair<string, string>>& country_db,
+           int plaintextModulus,
+           int keyPeriod,
+           const string& socketPath,
+           double loadSeconds);
+void makeKeys(int numSlots,
+              int plaintextModulus,
+              int keyPeriod,
+              const string& keysDir);
+shared_ptr<HeContext> loadKeys(const string& keysDir,
+                               bool withSecretKey,
+                               int& keyPeriod);
+void runClient(HeContext& he, int keyPeriod, const string& socketPath);
+void encryptQueries(HeContext& he, int keyPeriod);
+void decryptResults(HeContext& he, int keyPeriod);
+void compareReductions(const vector<pair<string, string>>& country_db,
+                       const std::string& countryName,
+                       int plaintextModulus,
+                       int numSlots,
+                       int keyPeriod);
+void runPir(HeContext& he,
+            const vector<pair<string, string>>& country_db,
+            int index,
+            int dimensions);
+void comparePir(HeContext& he,
+                const vector<pair<string, string>>& country_db,
+                const std::string& countryName,
+                int plaintextModulus,
+                int keyPeriod);
+int getKeyPeriod(const vector<pair<string, string>>& country_db);
 vector<int> stringToAscii(const string& val);
+vector<int> keyToAscii(const string& key, int keyPeriod, int slots);
 void usage();
 
 int main(int argc, char* argv[])
@@ -69,6 +113,48 @@ int main(int argc, char* argv[])
 
   string countryName = "";
 
+  // Number of entries of a synthetic database to search instead of the
+  // database file (0 for using the file), and the seed generating it.
+  int syntheticEntries = 0;
+  uint64_t seed = DataGenerator::DEFAULT_SEED;
+
+  // Number of slots of every ciphertext.
+  int numSlots = 32;
+
+  // Reduce the equality over all slots, as in the original example, instead
+  // of over the longest country name only. Generates the default rotation
+  // keys.
+  bool fullReduction = false;
+
+  // Run the search with both reductions and compare their costs.
+  bool compareReduction = false;
+
+  // The service mode. The client generates the keys into keysDir
+  // (makeKeys), for the key period of the database, or for makeKeyPeriod if
+  // it is set. The server keeps the public keys and the encrypted database,
+  // and serves encrypted queries from stdin, or from a unix domain socket at
+  // socketPath if it is set (serveQueries). The client sends queries to the
+  // socket (clientMode), or encrypts them for a server serving stdin and
+  // decrypts its results (encryptMode and decryptMode). The key period is
+  // saved with the keys, so only makeKeys without makeKeyPeriod and the
+  // server read the database.
+  string keysDir = getExamplesOutputDir() + "/country_lookup_keys";
+  bool makeKeysMode = false;
+  int makeKeyPeriod = -1;
+  bool serveQueries = false;
+  bool clientMode = false;
+  bool encryptMode = false;
+  bool decryptMode = false;
+  string socketPath = "";
+
+  // Retrieve the capital of the entry at pirIndex by its index instead of
+  // searching for a country name, with a query of pirDimensions dimensions.
+  int pirIndex = -1;
+  int pirDimensions = 1;
+
+  // Compare the key lookup with retrieval by index.
+  bool comparePirMode = false;
+
   int i = 1;
   while (i < argc) {
     string arg = argv[i++];
@@ -84,48 +170,235 @@ int main(int argc, char* argv[])
       countryName = argv[i++];
     else if (arg == "--debug")
       debug = true;
+    else if (arg == "--synthetic")
+      syntheticEntries = atoi(argv[i++]);
+    else if (arg == "--seed")
+      seed = stoull(argv[i++]);
+    else if (arg == "--slots")
+      numSlots = atoi(argv[i++]);
+    else if (arg == "--full_reduction")
+      fullReduction = true;
+    else if (arg == "--compare_reduction")
+      compareReduction = true;
+    else if (arg == "--serve")
+      serveQueries = true;
+    else if (arg == "--socket")
+      socketPath = argv[i++];
+    else if (arg == "--keys_dir")
+      keysDir = argv[i++];
+    else if (arg == "--make_keys")
+      makeKeysMode = true;
+    else if (arg == "--key_period")
+      makeKeyPeriod = atoi(argv[i++]);
+    else if (arg == "--client")
+      clientMode = true;
+    else if (arg == "--encrypt_queries")
+      encryptMode = true;
+    else if (arg == "--decrypt_results")
+      decryptMode = true;
+    else if (arg == "--pir")
+      pirIndex = atoi(argv[i++]);
+    else if (arg == "--pir_dims")
+      pirDimensions = atoi(argv[i++]);
+    else if (arg == "--compare_pir")
+      comparePirMode = true;
     else
       throw runtime_error("Unsupported argument: " + arg);
   }
+  if (!socketPath.empty() && !clientMode)
+    serveQueries = true;
+  if (clientMode && socketPath.empty())
+    throw runtime_error("--client requires --socket");
+
+  // The service mode may use stdout for the queries and results, so its
+  // messages go to stderr.
+  bool serviceMode =
+      makeKeysMode || serveQueries || clientMode || encryptMode || decryptMode;
+  ostream& out = serviceMode ? cerr : cout;
+
+  out << "\n*********************************************************";
+  out << "\n*           Privacy Preserving Search Example           *";
+  out << "\n*           =================================           *";
+  out << "\n*                                                       *";
+  out << "\n* This is a sample program for education purposes only. *";
+  out << "\n* It implements a very simple homomorphic encryption    *";
+  out << "\n* based db search algorithm for demonstration purposes. *";
+  out << "\n*                                                       *";
+  out << "\n*********************************************************";
+  out << endl;
 
-  cout << "\n*********************************************************";
-  cout << "\n*           Privacy Preserving Search Example           *";
-  cout << "\n*           =================================           *";
-  cout << "\n*                                                       *";
-  cout << "\n* This is a sample program for education purposes only. *";
-  cout << "\n* It implements a very simple homomorphic encryption    *";
-  cout << "\n* based db search algorithm for demonstration purposes. *";
-  cout << "\n*                                                       *";
-  cout << "\n*********************************************************";
-  cout << endl;
+  // Since we store ascii codes, we need it at least to be able
+  // to handle the numbers 0...127
+  always_assert(plaintextModulus >= 127);
+
+  if (clientMode || encryptMode || decryptMode) {
+    int keyPeriod;
+    shared_ptr<HeContext> he = loadKeys(keysDir, true, keyPeriod);
+    if (clientMode)
+      runClient(*he, keyPeriod, socketPath);
+    else if (encryptMode)
+      encryptQueries(*he, keyPeriod);
+    else
+      decryptResults(*he, keyPeriod);
+    return 0;
+  }
+  if (makeKeysMode && makeKeyPeriod >= 0) {
+    makeKeys(numSlots, plaintextModulus, makeKeyPeriod, keysDir);
+    return 0;
+  }
+
+  // Now we'll read in the database (in cleartext), before initializing the
+  // context: the rotation keys depend on its longest country name.
+  // This function we'll make sure no string is longer than numSlots
+  vector<pair<string, string>> country_db;
+  if (syntheticEntries > 0) {
+    // Generated names of the same form, for runs without the database file
+    // or with more entries than it has.
+    DataGenerator generator(seed);
+    country_db = generator.generateCountries(syntheticEntries, numSlots);
+    out << "\nGenerated " << syntheticEntries << " entries with seed " << seed
+        << ", e.g. " << country_db[0].first << endl;
+  } else
+    country_db = read_csv(db_filename, numSlots);
+  int keyPeriod = fullReduction ? 0 : getKeyPeriod(country_db);
+
+  if (makeKeysMode) {
+    makeKeys(numSlots, plaintextModulus, keyPeriod, keysDir);
+    return 0;
+  }
+  if (serveQueries) {
+    // The keys were generated for the key period saved with them, which
+    // must fit the longest country name of the database.
+    auto start = chrono::high_resolution_clock::now();
+    shared_ptr<HeContext> he = loadKeys(keysDir, false, keyPeriod);
+    double loadSeconds =
+        chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+            .count();
+    if (keyPeriod > 0 && getKeyPeriod(country_db) > keyPeriod)
+      throw runtime_error("The keys in " + keysDir + " are for country "
+                          "names of up to " + to_string(keyPeriod) +
+                          " characters, shorter than in the database");
+    serve(*he, country_db, plaintextModulus, keyPeriod, socketPath,
+          loadSeconds);
+    return 0;
+  }
+
+  if (compareReduction) {
+    compareReductions(
+        country_db, countryName, plaintextModulus, numSlots, keyPeriod);
+    return 0;
+  }
 
   cout << "---Initialising HE Environment ... ";
   // Initialize context
   cout << "\nInitializing the Context ... " << endl;
+  double initSeconds;
+  shared_ptr<HeContext> he =
+      initContext(numSlots, plaintextModulus, keyPeriod, initSeconds);
+
+  // OpenFHE-BGV is now ready to start doing some HE work.
+  // which we'll do in the following function, defined below
+  if (comparePirMode)
+    comparePir(*he, country_db, countryName, plaintextModulus, keyPeriod);
+  else if (pirIndex >= 0)
+    runPir(*he, country_db, pirIndex, pirDimensions);
+  else
+    run(*he, country_db, countryName, debug, plaintextModulus, keyPeriod);
+
+  return 0;
+}
+
+// Returns the longest country name rounded up to a power of 2. Country names
+// are encoded repeatedly with this period, see run().
+int getKeyPeriod(const vector<pair<string, string>>& country_db)
+{
+  int keyPeriod = 1;
+  for (const auto& entry : country_db)
+    while (keyPeriod < entry.first.size())
+      keyPeriod *= 2;
+  return keyPeriod;
+}
+
+shared_ptr<HeContext> initContext(int numSlots,
+                                  int plaintextModulus,
+                                  int keyPeriod,
+                                  double& seconds)
+{
+  // Note: The parameters have been chosen to provide a somewhat
+  // faster running time with a non-realistic security level.
+  // Do Not use these parameters in real applications.
 
   // Next we'll initialize a BGV scheme in openFHE.
   // The following lines perform full initialization
   // Including key generation.
   // (We added code for timing it).
-  OpenFheBgvContext he;
+  shared_ptr<HeContext> he = make_shared<OpenFheBgvContext>();
   cout << "initializing he..." << endl;
 
-  // Since we store ascii codes, we need it at least to be able
-  // to handle the numbers 0...127
-  always_assert(plaintextModulus >= 127);
-
-  HeConfigRequirement req = HeConfigRequirement::insecure(32, 16);
+  HeConfigRequirement req = HeConfigRequirement::insecure(numSlots, 16);
   req.plaintextModulus = plaintextModulus;
-  HELAYERS_TIMER_PUSH("Initialization");
 
-  he.init(req);
+  // The bounded reduction rotates by the powers of 2 below keyPeriod only,
+  // so only these rotation keys are generated.
+  if (keyPeriod > 0) {
+    vector<int> steps;
+    for (int rot = 1; rot < keyPeriod; rot *= 2)
+      steps.push_back(-rot);
+    req.publicFunctions.rotate(CUSTOM_ROTATIONS);
+    req.publicFunctions.rotationSteps(steps);
+  }
+  HELAYERS_TIMER_PUSH("Initialization");
+  auto start = chrono::high_resolution_clock::now();
+  he->init(req);
+  seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
   HELAYERS_TIMER_POP();
+  return he;
+}
 
-  // OpenFHE-BGV is now ready to start doing some HE work.
-  // which we'll do in the following function, defined below
-  run(he, db_filename, countryName, debug, plaintextModulus);
+// Returns the size of the public keys of he, rotation keys included.
+double getKeysMegabytes(const HeContext& he)
+{
+  ostringstream out;
+  he.save(out);
+  return out.str().size() / 1e6;
+}
 
-  return 0;
+void compareReductions(const vector<pair<string, string>>& country_db,
+                       const std::string& countryName,
+                       int plaintextModulus,
+                       int numSlots,
+                       int keyPeriod)
+{
+  // The comparison is not interactive: without --country, the last country
+  // is searched, so that the whole database is scanned.
+  string query = countryName.empty() ? country_db.back().first : countryName;
+  vector<int> periods = {0, keyPeriod};
+  vector<double> initSeconds(2);
+  vector<double> keysMegabytes(2);
+  vector<double> entrySeconds(2);
+  for (int m = 0; m < 2; ++m) {
+    shared_ptr<HeContext> he =
+        initContext(numSlots, plaintextModulus, periods[m], initSeconds[m]);
+    keysMegabytes[m] = getKeysMegabytes(*he);
+    entrySeconds[m] =
+        run(*he, country_db, query, false, plaintextModulus, periods[m]);
+  }
+
+  cout << "\nReduction over " << numSlots << " slots vs. over " << keyPeriod
+       << " slots:" << endl;
+  cout << fixed << setprecision(3);
+  cout << "\t\t\tFull\t\tBounded\t\tSaving" << endl;
+  auto printRow = [](const string& name, const vector<double>& vals) {
+    cout << name << "\t" << vals[0] << "\t\t" << vals[1] << "\t\t"
+         << setprecision(1) << 100 * (1 - vals[1] / vals[0]) << "%"
+         << setprecision(3) << endl;
+  };
+  printRow("Key generation (s)", initSeconds);
+  printRow("Keys (MB)\t", keysMegabytes);
+  printRow("Per entry query (ms)",
+           {entrySeconds[0] * 1e3, entrySeconds[1] * 1e3});
 }
 
 void usage()
@@ -137,6 +410,32 @@ void usage()
        << endl;
   cout << "\t--country <int>\t\t\tCountry to search for" << endl;
   cout << "\t---debug\t\t\tDebug" << endl;
+  cout << "\t--synthetic <int>\t\tSearch a generated database of this many "
+          "entries"
+       << endl;
+  cout << "\t--seed <int>\t\t\tSeed of the generated database" << endl;
+  cout << "\t--slots <int>\t\t\tNumber of slots (default 32)" << endl;
+  cout << "\t--full_reduction\t\tReduce the equality over all slots" << endl;
+  cout << "\t--compare_reduction\t\tCompare the full and bounded reductions"
+       << endl;
+  cout << "\t--make_keys\t\t\tGenerate the keys of the service mode" << endl;
+  cout << "\t--key_period <int>\t\tKey period of --make_keys instead of the "
+          "database's"
+       << endl;
+  cout << "\t--keys_dir <path>\t\tDirectory of the keys of the service mode"
+       << endl;
+  cout << "\t--serve\t\t\t\tServe encrypted queries from stdin" << endl;
+  cout << "\t--socket <path>\t\t\tServe encrypted queries from a unix domain "
+          "socket"
+       << endl;
+  cout << "\t--client\t\t\tQuery the server at --socket" << endl;
+  cout << "\t--encrypt_queries\t\tEncrypt queries for --serve" << endl;
+  cout << "\t--decrypt_results\t\tDecrypt the results of --serve" << endl;
+  cout << "\t--pir <int>\t\t\tRetrieve the entry at this index" << endl;
+  cout << "\t--pir_dims <int>\t\tDimensions of the retrieval query" << endl;
+  cout << "\t--compare_pir\t\t\tCompare the key lookup with retrieval by "
+          "index"
+       << endl;
   cout << endl;
 }
 
@@ -144,7 +443,6 @@ void pow(HeContext& he, CTile& ctile, int degree)
 {
   bool yIsOne = true;
   CTile y(he);
-  CTile x = ctile;
 
   while (degree > 1) {
     if ((degree % 2) == 0) {
@@ -152,7 +450,7 @@ void pow(HeContext& he, CTile& ctile, int degree)
       degree = degree / 2;
     } else {
       if (yIsOne) {
-        y = ctile;
+        copyInto(y, ctile);
         yIsOne = false;
       } else {
         y.multiply(ctile);
@@ -165,11 +463,145 @@ void pow(HeContext& he, CTile& ctile, int degree)
     ctile.multiply(y);
 }
 
-void run(HeContext& he,
-         const string& db_filename,
-         const std::string& countryName,
-         bool debug,
-         int plaintextModulus)
+// Encrypts the country-capital pairs of country_db. With a keyPeriod, the
+// country names are repeated every keyPeriod slots (see keyToAscii()).
+vector<pair<CTile, CTile>> encryptDb(
+    HeContext& he,
+    const vector<pair<string, string>>& country_db,
+    int keyPeriod)
+{
+  // The encoder class handles both encoding and encrypting.
+  Encoder enc(he);
+  // This is the database: a vector of pairs of CTile-s.
+  // A CTile is a ciphertext object.
+  vector<pair<CTile, CTile>> encrypted_country_db;
+  for (const auto& country_capital_pair : country_db) {
+    // Create a country ciphertext, and encrypt inside
+    // the ascii vector representation of each country.
+    // For example, Norway is represented
+    // (78,111,114,119,97,121,  0,0,0, ...)
+    // With a keyPeriod, this representation is repeated every keyPeriod
+    // slots (see keyToAscii()).
+    CTile country(he);
+    enc.encodeEncrypt(
+        country,
+        keyToAscii(country_capital_pair.first, keyPeriod, he.slotCount()));
+    // Similarly encrypt the capital name
+    CTile capital(he);
+    enc.encodeEncrypt(capital, stringToAscii(country_capital_pair.second));
+    // Add the pair to the database
+    encrypted_country_db.emplace_back(std::move(country), std::move(capital));
+  }
+  return encrypted_country_db;
+}
+
+// Searches the encrypted database for the encrypted query, and stores into
+// value the capital of the matching entry, or all 0s if none matches.
+// one is an encryption of all ones.
+void search(HeContext& he,
+            CTile& value,
+            const vector<pair<CTile, CTile>>& encrypted_country_db,
+            const CTile& query,
+            const CTile& one,
+            int plaintextModulus,
+            int keyPeriod)
+{
+  bool first = true;
+  // The temporary ciphertexts are created once and reused by all entries.
+  CTile entry(he);
+  CTile tmp(he);
+
+  // For every entry in our database we perform the following
+  // calculation:
+  for (const auto& encrypted_pair : encrypted_country_db) {
+    // Calculate the difference between the database key (a country name)
+    // and the query.
+    // In each slot now we'll have 0 when characters match,
+    // or non-zero when there's a mismatch
+    // The result of the first entry is computed directly into value, and
+    // the results of the others into a temporary ciphertext added to it.
+    CTile& mask_entry = first ? value : entry;
+    subInto(mask_entry, encrypted_pair.first, query);
+
+    // Fermat's little theorem:
+    // Since the underlying plaintext are in modular arithmetic,
+    // Raising to the power of modulusP- 1 converts all non-zero values
+    // to 1.
+    // The difference is not needed anymore, so we compute the power in place.
+    pow(he, mask_entry, plaintextModulus - 1);
+
+    // Negate the ciphertext
+    // Now we'll have 0 for match, -1 for mismatch
+    mask_entry.negate();
+
+    // Add +1
+    // Now we'll have 1 for match, 0 for mismatch
+    mask_entry.add(one);
+
+    // We'll now multiply all slots together, since
+    // we want a complete match across all slots.
+
+    // If slot count is a power of 2 (our case 32) there's an efficient way
+    // to do it:
+    // we'll do a rotate-and-multiply algorithm, similar to
+    // a rotate-and-sum one.
+    // Since the keys are repeated every keyPeriod slots, every window of
+    // keyPeriod consecutive slots holds the match of all characters, and
+    // log(keyPeriod) rotations suffice to multiply them into every slot.
+    // Only the keys of these rotations are generated (see initContext()).
+    // All rotations are written into the same temporary ciphertext.
+    int reductionSlots = keyPeriod > 0 ? keyPeriod : he.slotCount();
+    for (int rot = 1; rot < reductionSlots; rot *= 2) {
+      rotateInto(tmp, mask_entry, -rot);
+      mask_entry.multiply(tmp);
+    }
+
+    // mask_entry is now either all 1s if query==country,
+    // or all 0s otherwise.
+    // After we multiply by capital name it will be either
+    // the capital name, or all 0s.
+    mask_entry.multiply(encrypted_pair.second);
+
+    // We sum up our findings as we go, instead of collecting a ciphertext
+    // per entry and summing them at the end.
+    if (!first)
+      value.add(mask_entry);
+    first = false;
+  }
+}
+
+// Decrypts the result of search() for query_string. Returns an empty string
+// if the country is not in the database.
+string decryptResult(const Encoder& enc,
+                     const CTile& value,
+                     const string& query_string,
+                     int keyPeriod)
+{
+  vector<int> res = enc.decryptDecodeInt(value);
+
+  // A query longer than keyPeriod cannot match any key, but with a
+  // keyPeriod it would wrap around onto itself and might.
+  if (keyPeriod > 0 && query_string.size() > keyPeriod)
+    return "";
+
+  // Convert from ASCII to a string, up to the zeros padding the capital
+  // name.
+  string string_result;
+  for (long i = 0; i < res.size() && res[i] != 0; ++i)
+    string_result.push_back(static_cast<long>(res[i]));
+  return string_result;
+}
+
+// Searches country_db for countryName and returns the search time per
+// entry, in seconds. With a keyPeriod, the equality of every entry is reduced
+// over keyPeriod slots only, see search(). With keyPeriod 0 it is reduced
+// over all slots.
+double run(HeContext& he,
+           const vector<pair<string, string>>& country_db,
+           const std::string& countryName,
+           bool debug,
+           int plaintextModulus,
+           int keyPeriod)
 {
 
   // The run function receives an abstract HeContext class.
@@ -192,11 +624,8 @@ void run(HeContext& he,
   // Let's also print the number of slots.
   // Each ciphertext will have this many slots.
   cout << "\nNumber of slots: " << he.slotCount() << endl;
-
-  // Now we'll read in the database (in cleartext).
-  // This function we'll make sure no string is longer than he.slotCount()
-  vector<pair<string, string>> country_db =
-      read_csv(db_filename, he.slotCount());
+  if (keyPeriod > 0)
+    cout << "Reducing the equality over " << keyPeriod << " slots" << endl;
 
   cout << "\n---Initializing the encrypted key,value pair database ("
        << country_db.size() << " entries)...";
@@ -206,26 +635,8 @@ void run(HeContext& he,
 
   // We'll now encrypt our country-capital database.
   HELAYERS_TIMER_PUSH("CountryDB");
-  // The encoder class handles both encoding and encrypting.
-  Encoder enc(he);
-  // This is the database: a vector of pairs of CTile-s.
-  // A CTile is a ciphertext object.
-  vector<pair<CTile, CTile>> encrypted_country_db;
-  for (const auto& country_capital_pair : country_db) {
-    // Create a country ciphertext, and encrypt inside
-    // the ascii vector representation of each country.
-    // For example, Norway is represented
-    // (78,111,114,119,97,121,  0,0,0, ...)
-    CTile country(he);
-    enc.encodeEncrypt(country, stringToAscii(country_capital_pair.first));
-    // Similarly encrypt the capital name
-    CTile capital(he);
-    enc.encodeEncrypt(capital, stringToAscii(country_capital_pair.second));
-    // Add the pair to the database
-
-    vector<int> resInt = enc.decryptDecodeInt(country);
-    encrypted_country_db.emplace_back(std::move(country), std::move(capital));
-  }
+  vector<pair<CTile, CTile>> encrypted_country_db =
+      encryptDb(he, country_db, keyPeriod);
   HELAYERS_TIMER_POP();
 
   cout << "\nInitialization Completed - Ready for Queries" << endl;
@@ -249,101 +660,437 @@ void run(HeContext& he,
 
   // Encrypt the query similar to the way we encrypted
   // the country and capital names
+  Encoder enc(he);
   CTile query(he);
-  enc.encodeEncrypt(query, stringToAscii(query_string));
+  enc.encodeEncrypt(query,
+                    keyToAscii(query_string, keyPeriod, he.slotCount()));
 
   HELAYERS_TIMER_POP();
 
   /************ Perform the database search ************/
 
   HELAYERS_TIMER_PUSH("QuerySearch");
-  vector<CTile> mask;
-  mask.reserve(country_db.size());
+  auto start = chrono::high_resolution_clock::now();
+
+  CiphertextCopyCounter::getInstance().clear();
+
+  // A ciphertext of all ones, used by search() for every entry. It is
+  // encrypted once, outside of the loop.
+  vector<int> valsOne = vector<int>(he.slotCount(), 1);
+  CTile one(he);
+  enc.encodeEncrypt(one, valsOne);
+
+  // The sum of the results of all entries.
+  CTile value(he);
+  search(he,
+         value,
+         encrypted_country_db,
+         query,
+         one,
+         plaintextModulus,
+         keyPeriod);
+  double searchSeconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  HELAYERS_TIMER_POP();
+  CiphertextCopyCounter::getInstance().printStats(
+      cout, "Search", encrypted_country_db.size(), "entry");
 
-  // For every entry in our database we perform the following
-  // calculation:
-  for (const auto& encrypted_pair : encrypted_country_db) {
-    //  Copy of database key: a country name
-    CTile mask_entry = encrypted_pair.first;
-    // Calculate the difference
-    // In each slot now we'll have 0 when characters match,
-    // or non-zero when there's a mismatch
+  // /************ Decrypt and print result ************/
 
-    mask_entry.sub(query);
+  HELAYERS_TIMER_PUSH("DecryptQueryResult");
+  string string_result = decryptResult(enc, value, query_string, keyPeriod);
+  HELAYERS_TIMER_POP();
 
-    // Fermat's little theorem:
-    // Since the underlying plaintext are in modular arithmetic,
-    // Raising to the power of modulusP- 1 converts all non-zero values
-    // to 1.
+  HELAYERS_TIMER_POP();
 
-    CTile res = mask_entry;
-    pow(he, res, plaintextModulus - 1);
+  if (string_result.empty()) {
+    string_result = "Country name not in the database.\n*** Please make sure "
+                    "to enter the name of an European Country\n*** with the "
+                    "first letter in upper case.";
+  }
+  if (debug)
+    HELAYERS_TIMER_PRINT_MEASURES_SUMMARY_FLAT();
+  cout << "\nQuery result: " << string_result << endl;
+  return searchSeconds / country_db.size();
+}
 
-    // Negate the ciphertext
-    // Now we'll have 0 for match, -1 for mismatch
-    res.negate();
+// The files of the keys of the service mode: the context with the public
+// keys, shared with the server, the secret key, kept by the client, and the
+// key period the keys were generated for, as text.
+string getContextFile(const string& keysDir)
+{
+  return keysDir + "/context.bin";
+}
 
-    // Add +1
-    // Now we'll have 1 for match, 0 for mismatch
+string getKeyPeriodFile(const string& keysDir)
+{
+  return keysDir + "/keyPeriod.txt";
+}
 
-    vector<int> valsOne = vector<int>(he.slotCount(), 1);
-    CTile one(he);
-    enc.encodeEncrypt(one, valsOne);
-    res.add(one);
+string getSecretKeyFile(const string& keysDir)
+{
+  return keysDir + "/secretKey.bin";
+}
 
-    // We'll now multiply all slots together, since
-    // we want a complete match across all slots.
+// Client side of the service mode: generates the keys for keyPeriod and
+// saves them into keysDir, with keyPeriod.
+void makeKeys(int numSlots,
+              int plaintextModulus,
+              int keyPeriod,
+              const string& keysDir)
+{
+  // The bounded reduction needs a power of 2 (see search()).
+  if (keyPeriod > numSlots || (keyPeriod & (keyPeriod - 1)) != 0)
+    throw runtime_error("The key period must be 0 or a power of 2 up to the "
+                        "number of slots");
+  double initSeconds;
+  shared_ptr<HeContext> he =
+      initContext(numSlots, plaintextModulus, keyPeriod, initSeconds);
+  FileUtils::createCleanDir(keysDir);
+  he->saveToFile(getContextFile(keysDir));
+  he->saveSecretKeyToFile(getSecretKeyFile(keysDir));
+  ofstream periodFile(getKeyPeriodFile(keysDir));
+  periodFile << keyPeriod << endl;
+  if (!periodFile)
+    throw runtime_error("Failed to write " + getKeyPeriodFile(keysDir));
+  cerr << "Generated the keys in " << initSeconds << " s and saved them to "
+       << keysDir << endl;
+}
 
-    // If slot count is a power of 2 (our case 32) there's an efficient way
-    // to do it:
-    // we'll do a rotate-and-multiply algorithm, similar to
-    // a rotate-and-sum one.
+// Loads the keys saved by makeKeys(), and their key period into keyPeriod.
+// The server loads the public keys only.
+shared_ptr<HeContext> loadKeys(const string& keysDir,
+                               bool withSecretKey,
+                               int& keyPeriod)
+{
+  ifstream periodFile(getKeyPeriodFile(keysDir));
+  if (!(periodFile >> keyPeriod))
+    throw runtime_error("Failed to read " + getKeyPeriodFile(keysDir));
+  shared_ptr<HeContext> he = loadHeContextFromFile(getContextFile(keysDir));
+  if (withSecretKey)
+    he->loadSecretKeyFromFile(getSecretKeyFile(keysDir));
+  return he;
+}
+
+// Serialized ciphertexts are sent as base64 lines (see QueryServer.h).
+string ciphertextToLine(const CTile& ct)
+{
+  ostringstream out;
+  ct.save(out);
+  return toBase64(out.str());
+}
+
+void ciphertextFromLine(CTile& ct, const string& line)
+{
+  istringstream in(fromBase64(line));
+  ct.load(in);
+}
+
+// Whether a response is the error of a query the server failed to serve.
+bool isErrorLine(const string& line)
+{
+  return line.compare(0, 7, "error: ") == 0;
+}
 
-    for (int rot = 1; rot < he.slotCount(); rot *= 2) {
-      CTile tmp(res);
-      tmp.rotate(-rot);
-      res.multiply(tmp);
+// Client side of the service mode: encrypts the query for query_string.
+// A query longer than keyPeriod cannot match any key, but would wrap around
+// onto itself and might, so it is replaced by an empty query, which matches
+// nothing.
+CTile encryptQuery(HeContext& he, const string& query_string, int keyPeriod)
+{
+  Encoder enc(he);
+  CTile query(he);
+  string key =
+      keyPeriod > 0 && query_string.size() > keyPeriod ? "" : query_string;
+  enc.encodeEncrypt(query, keyToAscii(key, keyPeriod, he.slotCount()));
+  return query;
+}
+
+// Server side of the service mode: serves encrypted queries, one serialized
+// query ciphertext per line, from stdin or from a unix domain socket at
+// socketPath (see QueryServer.h), and answers each with its serialized
+// result ciphertext. The server holds the public keys only (see loadKeys()),
+// so it never sees the queries or their results. Unlike run(), the context
+// and the encrypted database stay in memory across queries, so loading the
+// keys, loadSeconds, and encrypting the database are paid once.
+//
+// The responses are written to stdout when serving stdin, so all messages
+// go to stderr.
+void serve(HeContext& he,
+           const vector<pair<string, string>>& country_db,
+           int plaintextModulus,
+           int keyPeriod,
+           const string& socketPath,
+           double loadSeconds)
+{
+  always_assert(he.getTraits().isModularArithmetic());
+
+  cerr << "Encrypting the database (" << country_db.size() << " entries) ..."
+       << endl;
+  auto start = chrono::high_resolution_clock::now();
+  vector<pair<CTile, CTile>> encrypted_country_db =
+      encryptDb(he, country_db, keyPeriod);
+  double dbSeconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+
+  // Everything the queries share is created once, e.g. the encryption of all
+  // ones.
+  Encoder enc(he);
+  CTile one(he);
+  enc.encodeEncrypt(one, vector<int>(he.slotCount(), 1));
+
+  QueryServer server([&](const string& line) {
+    CTile query(he);
+    ciphertextFromLine(query, line);
+    CTile value(he);
+    search(he,
+           value,
+           encrypted_country_db,
+           query,
+           one,
+           plaintextModulus,
+           keyPeriod);
+    return ciphertextToLine(value);
+  });
+
+  cerr << "Serving encrypted queries, one per line. Send \"stats\" for the "
+          "latencies so far and \"quit\" to stop."
+       << endl;
+  if (socketPath.empty())
+    server.serveStream(cin, cout);
+  else {
+    cerr << "Listening on " << socketPath << endl;
+    server.serveSocket(socketPath);
+  }
+
+  const LatencyStats& stats = server.getStats();
+  stats.print(cerr, "\nServed");
+  if (stats.size() == 0)
+    return;
+  // The cost of a query when every query runs its own process, as run()
+  // does, against its cost when the setup is shared by all of them.
+  double setupSeconds = loadSeconds + dbSeconds;
+  cerr << "\tSetup: " << setupSeconds << " s (keys " << loadSeconds
+       << " s, database " << dbSeconds << " s)" << endl;
+  cerr << "\tPer query with setup, one shot: "
+       << setupSeconds + stats.getPercentile(50) << " s, amortized: "
+       << (setupSeconds + stats.getTotal()) / stats.size() << " s" << endl;
+}
+
+// Client side of the service mode, against a server listening at
+// socketPath: reads country names from stdin, one per line, and prints their
+// capitals with the round trip time of every query.
+void runClient(HeContext& he, int keyPeriod, const string& socketPath)
+{
+  QueryClient client(socketPath);
+  Encoder enc(he);
+  string query_string;
+  while (getline(cin, query_string)) {
+    if (query_string.empty())
+      continue;
+    auto start = chrono::high_resolution_clock::now();
+    CTile query = encryptQuery(he, query_string, keyPeriod);
+    string response = client.query(ciphertextToLine(query));
+    if (isErrorLine(response)) {
+      cout << query_string << ": " << response << endl;
+      continue;
     }
+    CTile value(he);
+    ciphertextFromLine(value, response);
+    string capital = decryptResult(enc, value, query_string, keyPeriod);
+    double seconds =
+        chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+            .count();
+    cout << query_string << ": "
+         << (capital.empty() ? "Country name not in the database." : capital)
+         << " (" << seconds * 1e3 << " ms)" << endl;
+  }
+}
 
-    // mask_entry is now either all 1s if query==country,
-    // or all 0s otherwise.
-    // After we multiply by capital name it will be either
-    // the capital name, or all 0s.
-    res.multiply(encrypted_pair.second);
+// Client side of the service mode, for a server serving stdin: encrypts the
+// country names read from stdin into serialized query lines on stdout, or
+// decrypts the result lines read from stdin into capitals on stdout.
+void encryptQueries(HeContext& he, int keyPeriod)
+{
+  string query_string;
+  while (getline(cin, query_string))
+    if (!query_string.empty())
+      cout << ciphertextToLine(encryptQuery(he, query_string, keyPeriod))
+           << endl;
+}
 
-    // We collect all our findings.
-    mask.push_back(res);
+void decryptResults(HeContext& he, int keyPeriod)
+{
+  Encoder enc(he);
+  string line;
+  while (getline(cin, line)) {
+    if (line.empty())
+      continue;
+    if (isErrorLine(line)) {
+      cout << line << endl;
+      continue;
+    }
+    CTile value(he);
+    ciphertextFromLine(value, line);
+    // Queries longer than keyPeriod were already replaced by empty ones.
+    string capital = decryptResult(enc, value, "", keyPeriod);
+    cout << (capital.empty() ? "Country name not in the database." : capital)
+         << endl;
   }
-  HELAYERS_TIMER_POP();
+}
 
-  // Aggregate the results into a single ciphertext
-  // Note: This code is for educational purposes and thus we try to refrain
-  // from using the STL and do not use std::accumulate
-  CTile value = mask[0];
-  for (int i = 1; i < mask.size(); i++)
-    value.add(mask[i]);
+// Returns the size of ct when sent over the network.
+size_t getCiphertextBytes(const CTile& ct)
+{
+  ostringstream out;
+  return ct.save(out);
+}
 
-  // /************ Decrypt and print result ************/
+// Returns the capitals of country_db as rows of ascii codes, for a
+// PirDatabase.
+vector<vector<int>> getCapitalRows(
+    const vector<pair<string, string>>& country_db)
+{
+  vector<vector<int>> rows;
+  for (const auto& entry : country_db)
+    rows.push_back(stringToAscii(entry.second));
+  return rows;
+}
 
-  HELAYERS_TIMER_PUSH("DecryptQueryResult");
-  vector<int> res = enc.decryptDecodeInt(value);
-  HELAYERS_TIMER_POP();
+// Converts a row retrieved from a PirDatabase back to a string, up to the
+// zeros padding it.
+string rowToString(const vector<int>& row)
+{
+  string res;
+  for (size_t i = 0; i < row.size() && row[i] != 0; ++i)
+    res.push_back(row[i]);
+  return res;
+}
 
-  // Convert from ASCII to a string
-  string string_result;
-  for (long i = 0; i < res.size(); ++i)
-    string_result.push_back(static_cast<long>(res[i]));
+// Retrieves the capital of the entry at index by private information
+// retrieval (see PirDatabase.h). Unlike run(), the client knows the index of
+// its entry, so the server only multiplies its capitals, in plain, by the
+// encrypted selection of the entry, with no equality test and no rotation.
+void runPir(HeContext& he,
+            const vector<pair<string, string>>& country_db,
+            int index,
+            int dimensions)
+{
+  always_assert(he.getTraits().isModularArithmetic());
+  PirDatabase db(he, getCapitalRows(country_db), dimensions);
+  cout << "\nPacked " << db.getNumRows() << " capitals into "
+       << db.getNumTiles() << " plaintexts of " << he.slotCount()
+       << " slots, " << db.getRowSlots() << " slots per capital" << endl;
 
+  HELAYERS_TIMER_PUSH("EncryptPirQuery");
+  vector<CTile> query = db.encryptQuery(index);
   HELAYERS_TIMER_POP();
 
-  if (string_result.at(0) == 0x00) {
-    string_result = "Country name not in the database.\n*** Please make sure "
-                    "to enter the name of an European Country\n*** with the "
-                    "first letter in upper case.";
+  HELAYERS_TIMER_PUSH("PirRetrieve");
+  auto start = chrono::high_resolution_clock::now();
+  CTile res(he);
+  db.retrieve(res, query);
+  double seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  HELAYERS_TIMER_POP();
+
+  string capital = rowToString(db.decryptRow(res, index));
+  cout << "Query of " << query.size() << " ciphertexts in " << dimensions
+       << " dimensions, retrieved in " << seconds * 1e3 << " ms" << endl;
+  cout << "\nQuery result: entry " << index << " ("
+       << country_db[index].first << "): " << capital << endl;
+  always_assert(capital == country_db[index].second);
+}
+
+// Compares searching for countryName by its key, as run() does, with
+// retrieving its entry by index with PirDatabase in 1, 2 and 3 dimensions,
+// on the server latency and on the bytes sent each way.
+void comparePir(HeContext& he,
+                const vector<pair<string, string>>& country_db,
+                const std::string& countryName,
+                int plaintextModulus,
+                int keyPeriod)
+{
+  always_assert(he.getTraits().isModularArithmetic());
+  string query_string =
+      countryName.empty() ? country_db.back().first : countryName;
+  int index = -1;
+  for (size_t i = 0; i < country_db.size() && index < 0; ++i)
+    if (country_db[i].first == query_string)
+      index = i;
+  if (index < 0)
+    throw runtime_error("Country " + query_string + " not in the database");
+
+  cout << "\nRetrieving the capital of " << query_string << " (entry "
+       << index << " of " << country_db.size() << ")" << endl;
+  cout << "Method\t\tQuery cts\tUpload (KB)\tDownload (KB)\tServer (ms)"
+       << endl;
+  cout << fixed << setprecision(1);
+  auto printRow = [](const string& name,
+                     int numCiphertexts,
+                     size_t uploadBytes,
+                     size_t downloadBytes,
+                     double seconds) {
+    cout << name << "\t" << numCiphertexts << "\t\t" << uploadBytes / 1e3
+         << "\t\t" << downloadBytes / 1e3 << "\t\t" << seconds * 1e3 << endl;
+  };
+
+  // Key lookup: a single query ciphertext, compared with every entry.
+  {
+    vector<pair<CTile, CTile>> encrypted_country_db =
+        encryptDb(he, country_db, keyPeriod);
+    Encoder enc(he);
+    CTile query(he);
+    enc.encodeEncrypt(query,
+                      keyToAscii(query_string, keyPeriod, he.slotCount()));
+    CTile one(he);
+    enc.encodeEncrypt(one, vector<int>(he.slotCount(), 1));
+    CTile value(he);
+    auto start = chrono::high_resolution_clock::now();
+    search(he,
+           value,
+           encrypted_country_db,
+           query,
+           one,
+           plaintextModulus,
+           keyPeriod);
+    double seconds =
+        chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+            .count();
+    always_assert(decryptResult(enc, value, query_string, keyPeriod) ==
+                  country_db[index].second);
+    printRow("Key lookup",
+             1,
+             getCiphertextBytes(query),
+             getCiphertextBytes(value),
+             seconds);
+  }
+
+  // PIR: the query grows with the database, the server work does not
+  // involve any ciphertext-ciphertext operation in a single dimension.
+  for (int dimensions = 1; dimensions <= 3; ++dimensions) {
+    PirDatabase db(he, getCapitalRows(country_db), dimensions);
+    vector<CTile> query = db.encryptQuery(index);
+    CTile res(he);
+    auto start = chrono::high_resolution_clock::now();
+    db.retrieve(res, query);
+    double seconds =
+        chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+            .count();
+    always_assert(rowToString(db.decryptRow(res, index)) ==
+                  country_db[index].second);
+    size_t uploadBytes = 0;
+    for (const CTile& ct : query)
+      uploadBytes += getCiphertextBytes(ct);
+    printRow("PIR " + to_string(dimensions) + "D\t",
+             query.size(),
+             uploadBytes,
+             getCiphertextBytes(res),
+             seconds);
   }
-  if (debug)
-    HELAYERS_TIMER_PRINT_MEASURES_SUMMARY_FLAT();
-  cout << "\nQuery result: " << string_result << endl;
 }
 
 // Utility function to read <K,V> CSV data from file
@@ -394,3 +1141,16 @@ vector<int> stringToAscii(const string& val)
   }
   return res;
 }
+
+// Return the ascii codes of key, repeated every keyPeriod slots, over all
+// slots. A keyPeriod of 0 does not repeat them, as in stringToAscii().
+vector<int> keyToAscii(const string& key, int keyPeriod, int slots)
+{
+  vector<int> res = stringToAscii(key);
+  if (keyPeriod == 0)
+    return res;
+  res.resize(slots, 0);
+  for (int i = keyPeriod; i < slots; ++i)
+    res[i] = i % keyPeriod < key.size() ? key[i % keyPeriod] : 0;
+  return res;
+}
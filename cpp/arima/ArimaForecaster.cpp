@@ -0,0 +1,370 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ArimaForecaster.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+using namespace helayers;
+
+namespace {
+
+// An affine function of the observations of a window: the symbolic values
+// the model runs on in computeWeights().
+struct AffineForm
+{
+  vector<double> coefs;
+  double constant = 0;
+};
+
+AffineForm operator+(AffineForm a, const AffineForm& b)
+{
+  for (size_t t = 0; t < a.coefs.size(); ++t)
+    a.coefs[t] += b.coefs[t];
+  a.constant += b.constant;
+  return a;
+}
+
+AffineForm operator-(AffineForm a, const AffineForm& b)
+{
+  for (size_t t = 0; t < a.coefs.size(); ++t)
+    a.coefs[t] -= b.coefs[t];
+  a.constant -= b.constant;
+  return a;
+}
+
+AffineForm operator*(AffineForm a, double c)
+{
+  for (double& coef : a.coefs)
+    coef *= c;
+  a.constant *= c;
+  return a;
+}
+
+AffineForm operator+(AffineForm a, double c)
+{
+  a.constant += c;
+  return a;
+}
+
+// Runs the model on a window of observations, either numbers or affine
+// forms, and returns the next horizon values.
+template <typename V>
+vector<V> runModel(const ArimaModel& model, const vector<V>& y, int horizon)
+{
+  int window = y.size();
+  int p = model.ar.size();
+  int q = model.ma.size();
+  int d = model.d;
+  V zero = y[0] * 0.0;
+
+  // levels[k] is the series differenced k times. The first k values of
+  // level k lack history and are never used.
+  vector<vector<V>> levels(d + 1);
+  levels[0] = y;
+  for (int k = 1; k <= d; ++k) {
+    const vector<V>& prev = levels[k - 1];
+    for (int t = 0; t < window; ++t)
+      levels[k].push_back(t < k ? zero : prev[t] - prev[t - 1]);
+  }
+  vector<V>& diff = levels[d];
+
+  vector<V> residuals(window + horizon, zero);
+  auto predict = [&](int t) {
+    V res = zero + model.constant;
+    for (int i = 1; i <= p; ++i)
+      res = res + diff[t - i] * model.ar[i - 1];
+    for (int j = 1; j <= q && j <= t; ++j)
+      res = res + residuals[t - j] * model.ma[j - 1];
+    return res;
+  };
+  for (int t = d + p; t < window; ++t)
+    residuals[t] = diff[t] - predict(t);
+
+  // Future residuals are 0. Every forecast of D is integrated back through
+  // the levels.
+  for (int t = window; t < window + horizon; ++t) {
+    diff.push_back(predict(t));
+    for (int k = d - 1; k >= 0; --k)
+      levels[k].push_back(levels[k + 1][t] + levels[k][t - 1]);
+  }
+  return vector<V>(levels[0].begin() + window, levels[0].end());
+}
+
+// weights[s][t] is the weight of observation t in forecast s, and
+// offsets[s] the constant part of forecast s.
+vector<vector<double>> computeWeights(const ArimaModel& model,
+                                      int window,
+                                      int horizon,
+                                      vector<double>& offsets)
+{
+  vector<AffineForm> y(window);
+  for (int t = 0; t < window; ++t) {
+    y[t].coefs.assign(window, 0);
+    y[t].coefs[t] = 1;
+  }
+  vector<AffineForm> forms = runModel(model, y, horizon);
+  vector<vector<double>> weights;
+  offsets.clear();
+  for (const AffineForm& form : forms) {
+    weights.push_back(form.coefs);
+    offsets.push_back(form.constant);
+  }
+  return weights;
+}
+
+// Forecast s is in slot window + s and observation t in slot t, so the
+// weight lies on lag window + s - t.
+vector<int> getLags(const vector<vector<double>>& weights, int window)
+{
+  vector<bool> used(window + weights.size(), false);
+  for (size_t s = 0; s < weights.size(); ++s)
+    for (int t = 0; t < window; ++t)
+      if (weights[s][t] != 0)
+        used[window + s - t] = true;
+  vector<int> lags;
+  for (size_t lag = 0; lag < used.size(); ++lag)
+    if (used[lag])
+      lags.push_back(lag);
+  return lags;
+}
+
+int getBabyStepSize(const vector<int>& lags)
+{
+  return lags.empty() ? 1 : ceil(sqrt(lags.back() + 1.0));
+}
+
+void checkModel(const ArimaModel& model, int window, int horizon)
+{
+  if (model.d < 0 || horizon < 1)
+    throw invalid_argument("ArimaForecaster: invalid model or horizon");
+  if (window <= model.d + (int)model.ar.size())
+    throw invalid_argument("ArimaForecaster: the window must be longer than "
+                           "d + p");
+}
+
+} // namespace
+
+ArimaForecaster::ArimaForecaster(HeContext& he,
+                                 const ArimaModel& model,
+                                 int window,
+                                 int horizon)
+    : he(he),
+      model(model),
+      window(window),
+      horizon(horizon),
+      blockSlots(1),
+      plainOffsets(he)
+{
+  checkModel(model, window, horizon);
+  while (blockSlots < window + horizon)
+    blockSlots *= 2;
+  if (blockSlots > he.slotCount())
+    throw invalid_argument("ArimaForecaster: a window of " +
+                           to_string(window) + " and a horizon of " +
+                           to_string(horizon) + " do not fit in " +
+                           to_string(he.slotCount()) + " slots");
+  weights = computeWeights(model, window, horizon, offsets);
+
+  // plain[lag] holds the weights of lag at the forecast slots of every
+  // block.
+  vector<int> lags = getLags(weights, window);
+  map<int, vector<double>> plain;
+  for (int lag : lags)
+    plain[lag].assign(he.slotCount(), 0);
+  vector<double> offsetVals(he.slotCount(), 0);
+  for (int block = 0; block < getSeriesPerCiphertext(); ++block)
+    for (int s = 0; s < horizon; ++s) {
+      int slot = block * blockSlots + window + s;
+      offsetVals[slot] = offsets[s];
+      for (int t = 0; t < window; ++t)
+        if (weights[s][t] != 0)
+          plain[window + s - t][slot] = weights[s][t];
+    }
+
+  // The product with baby step b is rotated by the giant step g afterwards,
+  // so its weights are rotated by -g ahead: slot i moves to slot i - g.
+  Encoder enc(he);
+  int babyStepSize = getBabyStepSize(lags);
+  usedBabySteps.assign(babyStepSize, false);
+  for (int lag : lags) {
+    int giant = lag - lag % babyStepSize;
+    if (giantSteps.empty() || giantSteps.back().lag != giant)
+      giantSteps.push_back({giant, {}});
+    const vector<double>& vals = plain[lag];
+    vector<double> rotated(he.slotCount());
+    for (int i = 0; i < he.slotCount(); ++i)
+      rotated[i] = vals[(i + giant) % he.slotCount()];
+    PTile ptile(he);
+    enc.encode(ptile, rotated, he.getTopChainIndex());
+    giantSteps.back().babySteps.emplace_back(lag % babyStepSize,
+                                             std::move(ptile));
+    usedBabySteps[lag % babyStepSize] = true;
+  }
+  enc.encode(plainOffsets, offsetVals, he.getTopChainIndex() - getDepth());
+}
+
+vector<double> ArimaForecaster::forecastPlain(const ArimaModel& model,
+                                              const vector<double>& series,
+                                              int horizon)
+{
+  checkModel(model, series.size(), horizon);
+  return runModel(model, series, horizon);
+}
+
+void ArimaForecaster::setRotationSteps(HeConfigRequirement& req,
+                                       const ArimaModel& model,
+                                       int window,
+                                       int horizon)
+{
+  checkModel(model, window, horizon);
+  vector<double> offsets;
+  vector<int> lags =
+      getLags(computeWeights(model, window, horizon, offsets), window);
+  int babyStepSize = getBabyStepSize(lags);
+  set<int> steps;
+  for (int lag : lags) {
+    if (lag % babyStepSize != 0)
+      steps.insert(-(lag % babyStepSize));
+    if (lag >= babyStepSize)
+      steps.insert(-(lag - lag % babyStepSize));
+  }
+  req.publicFunctions.rotate(CUSTOM_ROTATIONS);
+  req.publicFunctions.rotationSteps(vector<int>(steps.begin(), steps.end()));
+}
+
+int ArimaForecaster::getNumLags() const
+{
+  int res = 0;
+  for (const GiantStep& giant : giantSteps)
+    res += giant.babySteps.size();
+  return res;
+}
+
+int ArimaForecaster::getNumRotations() const
+{
+  int res = 0;
+  for (size_t b = 1; b < usedBabySteps.size(); ++b)
+    res += usedBabySteps[b];
+  for (const GiantStep& giant : giantSteps)
+    res += giant.lag != 0;
+  return res;
+}
+
+vector<CTile> ArimaForecaster::encryptSeries(
+    const vector<vector<double>>& series) const
+{
+  for (const auto& s : series)
+    if (s.size() != window)
+      throw invalid_argument("ArimaForecaster: series of " +
+                             to_string(s.size()) + " observations instead of " +
+                             to_string(window));
+
+  int seriesPerCiphertext = getSeriesPerCiphertext();
+  int numCiphertexts =
+      (series.size() + seriesPerCiphertext - 1) / seriesPerCiphertext;
+  vector<CTile> res(numCiphertexts, CTile(he));
+
+#pragma omp parallel for
+  for (int c = 0; c < numCiphertexts; ++c) {
+    Encoder enc(he);
+    int first = c * seriesPerCiphertext;
+    int last = min<int>(first + seriesPerCiphertext, series.size());
+    vector<double> vals(he.slotCount(), 0);
+    for (int i = first; i < last; ++i)
+      for (int t = 0; t < window; ++t)
+        vals[(i - first) * blockSlots + t] = series[i][t];
+    enc.encodeEncrypt(res[c], vals);
+  }
+  return res;
+}
+
+void ArimaForecaster::forecastCiphertext(CTile& res, const CTile& series) const
+{
+  vector<CTile> babySteps(usedBabySteps.size(), series);
+  for (size_t b = 1; b < usedBabySteps.size(); ++b)
+    if (usedBabySteps[b])
+      babySteps[b].rotate(-b);
+
+  bool first = true;
+  CTile sum(he);
+  CTile term(he);
+  for (const GiantStep& giant : giantSteps) {
+    for (size_t i = 0; i < giant.babySteps.size(); ++i) {
+      CTile& dest = i == 0 ? sum : term;
+      dest = babySteps[giant.babySteps[i].first];
+      dest.multiplyPlain(giant.babySteps[i].second);
+      if (i > 0)
+        sum.add(term);
+    }
+    if (giant.lag != 0)
+      sum.rotate(-giant.lag);
+    if (first)
+      res = sum;
+    else
+      res.add(sum);
+    first = false;
+  }
+  if (first) {
+    // All the weights are 0.
+    res = series;
+    res.multiplyScalar(0.0);
+  }
+  res.addPlain(plainOffsets);
+}
+
+vector<CTile> ArimaForecaster::forecast(const vector<CTile>& series) const
+{
+  vector<CTile> res(series.size(), CTile(he));
+#pragma omp parallel for
+  for (size_t c = 0; c < series.size(); ++c)
+    forecastCiphertext(res[c], series[c]);
+  return res;
+}
+
+vector<vector<double>> ArimaForecaster::decrypt(const vector<CTile>& res,
+                                                int numSeries) const
+{
+  Encoder enc(he);
+  vector<vector<double>> forecasts(numSeries);
+  int seriesPerCiphertext = getSeriesPerCiphertext();
+  for (size_t c = 0; c < res.size(); ++c) {
+    vector<double> vals = enc.decryptDecodeDouble(res[c]);
+    for (int b = 0; b < seriesPerCiphertext; ++b) {
+      int index = c * seriesPerCiphertext + b;
+      if (index >= numSeries)
+        break;
+      forecasts[index].assign(vals.begin() + b * blockSlots + window,
+                              vals.begin() + b * blockSlots + window +
+                                  horizon);
+    }
+  }
+  return forecasts;
+}
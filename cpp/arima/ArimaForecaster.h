@@ -0,0 +1,132 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ARIMA_FORECASTER_H_
+#define ARIMA_FORECASTER_H_
+
+#include <utility>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// An ARIMA(p, d, q) model with plain coefficients. The series is
+// differenced d times into D, which follows
+//
+//   D_t = constant + sum_i ar[i-1] D_t-i + sum_j ma[j-1] e_t-j + e_t
+//
+// where e_t is the one step forecast error.
+struct ArimaModel
+{
+  std::vector<double> ar;
+  int d = 0;
+  std::vector<double> ma;
+  double constant = 0;
+};
+
+// Forecasts many encrypted series at once with a plain ARIMA model.
+//
+// The forecasts of an ARIMA model are affine functions of the observed
+// window: the differencing, the residuals of the MA part, the recursive
+// multi-step forecasts and the integration back to the original scale are
+// all linear. The forecaster runs the model once in plaintext, on symbolic
+// values, to find the weight of every observation in every forecast. The
+// encrypted forecast is then a single weighted sum of lagged copies of the
+// series, one multiplication deep whatever the model orders and the
+// horizon are.
+//
+// Layout: every series occupies blockSlots consecutive slots, the window
+// plus the horizon rounded up to a power of 2. Observation t of a series is
+// in slot t of its block, and forecast s is written to slot window + s. The
+// copy of the series lagged by l is rotate(-l), so that slot window + s
+// holds observation window + s - l. The lags are computed with baby steps
+// and giant steps: the products with the baby step rotations are summed
+// before the giant step rotation, with the plain weights pre-rotated to
+// match, so that L lags take about 2 sqrt(L) rotations.
+class ArimaForecaster
+{
+  helayers::HeContext& he;
+  ArimaModel model;
+  int window;
+  int horizon;
+  int blockSlots;
+  // weights[s][t] is the weight of observation t in forecast s.
+  std::vector<std::vector<double>> weights;
+  std::vector<double> offsets;
+
+  struct GiantStep
+  {
+    int lag;
+    // Baby step lag -> weights of lag + baby step lag, pre-rotated.
+    std::vector<std::pair<int, helayers::PTile>> babySteps;
+  };
+  std::vector<GiantStep> giantSteps;
+  std::vector<bool> usedBabySteps;
+  helayers::PTile plainOffsets;
+
+  void forecastCiphertext(helayers::CTile& res,
+                          const helayers::CTile& series) const;
+
+public:
+  // window observations per series, forecasts of the next horizon values.
+  ArimaForecaster(helayers::HeContext& he,
+                  const ArimaModel& model,
+                  int window,
+                  int horizon);
+
+  // Runs the model in plaintext on a window of observations and returns the
+  // next horizon values. The residuals of the first d + p observations,
+  // which lack history, are taken as 0.
+  static std::vector<double> forecastPlain(const ArimaModel& model,
+                                           const std::vector<double>& series,
+                                           int horizon);
+
+  // Adds the baby step and giant step rotations used by forecast() to req.
+  static void setRotationSteps(helayers::HeConfigRequirement& req,
+                               const ArimaModel& model,
+                               int window,
+                               int horizon);
+
+  static int getDepth() { return 1; }
+
+  int getSeriesPerCiphertext() const { return he.slotCount() / blockSlots; }
+  int getNumLags() const;
+  int getNumRotations() const;
+
+  // Encrypts the series, each holding the last window observations.
+  std::vector<helayers::CTile> encryptSeries(
+      const std::vector<std::vector<double>>& series) const;
+
+  // Returns the forecasts of all series. The ciphertexts are processed in
+  // parallel.
+  std::vector<helayers::CTile> forecast(
+      const std::vector<helayers::CTile>& series) const;
+
+  // Decrypts the output of forecast() into horizon forecasts per series.
+  std::vector<std::vector<double>> decrypt(
+      const std::vector<helayers::CTile>& res,
+      int numSeries) const;
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "ArimaForecaster.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Forecasting options
+int numSeries = 100000;
+int window = 64;
+int horizon = 8;
+ArimaModel model{{0.6, -0.2}, 1, {0.3}, 0.1};
+uint64_t seed = 17;
+
+// Context options
+bool mockupContext = false;
+int numSlots = pow(2, 14);
+
+void help()
+{
+  cout << "Usage: ./arima [ additional optional parameters ]" << endl;
+  cout << endl;
+  cout << "Forecasting options:" << endl;
+  cout << "--series n\t\tnumber of series (default: 100000)." << endl;
+  cout << "--window n\t\tobservations per series (default: 64)." << endl;
+  cout << "--horizon n\t\tforecast steps (default: 8)." << endl;
+  cout << "--ar a,b,...\t\tAR coefficients (default: 0.6,-0.2)." << endl;
+  cout << "--d n\t\t\torder of differencing (default: 1)." << endl;
+  cout << "--ma a,b,...\t\tMA coefficients (default: 0.3)." << endl;
+  cout << "--constant x\t\tconstant of the model (default: 0.1)." << endl;
+  cout << "--seed n\t\tseed of the generated series (default: 17)." << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--mockup\t\truns the example with a mockup context for simulation."
+       << endl;
+  cout << "--slots n\t\tsets the number of slots in the HE context." << endl;
+  exit(1);
+}
+
+vector<double> parseList(const string& list)
+{
+  vector<double> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    if (!item.empty())
+      res.push_back(stod(item));
+  return res;
+}
+
+shared_ptr<HeContext> initContext()
+{
+  // The generated series stay within a few hundreds.
+  HeConfigRequirement req(numSlots, ArimaForecaster::getDepth(), 40, 12);
+  // Only the rotations the forecaster uses get keys.
+  ArimaForecaster::setRotationSteps(req, model, window, horizon);
+
+  shared_ptr<HeContext> he = make_shared<SealCkksContext>();
+  if (mockupContext) {
+    shared_ptr<MockupContext> mockup = make_shared<MockupContext>();
+    mockup->setEstimatedMeasures(he->getEstimatedMeasures());
+    he = mockup;
+    req.securityLevel = 0;
+  }
+  he->init(req);
+  return he;
+}
+
+double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+// Simulates length values of the model with standard normal noise.
+vector<double> simulate(mt19937_64& rng, int length)
+{
+  normal_distribution<double> noise(0, 1);
+  int p = model.ar.size();
+  int q = model.ma.size();
+  // A burn-in makes the series independent of the zero start.
+  int burnIn = 50;
+  vector<double> diff(burnIn + length, 0);
+  vector<double> errors(burnIn + length, 0);
+  for (int t = 0; t < burnIn + length; ++t) {
+    errors[t] = noise(rng);
+    diff[t] = model.constant + errors[t];
+    for (int i = 1; i <= p && i <= t; ++i)
+      diff[t] += model.ar[i - 1] * diff[t - i];
+    for (int j = 1; j <= q && j <= t; ++j)
+      diff[t] += model.ma[j - 1] * errors[t - j];
+  }
+  vector<double> res(diff.begin() + burnIn, diff.end());
+  for (int k = 0; k < model.d; ++k)
+    for (int t = 1; t < length; ++t)
+      res[t] += res[t - 1];
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--series" && i < argc)
+      numSeries = stoi(argv[i++]);
+    else if (arg == "--window" && i < argc)
+      window = stoi(argv[i++]);
+    else if (arg == "--horizon" && i < argc)
+      horizon = stoi(argv[i++]);
+    else if (arg == "--ar" && i < argc)
+      model.ar = parseList(argv[i++]);
+    else if (arg == "--d" && i < argc)
+      model.d = stoi(argv[i++]);
+    else if (arg == "--ma" && i < argc)
+      model.ma = parseList(argv[i++]);
+    else if (arg == "--constant" && i < argc)
+      model.constant = stod(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--mockup")
+      mockupContext = true;
+    else if (arg == "--slots" && i < argc)
+      numSlots = stoi(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+  always_assert_msg(numSeries > 0, "at least one series is required");
+
+  shared_ptr<HeContext> he = initContext();
+  he->printSignature(cout);
+
+  // Every series is simulated beyond the window, so that the forecasts can
+  // be compared with the values that actually followed.
+  cout << "Generating " << numSeries << " series of " << window
+       << " observations . . ." << endl;
+  mt19937_64 rng(seed);
+  vector<vector<double>> series(numSeries);
+  vector<vector<double>> future(numSeries);
+  for (int s = 0; s < numSeries; ++s) {
+    vector<double> values = simulate(rng, window + horizon);
+    series[s].assign(values.begin(), values.begin() + window);
+    future[s].assign(values.begin() + window, values.end());
+  }
+
+  ArimaForecaster forecaster(*he, model, window, horizon);
+  cout << "Series per ciphertext: " << forecaster.getSeriesPerCiphertext()
+       << endl;
+  cout << "Lags: " << forecaster.getNumLags()
+       << ", rotations per ciphertext: " << forecaster.getNumRotations()
+       << endl;
+
+  cout << "Encrypting . . ." << endl;
+  auto start = chrono::high_resolution_clock::now();
+  vector<CTile> encrypted = forecaster.encryptSeries(series);
+  double encryptSeconds = secondsSince(start);
+
+  cout << "Forecasting . . ." << endl;
+  start = chrono::high_resolution_clock::now();
+  vector<CTile> res = forecaster.forecast(encrypted);
+  double forecastSeconds = secondsSince(start);
+
+  // Only the owner of the secret key can do this.
+  vector<vector<double>> forecasts = forecaster.decrypt(res, numSeries);
+  double maxError = 0;
+  double squaredError = 0;
+  for (int s = 0; s < numSeries; ++s) {
+    vector<double> expected =
+        ArimaForecaster::forecastPlain(model, series[s], horizon);
+    for (int h = 0; h < horizon; ++h) {
+      maxError = max(maxError, abs(forecasts[s][h] - expected[h]));
+      squaredError += pow(forecasts[s][h] - future[s][h], 2);
+    }
+  }
+
+  cout << endl;
+  cout << "Ciphertexts: " << encrypted.size() << endl;
+  cout << "Max error vs. plain forecast: " << maxError << endl;
+  cout << "RMSE vs. simulated future: "
+       << sqrt(squaredError / numSeries / horizon) << endl;
+  cout << fixed << setprecision(3);
+  cout << "Encrypt time (s): " << encryptSeconds << endl;
+  cout << "Forecast time (s): " << forecastSeconds << endl;
+  cout << "Series per second: " << setprecision(0)
+       << numSeries / forecastSeconds << endl;
+  cout << "RAM (MB): " << MemoryUtils::getUsedRam() << endl;
+  always_assert_msg(mockupContext || maxError < 1e-3,
+                    "encrypted forecasts differ from the plain ones");
+  return 0;
+}
@@ -0,0 +1,1483 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "BenchKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <sstream>
+
+#include "helayers/ai/DatasetPlain.h"
+#include "helayers/ai/HeModel.h"
+#include "helayers/ai/decision_tree/DTreePlain.h"
+#include "helayers/ai/kmeans/KMeansPlain.h"
+#include "helayers/ai/logistic_regression/LogisticRegressionPlain.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/utils/TextIoUtils.h"
+#include "helayers/math/FunctionEvaluator.h"
+#include "helayers/math/TTConvolutionInterleaved.h"
+#include "helayers/math/TTEncoder.h"
+#include "helayers/math/TTFunctionEvaluator.h"
+#include "ArimaForecaster.h"
+#include "CnnEngine.h"
+#include "DataGenerator.h"
+#include "HammingMatcher.h"
+#include "KnnSearch.h"
+#include "LookupTable.h"
+#include "OneHotEncoder.h"
+#include "TraceRecorder.h"
+
+using namespace std;
+using namespace helayers;
+
+// Kernel of 01_hebase_tutorial: multiply, add, rotate and square a batch of
+// ciphertexts.
+class BasicsKernel : public BenchKernel
+{
+  static const int numCiphertexts = 16;
+
+  vector<CTile> a;
+  vector<CTile> b;
+  vector<CTile> results;
+
+  static double xVal(int i) { return 0.1 * (i % 8); }
+  static double yVal(int i) { return 0.5 + 0.1 * (i % 4); }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "basics"; }
+  string getExample() const override { return "01_hebase_tutorial"; }
+  string getItemName() const override { return "ciphertexts"; }
+  int getNumItems() const override { return numCiphertexts; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (options.insecure)
+      return HeConfigRequirement::insecure(4096, 2, 40, 20);
+    return HeConfigRequirement(4096, 2, 40, 20);
+  }
+
+  void setup(HeContext& he) override
+  {
+    Encoder enc(he);
+    a.assign(numCiphertexts, CTile(he));
+    b.assign(numCiphertexts, CTile(he));
+    results.assign(numCiphertexts, CTile(he));
+    for (int i = 0; i < numCiphertexts; ++i) {
+      // All slots hold the same value so the rotation does not change the
+      // expected result.
+      enc.encodeEncrypt(a[i], vector<double>(he.slotCount(), xVal(i)));
+      enc.encodeEncrypt(b[i], vector<double>(he.slotCount(), yVal(i)));
+    }
+  }
+
+  void run(HeContext& he) override
+  {
+    for (int i = 0; i < numCiphertexts; ++i) {
+      CTile c = a[i];
+      c.multiply(b[i]);
+      c.add(a[i]);
+      c.rotate(1);
+      c.square();
+      results[i] = std::move(c);
+    }
+  }
+
+  void verify(HeContext& he) const override
+  {
+    Encoder enc(he);
+    for (int i = 0; i < numCiphertexts; ++i) {
+      double v = xVal(i) * yVal(i) + xVal(i);
+      enc.assertEquals(results[i],
+                       "basics result " + to_string(i),
+                       vector<double>(he.slotCount(), v * v),
+                       1e-3);
+    }
+  }
+
+  void teardown() override
+  {
+    a.clear();
+    b.clear();
+    results.clear();
+  }
+};
+
+// A batch of samples packed feature-major in the slots is multiplied by
+// plaintext weights, and the features of each sample are summed with
+// rotations. This is only the first layer of logistic regression inference,
+// without the bias and the activation, so it is not attributed to an
+// example; lr_predict runs the model of logistic_regression.
+class InnerProductKernel : public BenchKernel
+{
+  static const int numFeatures = 16;
+
+  shared_ptr<CTile> samples;
+  shared_ptr<PTile> weights;
+  shared_ptr<CTile> result;
+
+  static double featureVal(int slot) { return 0.01 * (slot % 97); }
+  static double weightVal(int feature) { return 0.1 * (feature + 1); }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "plain_inner_product"; }
+  string getExample() const override { return "-"; }
+  string getItemName() const override { return "samples"; }
+  int getNumItems() const override { return 4096 / numFeatures; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (options.insecure)
+      return HeConfigRequirement::insecure(4096, 1, 40, 20);
+    return HeConfigRequirement(4096, 1, 40, 20);
+  }
+
+  void setup(HeContext& he) override
+  {
+    Encoder enc(he);
+    vector<double> x(he.slotCount());
+    vector<double> w(he.slotCount());
+    for (int i = 0; i < he.slotCount(); ++i) {
+      x[i] = featureVal(i);
+      w[i] = weightVal(i % numFeatures);
+    }
+    samples = make_shared<CTile>(he);
+    weights = make_shared<PTile>(he);
+    enc.encodeEncrypt(*samples, x);
+    enc.encode(*weights, w);
+  }
+
+  void run(HeContext& he) override
+  {
+    result = make_shared<CTile>(*samples);
+    result->multiplyPlain(*weights);
+    result->innerSum(1, numFeatures);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    Encoder enc(he);
+    vector<double> res = enc.decryptDecodeDouble(*result);
+    for (int s = 0; s < he.slotCount() / numFeatures; ++s) {
+      double expected = 0;
+      for (int f = 0; f < numFeatures; ++f)
+        expected += featureVal(s * numFeatures + f) * weightVal(f);
+      always_assert_msg(abs(res[s * numFeatures] - expected) < 1e-3,
+                        "plain_inner_product: wrong result for sample " +
+                            to_string(s));
+    }
+  }
+
+  void teardown() override
+  {
+    samples.reset();
+    weights.reset();
+    result.reset();
+  }
+};
+
+// Kernel of game_of_life: one step of the game on an encrypted board, using
+// the Lagrange basis variant of the equality check. Every run() computes the
+// step from the same starting board, so repetitions consume the same depth.
+class LifeStepKernel : public BenchKernel
+{
+  DoubleTensor startingPos;
+  shared_ptr<CTileTensor> board;
+  shared_ptr<CTileTensor> nextBoard;
+
+  int size() const { return options.boardSize; }
+
+  // Each slot of x becomes 1 if it equals to a, to 0 otherwise.
+  static void checkEqual(HeContext& he, CTileTensor& x, int a)
+  {
+    TTFunctionEvaluator fe(he);
+    vector<double> range = {0, 1, 2, 3, 4, 5, 6, 7, 8};
+    fe.computeLagrangeBasis(x, x, range, a);
+  }
+
+  // Computes 3x^2-2x^3 in place, see game_of_life.
+  static void cleanTensor(CTileTensor& x)
+  {
+    CTileTensor square = x.getSquare();
+    CTileTensor cube = square;
+    cube.multiply(x);
+    x = square;
+    x.add(square);
+    x.add(square);
+    x.sub(cube);
+    x.sub(cube);
+  }
+
+  double computePlainCell(int x, int y) const
+  {
+    double neighbours = 0;
+    for (int xpos = max(0, x - 1); xpos < min(size(), x + 2); xpos++)
+      for (int ypos = max(0, y - 1); ypos < min(size(), y + 2); ypos++)
+        neighbours += startingPos.at(xpos, ypos);
+    neighbours -= startingPos.at(x, y);
+    if (neighbours == 3)
+      return 1;
+    if (neighbours == 2)
+      return startingPos.at(x, y);
+    return 0;
+  }
+
+protected:
+  // Sets threeCheck and twoCheck to the indicators of neighbours == 3 and
+  // neighbours == 2.
+  virtual void checkNeighbours(HeContext& he,
+                               const CTileTensor& neighbours,
+                               CTileTensor& threeCheck,
+                               CTileTensor& twoCheck)
+  {
+    checkEqual(he, threeCheck, 3);
+    checkEqual(he, twoCheck, 2);
+  }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "life_step"; }
+  string getExample() const override { return "game_of_life"; }
+  string getItemName() const override { return "cells"; }
+  int getNumItems() const override { return size() * size(); }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (options.insecure)
+      return HeConfigRequirement::insecure(8192, 10, 29, 5);
+    return HeConfigRequirement(8192, 10, 29, 5);
+  }
+
+  void setup(HeContext& he) override
+  {
+    // A glider in the corner of the board, as in game_of_life.
+    startingPos = DoubleTensor({size(), size()});
+    startingPos.at(0, 0) = 1;
+    startingPos.at(1, 1) = 1;
+    startingPos.at(1, 2) = 1;
+    startingPos.at(0, 2) = 1;
+    startingPos.at(2, 1) = 1;
+
+    DoubleTensor input = startingPos;
+    input.reshape({1, size(), size(), 1, 1});
+    TTShape baseShape{1, size(), he.slotCount() / size(), 1, 1};
+    TTShape inputShape = baseShape.getWithDuplicatedDim(3);
+    inputShape.setOriginalSizes({1, size(), size(), 1, 1});
+    inputShape.getDim(1).setInterleaved(true, 1);
+    inputShape.getDim(2).setInterleaved(true, 1);
+
+    TTEncoder enc(he);
+    board = make_shared<CTileTensor>(he);
+    enc.encodeEncrypt(*board, inputShape, input);
+  }
+
+  void run(HeContext& he) override
+  {
+    TraceRecorder& trace = TraceRecorder::getInstance();
+
+    trace.begin("count-neighbours");
+    TTConvConfig cc(he, board->getShape(), 3, 3, 0, false);
+    cc.setStrides(1, 1);
+    cc.setDefaultDims(true);
+    cc.setPadding(Padding2d::same(size(), size(), 3, 3, 3, 3));
+    TTConvFilters cf(cc);
+    TTConvolutionInterleaved sumPoolEngine(board, cf);
+    CTileTensor neighbours = sumPoolEngine.getConvolution();
+    neighbours.sub(*board);
+    trace.end();
+
+    trace.begin("check-neighbours");
+    CTileTensor threeCheck(neighbours);
+    CTileTensor twoCheck(neighbours);
+    checkNeighbours(he, neighbours, threeCheck, twoCheck);
+    twoCheck.multiply(*board);
+    threeCheck.add(twoCheck);
+    trace.end();
+
+    trace.begin("cleanup");
+    cleanTensor(threeCheck);
+    nextBoard = make_shared<CTileTensor>(std::move(threeCheck));
+    trace.end();
+  }
+
+  void verify(HeContext& he) const override
+  {
+    TTEncoder enc(he);
+    DoubleTensor res = enc.decryptDecodeDouble(*nextBoard);
+    res.reshape({size(), size()});
+    for (int x = 0; x < size(); ++x)
+      for (int y = 0; y < size(); ++y)
+        always_assert_msg(abs(res.at(x, y) - computePlainCell(x, y)) < 0.1,
+                          "life_step: wrong value at cell " + to_string(x) +
+                              "," + to_string(y));
+  }
+
+  void teardown() override
+  {
+    board.reset();
+    nextBoard.reset();
+  }
+};
+
+// life_step with the two neighbour checks evaluated as lookup tables of the
+// neighbour count (see common/LookupTable.h). The second table reuses the
+// powers computed by the first.
+class LifeStepLutKernel : public LifeStepKernel
+{
+  LookupTable isThree{{0, 0, 0, 1, 0, 0, 0, 0, 0}};
+  LookupTable isTwo{{0, 0, 1, 0, 0, 0, 0, 0, 0}};
+
+protected:
+  void checkNeighbours(HeContext& he,
+                       const CTileTensor& neighbours,
+                       CTileTensor& threeCheck,
+                       CTileTensor& twoCheck) override
+  {
+    LutInput<CTileTensor> input(neighbours, 8);
+    isThree.evaluate(threeCheck, input);
+    isTwo.evaluate(twoCheck, input);
+  }
+
+public:
+  using LifeStepKernel::LifeStepKernel;
+
+  string getName() const override { return "life_step_lut"; }
+};
+
+// Kernel of BGV_world_country_db_lookup: looks up a country in an encrypted
+// country-capital database using Fermat's little theorem for the equality
+// check.
+class CountryLookupKernel : public BenchKernel
+{
+  vector<pair<string, string>> db;
+  vector<pair<CTile, CTile>> encryptedDb;
+  shared_ptr<CTile> query;
+  shared_ptr<CTile> value;
+  shared_ptr<CTile> one;
+
+  static vector<int> stringToAscii(const string& val)
+  {
+    return vector<int>(val.begin(), val.end());
+  }
+
+  static void pow(CTile& ctile, int degree)
+  {
+    bool yIsOne = true;
+    CTile y(ctile.getHeContext());
+    while (degree > 1) {
+      if ((degree % 2) == 0) {
+        ctile.square();
+        degree = degree / 2;
+      } else {
+        if (yIsOne) {
+          y = ctile;
+          yIsOne = false;
+        } else {
+          y.multiply(ctile);
+        }
+        ctile.square();
+        degree = (degree - 1) / 2;
+      }
+    }
+    if (!yIsOne)
+      ctile.multiply(y);
+  }
+
+protected:
+  static const int plaintextModulus = 257;
+
+  // Each slot of x becomes 1 if it is 0, to 0 otherwise.
+  virtual void checkZero(CTile& x)
+  {
+    pow(x, plaintextModulus - 1);
+    x.negate();
+    x.add(*one);
+  }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "country_lookup"; }
+  string getExample() const override { return "BGV_world_country_db_lookup"; }
+  string getItemName() const override { return "entries"; }
+  int getNumItems() const override { return db.size(); }
+  bool requiresModularArithmetic() const override { return true; }
+
+  // Like the original example, this kernel always uses insecure parameters.
+  HeConfigRequirement getRequirement() const override
+  {
+    HeConfigRequirement req = HeConfigRequirement::insecure(32, 16);
+    req.plaintextModulus = plaintextModulus;
+    return req;
+  }
+
+  void readDb(HeContext& he)
+  {
+    string fileName = getDataSetsDir() + "/countries/countries.csv";
+    ifstream in =
+        FileUtils::openIfstream(fileName, ios_base::in, ifstream::badbit);
+    string line;
+    while ((int)db.size() < options.lookupEntries && getline(in, line)) {
+      stringstream ss(line);
+      string country, capital;
+      getline(ss, country, ',');
+      getline(ss, capital, ',');
+      if (country.size() > he.slotCount() || capital.size() > he.slotCount())
+        continue;
+      db.emplace_back(country, capital);
+    }
+    always_assert_msg(!db.empty(), "country_lookup: no entries in " + fileName);
+  }
+
+  void setup(HeContext& he) override
+  {
+    db.clear();
+    if (options.synthetic) {
+      DataGenerator generator(options.seed);
+      db = generator.generateCountries(options.lookupEntries, he.slotCount());
+    } else
+      readDb(he);
+
+    Encoder enc(he);
+    encryptedDb.clear();
+    for (const auto& entry : db) {
+      CTile country(he);
+      CTile capital(he);
+      enc.encodeEncrypt(country, stringToAscii(entry.first));
+      enc.encodeEncrypt(capital, stringToAscii(entry.second));
+      encryptedDb.emplace_back(std::move(country), std::move(capital));
+    }
+
+    // Query the last entry, so that the whole database is scanned.
+    query = make_shared<CTile>(he);
+    enc.encodeEncrypt(*query, stringToAscii(db.back().first));
+    one = make_shared<CTile>(he);
+    enc.encodeEncrypt(*one, vector<int>(he.slotCount(), 1));
+  }
+
+  void run(HeContext& he) override
+  {
+    value.reset();
+    for (const auto& encryptedPair : encryptedDb) {
+      CTile res = encryptedPair.first;
+      res.sub(*query);
+      checkZero(res);
+      for (int rot = 1; rot < he.slotCount(); rot *= 2) {
+        CTile tmp(res);
+        tmp.rotate(-rot);
+        res.multiply(tmp);
+      }
+      res.multiply(encryptedPair.second);
+      if (value)
+        value->add(res);
+      else
+        value = make_shared<CTile>(std::move(res));
+    }
+  }
+
+  void verify(HeContext& he) const override
+  {
+    Encoder enc(he);
+    vector<int> res = enc.decryptDecodeInt(*value);
+    const string& expected = db.back().second;
+    for (size_t i = 0; i < res.size(); ++i) {
+      int expectedChar = i < expected.size() ? expected[i] : 0;
+      always_assert_msg(res[i] == expectedChar,
+                        "country_lookup: wrong capital for " + db.back().first);
+    }
+  }
+
+  void teardown() override
+  {
+    encryptedDb.clear();
+    query.reset();
+    value.reset();
+    one.reset();
+  }
+};
+
+// country_lookup with the equality check evaluated as a lookup table of the
+// difference between the entry and the query, over the whole plaintext
+// space. The table picks the Fermat method by itself.
+class CountryLookupLutKernel : public CountryLookupKernel
+{
+  LookupTable isZero{getIsZeroTable(), plaintextModulus};
+
+  static vector<double> getIsZeroTable()
+  {
+    vector<double> table(plaintextModulus, 0);
+    table[0] = 1;
+    return table;
+  }
+
+protected:
+  void checkZero(CTile& x) override
+  {
+    LutInput<CTile> input(x, plaintextModulus - 1, plaintextModulus);
+    isZero.evaluate(x, input);
+  }
+
+public:
+  using CountryLookupKernel::CountryLookupKernel;
+
+  string getName() const override { return "country_lookup_lut"; }
+};
+
+// Kernel of copy_and_recurse: the naive count query, which compares every
+// database element with both ends of the queried range.
+class CountQueryKernel : public BenchKernel
+{
+  static const int rangeSize = 100;
+  static const int gRep = 4;
+  static const int fRep = 1;
+
+  vector<uint16_t> database;
+  double queryStart = -0.5;
+  double queryEnd = 0;
+  vector<CTile> encryptedDb;
+  shared_ptr<CTile> cStart;
+  shared_ptr<CTile> cEnd;
+  shared_ptr<CTile> cRes;
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "count_query"; }
+  string getExample() const override { return "copy_and_recurse"; }
+  string getItemName() const override { return "elements"; }
+  int getNumItems() const override { return database.size(); }
+  bool requiresModularArithmetic() const override { return false; }
+  bool requiresBootstrapping() const override { return true; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    HeConfigRequirement req =
+        options.insecure ? HeConfigRequirement::insecure(pow(2, 15), 20, 42, 7)
+                         : HeConfigRequirement(pow(2, 15), 20, 42, 7);
+    req.bootstrappable = true;
+    req.automaticBootstrapping = true;
+    BootstrapConfig bsConfig;
+    bsConfig.range = EXTENDED_RANGE;
+    req.bootstrapConfig = bsConfig;
+    return req;
+  }
+
+  void setup(HeContext& he) override
+  {
+    he.setAutomaticBootstrapping(true);
+
+    // A fixed seed keeps the operation counts reproducible.
+    default_random_engine re(options.seed);
+    uniform_int_distribution<> unif(0, rangeSize + 1);
+    database.resize(options.countElements);
+    for (auto& elem : database)
+      elem = unif(re);
+    queryEnd = rangeSize / 2 + 0.5;
+
+    Encoder enc(he);
+    cStart = make_shared<CTile>(he);
+    cEnd = make_shared<CTile>(he);
+    enc.encodeEncrypt(*cStart, queryStart);
+    enc.encodeEncrypt(*cEnd, queryEnd);
+
+    encryptedDb.clear();
+    for (size_t i = 0; i < database.size(); i += he.slotCount()) {
+      // Unused slots hold -1, which is outside every queried range.
+      vector<int> tmp(he.slotCount(), -1);
+      for (size_t j = i; j < min(database.size(), i + he.slotCount()); ++j)
+        tmp[j - i] = database[j];
+      CTile c(he);
+      enc.encodeEncrypt(c, tmp);
+      encryptedDb.push_back(std::move(c));
+    }
+  }
+
+  void run(HeContext& he) override
+  {
+    FunctionEvaluator fe(he);
+    cRes.reset();
+    for (const CTile& elem : encryptedDb) {
+      CTile tmp = fe.compare(elem, *cStart, gRep, fRep, rangeSize);
+      tmp.multiply(fe.compare(*cEnd, elem, gRep, fRep, rangeSize));
+      if (cRes)
+        cRes->add(tmp);
+      else
+        cRes = make_shared<CTile>(std::move(tmp));
+    }
+  }
+
+  void verify(HeContext& he) const override
+  {
+    int expected = 0;
+    for (uint16_t elem : database)
+      if (elem >= queryStart && elem <= queryEnd)
+        expected++;
+    Encoder enc(he);
+    vector<int> res = enc.decryptDecodeInt(*cRes);
+    int count = 0;
+    for (int v : res)
+      count += v;
+    always_assert_msg(count == expected,
+                      "count_query: expected " + to_string(expected) +
+                          ", got " + to_string(count));
+  }
+
+  void teardown() override
+  {
+    encryptedDb.clear();
+    cStart.reset();
+    cEnd.reset();
+    cRes.reset();
+  }
+};
+
+// Kernel of a model example: encrypted prediction of a batch with an
+// HeModel, checked against the prediction of the plain model. As in the
+// examples, HeRunRequirements compiles the model for SEAL, which gives the
+// requirement of the context. setup() compiles the model again for the
+// configuration of the backend's context, as multi_party_fhe does, so that
+// every backend runs the same model under its own keys.
+class ModelKernel : public BenchKernel
+{
+  // Loaded on first use, since --list creates the kernels too.
+  mutable shared_ptr<PlainModel> plain;
+  mutable optional<HeProfile> profile;
+
+  shared_ptr<DoubleTensor> samples;
+  DoubleTensorCPtr expected;
+  shared_ptr<HeModel> model;
+  shared_ptr<EncryptedData> inputs;
+  shared_ptr<EncryptedData> predictions;
+
+  PlainModel& getPlainModel() const
+  {
+    if (!plain)
+      plain = loadPlainModel();
+    return *plain;
+  }
+
+  HeRunRequirements getRunRequirements() const
+  {
+    HeRunRequirements heRunReq;
+    heRunReq.setHeContextOptions({make_shared<SealCkksContext>()});
+    if (getBatchSize() > 0)
+      heRunReq.optimizeForBatchSize(getBatchSize());
+    return heRunReq;
+  }
+
+protected:
+  virtual shared_ptr<PlainModel> loadPlainModel() const = 0;
+
+  // Returns the samples of one batch. slotCount is that of the context.
+  virtual DoubleTensor loadSamples(int slotCount) const = 0;
+
+  // The batch size to optimize the model for, or 0 to keep the default.
+  virtual int getBatchSize() const = 0;
+
+  // The largest difference allowed from the plain predictions, and the
+  // fraction of predictions that may exceed it, e.g. those of samples close
+  // to a decision threshold.
+  virtual double getTolerance() const { return 1e-2; }
+  virtual double getMaxMismatchRate() const { return 0; }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getItemName() const override { return "samples"; }
+  int getNumItems() const override
+  {
+    return samples ? samples->getDimSize(0) : 0;
+  }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (!profile) {
+      profile = HeModel::compile(getPlainModel(), getRunRequirements());
+      always_assert_msg(profile.has_value(),
+                        getName() + ": no HE configuration fits the model");
+    }
+    HeConfigRequirement req = profile->requirement;
+    if (options.insecure)
+      req.securityLevel = 0;
+    return req;
+  }
+
+  void setup(HeContext& he) override
+  {
+    PlainModel& plainModel = getPlainModel();
+    HeRunRequirements heRunReq = getRunRequirements();
+    heRunReq.setExplicitHeConfigRequirement(he.getHeConfigRequirement());
+    optional<HeProfile> heProfile = HeModel::compile(plainModel, heRunReq);
+    always_assert(heProfile.has_value());
+    model = plainModel.getEmptyHeModel(he);
+    model->encodeEncrypt(plainModel, *heProfile);
+
+    samples = make_shared<DoubleTensor>(loadSamples(he.slotCount()));
+    expected = plainModel.predict({samples}).at(0);
+    ModelIoEncoder modelIoEncoder(*model);
+    inputs = make_shared<EncryptedData>(he);
+    modelIoEncoder.encodeEncrypt(*inputs, {samples});
+  }
+
+  void run(HeContext& he) override
+  {
+    predictions = make_shared<EncryptedData>(he);
+    model->predict(*predictions, *inputs);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    ModelIoEncoder modelIoEncoder(*model);
+    DoubleTensorCPtr res = modelIoEncoder.decryptDecodeOutput(*predictions);
+    always_assert_msg(res->size() == expected->size(),
+                      getName() + ": wrong number of predictions");
+    int mismatches = 0;
+    for (int i = 0; i < res->size(); ++i)
+      mismatches += abs(res->at(i) - expected->at(i)) > getTolerance();
+    always_assert_msg(mismatches <= getMaxMismatchRate() * res->size(),
+                      getName() + ": " + to_string(mismatches) +
+                          " predictions differ from the plain model");
+  }
+
+  void teardown() override
+  {
+    model.reset();
+    inputs.reset();
+    predictions.reset();
+  }
+};
+
+// Kernel of the neural network examples: a network saved by Keras, with its
+// test samples.
+class NeuralNetKernel : public ModelKernel
+{
+  string name;
+  string example;
+  string dataDir;
+  int batchSize;
+
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    string inputPath = getDataSetsDir() + "/" + dataDir;
+    return PlainModel::create(
+        PlainModelHyperParams(),
+        {inputPath + "/model.json", inputPath + "/model.h5"});
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    string inputPath = getDataSetsDir() + "/" + dataDir;
+    DatasetPlain ds(batchSize);
+    ds.loadFromH5(inputPath + "/x_test.h5",
+                  "x_test",
+                  inputPath + "/y_test.h5",
+                  "y_test");
+    return ds.getSamples(0);
+  }
+
+  int getBatchSize() const override { return batchSize; }
+
+public:
+  NeuralNetKernel(const BenchOptions& options,
+                  const string& name,
+                  const string& example,
+                  const string& dataDir,
+                  int batchSize)
+      : ModelKernel(options),
+        name(name),
+        example(example),
+        dataDir(dataDir),
+        batchSize(batchSize)
+  {}
+
+  string getName() const override { return name; }
+  string getExample() const override { return example; }
+};
+
+// Kernel of 03_LogisticRegression_FraudDetection.
+class LrFraudPredictKernel : public ModelKernel
+{
+  static const int batchSize = 8192;
+
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    shared_ptr<LogisticRegressionPlain> lrp =
+        make_shared<LogisticRegressionPlain>();
+    lrp->initFromFiles(PlainModelHyperParams(),
+                       {getDataSetsDir() + "/lr_fraud/model.json"});
+    return lrp;
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    string inputPath = getDataSetsDir() + "/lr_fraud";
+    DatasetPlain ds(batchSize);
+    ds.loadFromH5(inputPath + "/x_test.h5",
+                  "x_test",
+                  inputPath + "/y_test.h5",
+                  "y_test");
+    return ds.getSamples(0);
+  }
+
+  int getBatchSize() const override { return batchSize; }
+
+public:
+  using ModelKernel::ModelKernel;
+
+  string getName() const override { return "lr_fraud_predict"; }
+  string getExample() const override
+  {
+    return "03_LogisticRegression_FraudDetection";
+  }
+};
+
+// Kernel of logistic_regression: prediction with the weights of the credit
+// card model, on a batch of the balanced sample.
+class LrPredictKernel : public ModelKernel
+{
+  static const DimInt inputSize = 30;
+  static const DimInt batchSize = 984;
+
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    PlainModelHyperParams hp;
+    hp.logisticRegressionActivation(LR_ACTIVATION_SIGMOID_POLY_3_APPROXIMATION);
+    hp.numberOfFeatures(inputSize);
+    shared_ptr<LogisticRegressionPlain> lrp =
+        make_shared<LogisticRegressionPlain>();
+    lrp->initFromFiles(
+        hp,
+        {getDataSetsDir() +
+         "/logistic_regression/creditcard_weights_bias.h5"});
+    return lrp;
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    DoubleTensor input;
+    if (options.synthetic)
+      input = DataGenerator(options.seed)
+                  .generateFraudSamples(batchSize, inputSize);
+    else
+      input = TextIoUtils::readMatrixFromCsvFile(
+          getDataSetsDir() +
+          "/logistic_regression/processed_creditcard_balanced_sample.csv");
+    input.removeSlice(1, inputSize);
+    return input.getSlice(0, 0, batchSize);
+  }
+
+  int getBatchSize() const override { return batchSize; }
+
+public:
+  using ModelKernel::ModelKernel;
+
+  string getName() const override { return "lr_predict"; }
+  string getExample() const override { return "logistic_regression"; }
+};
+
+// Kernel of linear_regression: a logistic regression model without an
+// activation, built from plain weights.
+class LinearRegressionKernel : public ModelKernel
+{
+  string getDataDir() const
+  {
+    return getDataSetsDir() + "/linear_regression/";
+  }
+
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    DoubleTensor weights = TextIoUtils::readMatrixFromCsvFile(
+        getDataDir() + "logModelWeights.csv");
+    weights.transpose();
+    weights.reshape({(int)weights.size(), 1, 1});
+    DoubleTensor biases =
+        TextIoUtils::readMatrixFromCsvFile(getDataDir() + "bias.csv");
+
+    PlainModelHyperParams hp;
+    hp.logisticRegressionActivation(LR_ACTIVATION_NONE);
+    shared_ptr<LogisticRegressionPlain> lrp =
+        make_shared<LogisticRegressionPlain>();
+    lrp->initFromTensor(hp, weights, biases.at(0));
+    return lrp;
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    return TextIoUtils::readMatrixFromCsvFile(getDataDir() + "testData.csv");
+  }
+
+  int getBatchSize() const override { return 0; }
+  double getTolerance() const override { return 1e-4; }
+
+public:
+  using ModelKernel::ModelKernel;
+
+  string getName() const override { return "linear_regression_predict"; }
+  string getExample() const override { return "linear_regression"; }
+};
+
+// Kernel of kmeans: assigns the test data to the precomputed centers.
+class KMeansKernel : public ModelKernel
+{
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    shared_ptr<KMeansPlain> kp = make_shared<KMeansPlain>();
+    kp->initFromFiles(PlainModelHyperParams(),
+                      {getDataSetsDir() + "/kmeans/kmeansCenters.csv"});
+    return kp;
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    return TextIoUtils::readMatrixFromCsvFile(getDataSetsDir() +
+                                              "/kmeans/testData.csv");
+  }
+
+  int getBatchSize() const override { return 0; }
+
+public:
+  using ModelKernel::ModelKernel;
+
+  string getName() const override { return "kmeans_predict"; }
+  string getExample() const override { return "kmeans"; }
+};
+
+// Kernel of decision_tree: the credit card fraud tree on a batch of the size
+// of the slot count, as in the example.
+class DecisionTreeKernel : public ModelKernel
+{
+protected:
+  shared_ptr<PlainModel> loadPlainModel() const override
+  {
+    PlainModelHyperParams hp;
+    hp.load(getDataSetsDir() + "/decision_tree/dtree_hyper_params.json");
+    shared_ptr<DTreePlain> dtp = make_shared<DTreePlain>();
+    dtp->initFromFiles(
+        hp, {getDataSetsDir() + "/decision_tree/creditfraud_dt.json"});
+    return dtp;
+  }
+
+  DoubleTensor loadSamples(int slotCount) const override
+  {
+    DatasetPlain ds(slotCount);
+    ds.loadFromCsv(getDataSetsDir() + "/net_fraud/creditcard.csv",
+                   true /* ignoreFirstRow */,
+                   ',' /* delimiter */,
+                   1 /* maxBatches */);
+    return ds.getSamples(0);
+  }
+
+  int getBatchSize() const override { return 0; }
+
+  // The encrypted comparisons are approximate, so samples with a feature
+  // close to a threshold of the tree may take the other branch.
+  double getTolerance() const override { return 0.5; }
+  double getMaxMismatchRate() const override { return 0.01; }
+
+public:
+  using ModelKernel::ModelKernel;
+
+  string getName() const override { return "decision_tree_predict"; }
+  string getExample() const override { return "decision_tree"; }
+};
+
+// Kernel of arima: forecasts of many encrypted series with a plain
+// ARIMA(2, 1, 1) model, as in the example.
+class ArimaKernel : public BenchKernel
+{
+  static const int numSeries = 4096;
+  static const int window = 64;
+  static const int horizon = 8;
+
+  const ArimaModel model{{0.6, -0.2}, 1, {0.3}, 0.1};
+  vector<vector<double>> series;
+  shared_ptr<ArimaForecaster> forecaster;
+  vector<CTile> encrypted;
+  vector<CTile> forecasts;
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "arima_forecast"; }
+  string getExample() const override { return "arima"; }
+  string getItemName() const override { return "series"; }
+  int getNumItems() const override { return numSeries; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    HeConfigRequirement req =
+        options.insecure
+            ? HeConfigRequirement::insecure(
+                  pow(2, 14), ArimaForecaster::getDepth(), 40, 12)
+            : HeConfigRequirement(
+                  pow(2, 14), ArimaForecaster::getDepth(), 40, 12);
+    ArimaForecaster::setRotationSteps(req, model, window, horizon);
+    return req;
+  }
+
+  void setup(HeContext& he) override
+  {
+    // Random walks, which stay within a few tens over the window.
+    mt19937_64 rng(options.seed);
+    normal_distribution<double> noise(0, 1);
+    series.assign(numSeries, vector<double>(window));
+    for (auto& values : series) {
+      values[0] = noise(rng);
+      for (int t = 1; t < window; ++t)
+        values[t] = values[t - 1] + noise(rng);
+    }
+    forecaster = make_shared<ArimaForecaster>(he, model, window, horizon);
+    encrypted = forecaster->encryptSeries(series);
+  }
+
+  void run(HeContext& he) override
+  {
+    forecasts = forecaster->forecast(encrypted);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    vector<vector<double>> res = forecaster->decrypt(forecasts, numSeries);
+    for (int s = 0; s < numSeries; ++s) {
+      vector<double> expected =
+          ArimaForecaster::forecastPlain(model, series[s], horizon);
+      for (int h = 0; h < horizon; ++h)
+        always_assert_msg(abs(res[s][h] - expected[h]) < 1e-3,
+                          "arima_forecast: wrong forecast of series " +
+                              to_string(s));
+    }
+  }
+
+  void teardown() override
+  {
+    encrypted.clear();
+    forecasts.clear();
+    forecaster.reset();
+  }
+};
+
+// Kernel of hamming_matcher: the Hamming distances between a probe and a
+// gallery of random templates, without the encrypted threshold.
+class HammingKernel : public BenchKernel
+{
+  static const int gallerySize = 4096;
+  static const int templateBits = 512;
+
+  vector<vector<uint8_t>> gallery;
+  vector<uint8_t> probe;
+  shared_ptr<HammingMatcher> matcher;
+  shared_ptr<CTile> encryptedProbe;
+  vector<CTile> distances;
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "hamming_distances"; }
+  string getExample() const override { return "hamming_matcher"; }
+  string getItemName() const override { return "templates"; }
+  int getNumItems() const override { return gallerySize; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    // Distances up to templateBits need 1 + log2(templateBits) integer bits.
+    int depth = HammingMatcher::getDepth(false, 2, 1);
+    int intBits = 1 + ceil(log2(templateBits));
+    HeConfigRequirement req =
+        options.insecure
+            ? HeConfigRequirement::insecure(pow(2, 14), depth, 40, intBits)
+            : HeConfigRequirement(pow(2, 14), depth, 40, intBits);
+    HammingMatcher::setRotationSteps(req, templateBits);
+    return req;
+  }
+
+  void setup(HeContext& he) override
+  {
+    mt19937_64 rng(options.seed);
+    bernoulli_distribution bit(0.5);
+    gallery.assign(gallerySize, vector<uint8_t>(templateBits));
+    for (auto& t : gallery)
+      for (uint8_t& b : t)
+        b = bit(rng);
+    probe.resize(templateBits);
+    for (uint8_t& b : probe)
+      b = bit(rng);
+
+    matcher = make_shared<HammingMatcher>(he, templateBits);
+    matcher->enrollGallery(gallery);
+    encryptedProbe = make_shared<CTile>(matcher->encryptProbe(probe));
+  }
+
+  void run(HeContext& he) override
+  {
+    distances = matcher->computeDistances(*encryptedProbe);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    vector<double> res = matcher->decrypt(distances);
+    for (int t = 0; t < gallerySize; ++t) {
+      int expected = 0;
+      for (int b = 0; b < templateBits; ++b)
+        expected += gallery[t][b] != probe[b];
+      always_assert_msg(round(res[t]) == expected,
+                        "hamming_distances: wrong distance of template " +
+                            to_string(t));
+    }
+  }
+
+  void teardown() override
+  {
+    distances.clear();
+    encryptedProbe.reset();
+    matcher.reset();
+  }
+};
+
+// Kernel of knn_search: the squared distances between a query and a
+// database of random vectors. The top-k selection needs bootstrapping and
+// is left to the example.
+class KnnDistancesKernel : public BenchKernel
+{
+  static const int numVectors = 4096;
+  static const int dim = 128;
+  static const int groupSize = 8;
+
+  vector<vector<double>> vectors;
+  vector<double> query;
+  shared_ptr<KnnSearch> search;
+  vector<CTile> encryptedQuery;
+  vector<CTile> distances;
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "knn_distances"; }
+  string getExample() const override { return "knn_search"; }
+  string getItemName() const override { return "vectors"; }
+  int getNumItems() const override { return numVectors; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    HeConfigRequirement req =
+        options.insecure ? HeConfigRequirement::insecure(pow(2, 14), 1, 40, 10)
+                         : HeConfigRequirement(pow(2, 14), 1, 40, 10);
+    KnnSearch::setRotationSteps(req, groupSize, false);
+    return req;
+  }
+
+  void setup(HeContext& he) override
+  {
+    // Coordinates in [-1/sqrt(dim), 1/sqrt(dim)], so squared distances are
+    // at most 4.
+    mt19937_64 rng(options.seed);
+    uniform_real_distribution<double> coord(-1 / sqrt(dim), 1 / sqrt(dim));
+    vectors.assign(numVectors, vector<double>(dim));
+    for (auto& vec : vectors)
+      for (double& x : vec)
+        x = coord(rng);
+    query = vectors[numVectors / 2];
+    for (double& x : query)
+      x += 0.01;
+
+    search = make_shared<KnnSearch>(he, dim, groupSize);
+    search->encryptDatabase(vectors);
+    encryptedQuery = search->encryptQuery(query);
+  }
+
+  void run(HeContext& he) override
+  {
+    distances = search->computeDistances(encryptedQuery);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    vector<double> res = search->decryptDistances(distances);
+    for (int i = 0; i < numVectors; ++i) {
+      double expected = 0;
+      for (int j = 0; j < dim; ++j)
+        expected += (vectors[i][j] - query[j]) * (vectors[i][j] - query[j]);
+      always_assert_msg(abs(res[i] - expected) < 1e-3,
+                        "knn_distances: wrong distance of vector " +
+                            to_string(i));
+    }
+  }
+
+  void teardown() override
+  {
+    distances.clear();
+    encryptedQuery.clear();
+    search.reset();
+  }
+};
+
+// Kernel of mnist_cnn: inference of a batch of images with the network of
+// the example, with random weights and images like its --random mode, so
+// that it needs no model file.
+class CnnPredictKernel : public BenchKernel
+{
+  static const int imageSize = 29;
+  static const int numClasses = 10;
+  static const int tileSize = 16;
+  static const int depth = 5;
+
+  shared_ptr<CnnEngine> engine;
+  shared_ptr<CTileTensor> images;
+  shared_ptr<CTileTensor> scores;
+  DoubleTensor expected;
+
+  static DoubleTensor randomTensor(mt19937_64& rng,
+                                   const vector<DimInt>& shape,
+                                   double scale)
+  {
+    uniform_real_distribution<double> uniform(-scale, scale);
+    DoubleTensor res(shape);
+    for (int i = 0; i < res.size(); ++i)
+      res.at(i) = uniform(rng);
+    return res;
+  }
+
+  static int argmax(const DoubleTensor& scores, int row)
+  {
+    int res = 0;
+    for (int c = 1; c < scores.getDimSize(1); ++c)
+      if (scores.at(row, c) > scores.at(row, res))
+        res = c;
+    return res;
+  }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "cnn_predict"; }
+  string getExample() const override { return "mnist_cnn"; }
+  string getItemName() const override { return "images"; }
+  int getNumItems() const override
+  {
+    return engine ? engine->getBatchSize() : 0;
+  }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (options.insecure)
+      return HeConfigRequirement::insecure(pow(2, 14), depth, 40, 12);
+    return HeConfigRequirement(pow(2, 14), depth, 40, 12);
+  }
+
+  void setup(HeContext& he) override
+  {
+    mt19937_64 rng(options.seed);
+    engine = make_shared<CnnEngine>(he, imageSize, imageSize, 1, tileSize);
+    engine->addConv("conv",
+                    randomTensor(rng, {5, 5, 1, 5}, 0.2),
+                    randomTensor(rng, {5}, 0.1),
+                    2);
+    engine->addSquare("square1");
+    engine->addConv("dense1",
+                    randomTensor(rng, {13, 13, 5, 100}, 0.05),
+                    randomTensor(rng, {100}, 0.1));
+    engine->addSquare("square2");
+    engine->addConv("dense2",
+                    randomTensor(rng, {1, 1, 100, numClasses}, 0.1),
+                    randomTensor(rng, {numClasses}, 0.1));
+    always_assert(engine->getDepth() == depth);
+
+    DoubleTensor plainImages = randomTensor(
+        rng, {engine->getBatchSize(), imageSize, imageSize, 1}, 1);
+    expected = engine->predictPlain(plainImages);
+    images = engine->encryptImages(plainImages);
+  }
+
+  void run(HeContext& he) override
+  {
+    // predict() replaces its input with the output.
+    scores = make_shared<CTileTensor>(*images);
+    engine->predict(scores);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    DoubleTensor res = engine->decryptOutput(*scores, engine->getBatchSize());
+    for (int i = 0; i < engine->getBatchSize(); ++i)
+      always_assert_msg(argmax(res, i) == argmax(expected, i),
+                        "cnn_predict: wrong class of image " + to_string(i));
+  }
+
+  void teardown() override
+  {
+    scores.reset();
+    images.reset();
+    engine.reset();
+  }
+};
+
+// Kernel of one_hot_encoding: the one-hot encoding of encrypted categorical
+// features, without the model that follows it.
+class OneHotKernel : public BenchKernel
+{
+  static const int numSamples = 4096;
+
+  const vector<int> numCategories = {4, 8, 3, 6};
+  vector<vector<int>> codes;
+  shared_ptr<OneHotEncoder> oneHot;
+  shared_ptr<CTileTensor> encryptedCodes;
+  shared_ptr<CTileTensor> encoded;
+
+  // The depth of the encoding depends only on the largest number of
+  // categories, see OneHotEncoder::getDepth().
+  int getDepth() const
+  {
+    int maxCategories =
+        *max_element(numCategories.begin(), numCategories.end());
+    return maxCategories == 1 ? 0 : 2 + ceil(log2(maxCategories - 1));
+  }
+
+public:
+  using BenchKernel::BenchKernel;
+
+  string getName() const override { return "one_hot_encode"; }
+  string getExample() const override { return "one_hot_encoding"; }
+  string getItemName() const override { return "samples"; }
+  int getNumItems() const override { return numSamples; }
+  bool requiresModularArithmetic() const override { return false; }
+
+  HeConfigRequirement getRequirement() const override
+  {
+    if (options.insecure)
+      return HeConfigRequirement::insecure(pow(2, 14), getDepth(), 40, 16);
+    return HeConfigRequirement(pow(2, 14), getDepth(), 40, 16);
+  }
+
+  void setup(HeContext& he) override
+  {
+    oneHot = make_shared<OneHotEncoder>(he, numCategories);
+    always_assert(oneHot->getDepth() == getDepth());
+    mt19937_64 rng(options.seed);
+    codes.assign(numSamples, vector<int>());
+    for (auto& sample : codes)
+      for (int n : numCategories)
+        sample.push_back(uniform_int_distribution<int>(0, n - 1)(rng));
+    encryptedCodes = make_shared<CTileTensor>(oneHot->encryptCodes(codes));
+  }
+
+  void run(HeContext& he) override
+  {
+    encoded = make_shared<CTileTensor>(*encryptedCodes);
+    oneHot->encode(*encoded);
+  }
+
+  void verify(HeContext& he) const override
+  {
+    TTEncoder enc(he);
+    DoubleTensor res = enc.decryptDecodeDouble(*encoded);
+    DoubleTensor expected = oneHot->encodePlain(codes);
+    for (int i = 0; i < expected.size(); ++i)
+      always_assert_msg(abs(res.at(i) - expected.at(i)) < 1e-3,
+                        "one_hot_encode: wrong value at " + to_string(i));
+  }
+
+  void teardown() override
+  {
+    encoded.reset();
+    encryptedCodes.reset();
+    oneHot.reset();
+  }
+};
+
+HeConfigRequirement getTrackingRequirement(HeConfigRequirement req)
+{
+  req.securityLevel = 0;
+  if (req.bootstrappable) {
+    req.bootstrapConfig = BootstrapConfig();
+    req.bootstrapConfig->targetChainIndex = 12;
+    req.bootstrapConfig->minChainIndexForBootstrapping = 3;
+  }
+  return req;
+}
+
+vector<shared_ptr<BenchKernel>> createKernels(const BenchOptions& options)
+{
+  return {make_shared<BasicsKernel>(options),
+          make_shared<InnerProductKernel>(options),
+          make_shared<LifeStepKernel>(options),
+          make_shared<LifeStepLutKernel>(options),
+          make_shared<CountryLookupKernel>(options),
+          make_shared<CountryLookupLutKernel>(options),
+          make_shared<CountQueryKernel>(options),
+          make_shared<NeuralNetKernel>(options,
+                                       "nn_fraud_predict",
+                                       "02_NeuralNetwork_FraudDetection",
+                                       "net_fraud",
+                                       4096),
+          make_shared<LrFraudPredictKernel>(options),
+          make_shared<NeuralNetKernel>(options,
+                                       "text_classification_predict",
+                                       "04_Text_Classification",
+                                       "text_classification",
+                                       8),
+          make_shared<DecisionTreeKernel>(options),
+          make_shared<KMeansKernel>(options),
+          make_shared<LinearRegressionKernel>(options),
+          make_shared<LrPredictKernel>(options),
+          make_shared<ArimaKernel>(options),
+          make_shared<HammingKernel>(options),
+          make_shared<KnnDistancesKernel>(options),
+          make_shared<CnnPredictKernel>(options),
+          make_shared<OneHotKernel>(options)};
+}
+
+vector<pair<string, string>> getUncoveredExamples()
+{
+  const string notPorted = "not ported yet";
+  return {{"multi_party_fhe", "needs several key holders"},
+          {"circuit", "runs on its own CircuitContext"},
+          {"er", "RecordLinkageManager manages its own context"},
+          {"generating_keys_homomorphicaly",
+           "re-encrypts with OpenFHE directly, outside any HeContext"},
+          {"BLEACH", notPorted},
+          {"bitwise_cmp", notPorted},
+          {"fhe_db", notPorted},
+          {"psi_federated_learning", notPorted}};
+}
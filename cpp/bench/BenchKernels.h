@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef BENCH_KERNELS_H_
+#define BENCH_KERNELS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Options shared by all kernels, so that every backend runs a kernel with
+// exactly the same parameters.
+struct BenchOptions
+{
+  // Use HeConfigRequirement::insecure() parameters for all backends.
+  bool insecure = false;
+  // Number of database entries used by the lookup kernel.
+  int lookupEntries = 8;
+  // Board side length used by the game of life kernel.
+  int boardSize = 64;
+  // Number of database elements used by the count query kernel.
+  int countElements = 16;
+  // Generate the datasets (see common/DataGenerator.h) instead of reading
+  // them from getDataSetsDir().
+  bool synthetic = false;
+  // Seed of all generated data.
+  uint64_t seed = 17;
+};
+
+// The core computation of one of the examples, stripped of its command line
+// handling and printing. setup() encrypts the inputs, run() is the measured
+// part and verify() checks the result of the last run() against a plaintext
+// computation. teardown() releases the ciphertexts of the kernel, and must be
+// called before the context they belong to is destroyed.
+class BenchKernel
+{
+protected:
+  BenchOptions options;
+
+public:
+  explicit BenchKernel(const BenchOptions& options) : options(options) {}
+
+  virtual ~BenchKernel() {}
+
+  // Short name used on the command line and in the report.
+  virtual std::string getName() const = 0;
+
+  // The example directory this kernel is taken from.
+  virtual std::string getExample() const = 0;
+
+  // The unit counted by getNumItems(), e.g. "cells" or "lookups".
+  virtual std::string getItemName() const = 0;
+
+  // Number of items processed by a single run(). Used for throughput.
+  virtual int getNumItems() const = 0;
+
+  // Whether the kernel needs a scheme with modular arithmetic (BGV) or
+  // approximate arithmetic (CKKS).
+  virtual bool requiresModularArithmetic() const = 0;
+
+  // Whether the kernel relies on automatic bootstrapping.
+  virtual bool requiresBootstrapping() const { return false; }
+
+  virtual helayers::HeConfigRequirement getRequirement() const = 0;
+
+  virtual void setup(helayers::HeContext& he) = 0;
+
+  virtual void run(helayers::HeContext& he) = 0;
+
+  virtual void verify(helayers::HeContext& he) const = 0;
+
+  virtual void teardown() = 0;
+};
+
+// Adapts the requirement of a kernel to a TrackingContext (mockup or empty),
+// the same way the copy_and_recurse examples do: security is turned off and
+// bootstrapping uses a shallow chain.
+helayers::HeConfigRequirement getTrackingRequirement(
+    helayers::HeConfigRequirement req);
+
+// Returns all kernels, in report order.
+std::vector<std::shared_ptr<BenchKernel>> createKernels(
+    const BenchOptions& options);
+
+// Returns the examples that have no kernel, each with the reason.
+std::vector<std::pair<std::string, std::string>> getUncoveredExamples();
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "BenchReport.h"
+
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+using namespace std;
+
+static string jsonString(const string& s)
+{
+  string res = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      res += '\\';
+    if (c == '\n')
+      res += "\\n";
+    else if (c != '\r')
+      res += c;
+  }
+  return res + "\"";
+}
+
+static string csvString(const string& s)
+{
+  if (s.find_first_of(",\"\n") == string::npos)
+    return s;
+  string res = "\"";
+  for (char c : s) {
+    if (c == '"')
+      res += '"';
+    res += c;
+  }
+  return res + "\"";
+}
+
+static string trim(const string& s)
+{
+  size_t start = s.find_first_not_of(" \t");
+  if (start == string::npos)
+    return "";
+  size_t end = s.find_last_not_of(" \t\r");
+  return s.substr(start, end - start + 1);
+}
+
+void BenchReport::writeJson(ostream& out) const
+{
+  out << setprecision(9);
+  out << "{" << endl << "  \"results\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    out << (i == 0 ? "" : ",") << endl;
+    out << "    {" << endl;
+    out << "      \"kernel\": " << jsonString(r.kernel) << "," << endl;
+    out << "      \"example\": " << jsonString(r.example) << "," << endl;
+    out << "      \"backend\": " << jsonString(r.backend) << "," << endl;
+    out << "      \"status\": " << jsonString(r.status) << "," << endl;
+    out << "      \"message\": " << jsonString(r.message) << "," << endl;
+    out << "      \"repetitions\": " << r.repetitions << "," << endl;
+    out << "      \"setup_seconds\": " << r.setupSeconds << "," << endl;
+    out << "      \"mean_latency_seconds\": " << r.meanLatencySeconds << ","
+        << endl;
+    out << "      \"min_latency_seconds\": " << r.minLatencySeconds << ","
+        << endl;
+    out << "      \"items\": " << r.numItems << "," << endl;
+    out << "      \"item_name\": " << jsonString(r.itemName) << "," << endl;
+    out << "      \"throughput_items_per_second\": " << r.throughput << ","
+        << endl;
+    out << "      \"used_ram_mb\": " << r.usedRamMb << "," << endl;
+    out << "      \"ram_delta_mb\": " << r.ramDeltaMb << "," << endl;
+    out << "      \"pool_mode\": " << jsonString(r.poolMode) << "," << endl;
+    out << "      \"pool_requests\": " << r.poolRequests << "," << endl;
+    out << "      \"pool_allocated_mb\": " << r.poolAllocatedMb << ","
+        << endl;
+    out << "      \"op_counts\": {";
+    bool first = true;
+    for (const auto& op : r.opCounts) {
+      out << (first ? "" : ", ") << jsonString(op.first) << ": " << op.second;
+      first = false;
+    }
+    out << "}" << endl << "    }";
+  }
+  out << endl << "  ]" << endl << "}" << endl;
+}
+
+void BenchReport::writeCsv(ostream& out) const
+{
+  set<string> opNames;
+  for (const BenchResult& r : results)
+    for (const auto& op : r.opCounts)
+      opNames.insert(op.first);
+
+  out << setprecision(9);
+  out << "kernel,example,backend,status,message,repetitions,setup_seconds,"
+         "mean_latency_seconds,min_latency_seconds,items,item_name,"
+         "throughput_items_per_second,used_ram_mb,ram_delta_mb,pool_mode,"
+         "pool_requests,pool_allocated_mb";
+  for (const string& name : opNames)
+    out << "," << csvString("ops_" + name);
+  out << endl;
+
+  for (const BenchResult& r : results) {
+    out << csvString(r.kernel) << "," << csvString(r.example) << ","
+        << csvString(r.backend) << "," << r.status << ","
+        << csvString(r.message) << "," << r.repetitions << ","
+        << r.setupSeconds << "," << r.meanLatencySeconds << ","
+        << r.minLatencySeconds << "," << r.numItems << "," << r.itemName
+        << "," << r.throughput << "," << r.usedRamMb << "," << r.ramDeltaMb
+        << "," << r.poolMode << "," << r.poolRequests << ","
+        << r.poolAllocatedMb;
+    for (const string& name : opNames) {
+      out << ",";
+      auto it = r.opCounts.find(name);
+      if (it != r.opCounts.end())
+        out << it->second;
+    }
+    out << endl;
+  }
+}
+
+void BenchReport::printSummary(ostream& out) const
+{
+  out << left << setw(16) << "kernel" << setw(14) << "backend" << setw(9)
+      << "status" << right << setw(14) << "latency (s)" << setw(18)
+      << "throughput (/s)" << setw(10) << "RAM (MB)" << endl;
+  for (const BenchResult& r : results) {
+    out << left << setw(16) << r.kernel << setw(14) << r.backend << setw(9)
+        << r.status << right;
+    if (r.status == "ok")
+      out << setw(14) << r.meanLatencySeconds << setw(18) << r.throughput
+          << setw(10) << r.usedRamMb;
+    else
+      out << "  " << r.message;
+    out << endl;
+  }
+}
+
+void BenchReport::printPoolSummary(ostream& out) const
+{
+  out << left << setw(16) << "kernel" << setw(10) << "pool" << right
+      << setw(14) << "latency (s)" << setw(12) << "saved (s)" << setw(10)
+      << "saved" << setw(12) << "requests" << setw(16) << "allocated (MB)"
+      << endl;
+  for (const BenchResult& base : results) {
+    if (base.poolMode != "new" || base.status != "ok")
+      continue;
+    for (const BenchResult& r : results) {
+      if (r.kernel != base.kernel || r.poolMode.empty() || r.status != "ok")
+        continue;
+      double saved = base.meanLatencySeconds - r.meanLatencySeconds;
+      out << left << setw(16) << r.kernel << setw(10) << r.poolMode << right
+          << setw(14) << r.meanLatencySeconds << setw(12) << saved << setw(9)
+          << fixed << setprecision(1) << 100 * saved / base.meanLatencySeconds
+          << "%" << defaultfloat << setprecision(6) << setw(12)
+          << r.poolRequests << setw(16);
+      if (r.poolAllocatedMb < 0)
+        out << "-";
+      else
+        out << r.poolAllocatedMb;
+      out << endl;
+    }
+  }
+}
+
+map<string, double> BenchReport::parseOpCounts(const string& stats)
+{
+  map<string, double> res;
+  istringstream in(stats);
+  string line;
+  while (getline(in, line)) {
+    size_t sep = line.rfind(':');
+    if (sep == string::npos)
+      continue;
+    string name = trim(line.substr(0, sep));
+    string value = trim(line.substr(sep + 1));
+    if (name.empty() || value.empty())
+      continue;
+    size_t parsed = 0;
+    double count;
+    try {
+      count = stod(value, &parsed);
+    } catch (const exception&) {
+      continue;
+    }
+    if (parsed == value.size())
+      res[name] = count;
+  }
+  return res;
+}
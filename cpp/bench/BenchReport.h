@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef BENCH_REPORT_H_
+#define BENCH_REPORT_H_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// The measurements of one kernel under one backend.
+struct BenchResult
+{
+  std::string kernel;
+  std::string example;
+  std::string backend;
+  // "ok", "skipped" or "failed". message explains the latter two.
+  std::string status;
+  std::string message;
+
+  int repetitions = 0;
+  double setupSeconds = 0;
+  double meanLatencySeconds = 0;
+  double minLatencySeconds = 0;
+  int numItems = 0;
+  std::string itemName;
+  // Items per second, computed from the mean latency.
+  double throughput = 0;
+  // Resident memory after the measured runs, and its growth since the
+  // context was created, in MB.
+  int usedRamMb = 0;
+  int ramDeltaMb = 0;
+  // SEAL backends with a memory pool mode (see SealMemoryPool.h) report the
+  // requests for a pool and the MB the pools obtained from the system, per
+  // measured run. -1 where they are not counted.
+  std::string poolMode;
+  double poolRequests = -1;
+  double poolAllocatedMb = -1;
+  // Operation counts of a single run. Only backends that are a
+  // TrackingContext (e.g. mockup) report them.
+  std::map<std::string, double> opCounts;
+};
+
+class BenchReport
+{
+  std::vector<BenchResult> results;
+
+public:
+  void add(const BenchResult& result) { results.push_back(result); }
+
+  const std::vector<BenchResult>& getResults() const { return results; }
+
+  void writeJson(std::ostream& out) const;
+
+  // One row per kernel and backend. Every operation name that appears in any
+  // result gets its own "ops_<name>" column.
+  void writeCsv(std::ostream& out) const;
+
+  void printSummary(std::ostream& out) const;
+
+  // Compares the results of every kernel under the SEAL memory pool modes
+  // with its result without pooling ("new"), which is what the pools save.
+  void printPoolSummary(std::ostream& out) const;
+
+  // Parses the output of TrackingContext::printStatsAndClear(). Every line of
+  // the form "<name>: <number>" becomes an entry.
+  static std::map<std::string, double> parseOpCounts(const std::string& stats);
+};
+
+#endif
@@ -0,0 +1,355 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// See more information about this benchmark in the readme file.
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/openfhe/OpenFheBgvContext.h"
+#include "helayers/hebase/openfhe/OpenFheCkksContext.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "BenchKernels.h"
+#include "BenchReport.h"
+#include "SealMemoryPool.h"
+
+using namespace std;
+using namespace chrono;
+using namespace helayers;
+
+struct Backend
+{
+  string name;
+  // Whether the backend implements a scheme with modular arithmetic (BGV).
+  bool modularArithmetic;
+  bool bootstrapping;
+  function<shared_ptr<HeContext>()> create;
+  // The SEAL memory pool mode the backend runs with, if it is counted.
+  optional<SealPoolMode> sealPool;
+};
+
+// With sealPools, seal runs with its default global memory pool counted, and
+// is followed by a backend for every other pool mode.
+static vector<Backend> getBackends(bool sealPools)
+{
+  auto createSeal = [] { return make_shared<SealCkksContext>(); };
+  vector<Backend> backends = {
+      {"seal", false, false, createSeal},
+      {"openfhe-ckks",
+       false,
+       true,
+       [] { return make_shared<OpenFheCkksContext>(); }},
+      {"openfhe-bgv",
+       true,
+       false,
+       [] { return make_shared<OpenFheBgvContext>(); }},
+      {"mockup", false, true, [] { return make_shared<MockupContext>(); }},
+  };
+  if (sealPools) {
+    backends[0].sealPool = SealPoolMode::GLOBAL;
+    for (SealPoolMode mode : {SealPoolMode::NONE,
+                              SealPoolMode::CONTEXT,
+                              SealPoolMode::THREAD_LOCAL})
+      backends.insert(backends.begin() + 1,
+                      {"seal-" + getSealPoolModeName(mode),
+                       false,
+                       false,
+                       createSeal,
+                       mode});
+  }
+  return backends;
+}
+
+static vector<string> splitList(const string& list)
+{
+  vector<string> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(item);
+  return res;
+}
+
+static bool selected(const vector<string>& list, const string& name)
+{
+  return list.empty() || find(list.begin(), list.end(), name) != list.end();
+}
+
+static double secondsSince(high_resolution_clock::time_point start)
+{
+  return duration<double>(high_resolution_clock::now() - start).count();
+}
+
+static BenchResult runKernel(BenchKernel& kernel,
+                             const Backend& backend,
+                             int repetitions)
+{
+  BenchResult result;
+  result.kernel = kernel.getName();
+  result.example = kernel.getExample();
+  result.backend = backend.name;
+  result.itemName = kernel.getItemName();
+
+  if (kernel.requiresModularArithmetic() != backend.modularArithmetic) {
+    result.status = "skipped";
+    result.message = kernel.requiresModularArithmetic()
+                         ? "requires modular arithmetic"
+                         : "requires approximate arithmetic";
+    return result;
+  }
+  if (kernel.requiresBootstrapping() && !backend.bootstrapping) {
+    result.status = "skipped";
+    result.message = "requires bootstrapping";
+    return result;
+  }
+
+  // Switched in before the context is created, so that the keys and the
+  // kernel's setup allocate from the pool too.
+  unique_ptr<SealMemoryPool> pool;
+  if (backend.sealPool) {
+    pool = make_unique<SealMemoryPool>(*backend.sealPool);
+    result.poolMode = getSealPoolModeName(*backend.sealPool);
+  }
+  shared_ptr<HeContext> he;
+  try {
+    he = backend.create();
+    HeConfigRequirement req = kernel.getRequirement();
+    // The mockup context does not implement real encryption, so security
+    // requirements are meaningless for it.
+    TrackingContext* tracking = dynamic_cast<TrackingContext*>(he.get());
+    if (tracking != nullptr)
+      req = getTrackingRequirement(req);
+    he->init(req);
+    always_assert(he->getTraits().isModularArithmetic() ==
+                  kernel.requiresModularArithmetic());
+
+    int ramBefore = MemoryUtils::getUsedRam();
+
+    auto start = high_resolution_clock::now();
+    kernel.setup(*he);
+    result.setupSeconds = secondsSince(start);
+
+    // A first, unmeasured run checks the result and collects the operation
+    // counts.
+    if (tracking != nullptr)
+      tracking->startOperationCountTrack();
+    kernel.run(*he);
+    if (tracking != nullptr) {
+      stringstream stats;
+      tracking->printStatsAndClear(stats);
+      result.opCounts = BenchReport::parseOpCounts(stats.str());
+    }
+    kernel.verify(*he);
+
+    SealMemoryPool::Stats poolBefore;
+    if (pool)
+      poolBefore = pool->getStats();
+    double total = 0;
+    result.minLatencySeconds = -1;
+    for (int i = 0; i < repetitions; ++i) {
+      HELAYERS_TIMER_PUSH(kernel.getName() + "-" + backend.name);
+      start = high_resolution_clock::now();
+      kernel.run(*he);
+      double latency = secondsSince(start);
+      HELAYERS_TIMER_POP();
+      total += latency;
+      if (result.minLatencySeconds < 0 || latency < result.minLatencySeconds)
+        result.minLatencySeconds = latency;
+    }
+
+    if (pool) {
+      SealMemoryPool::Stats poolAfter = pool->getStats();
+      result.poolRequests =
+          (double)(poolAfter.requests - poolBefore.requests) / repetitions;
+      if (poolAfter.allocatedBytes >= 0)
+        result.poolAllocatedMb =
+            (poolAfter.allocatedBytes - poolBefore.allocatedBytes) / 1e6 /
+            repetitions;
+    }
+
+    result.repetitions = repetitions;
+    result.meanLatencySeconds = total / repetitions;
+    result.numItems = kernel.getNumItems();
+    result.throughput = result.numItems / result.meanLatencySeconds;
+    result.usedRamMb = MemoryUtils::getUsedRam();
+    result.ramDeltaMb = result.usedRamMb - ramBefore;
+    result.status = "ok";
+  } catch (const exception& e) {
+    result.status = "failed";
+    result.message = e.what();
+  }
+  // The ciphertexts of the kernel belong to he, so they are released before
+  // it is destroyed.
+  kernel.teardown();
+  return result;
+}
+
+void usage()
+{
+  cout << "Usage:" << endl;
+  cout << endl;
+  cout << "\t--backends <list>\t\tComma separated backends to run "
+          "(default: all)"
+       << endl;
+  cout << "\t--kernels <list>\t\tComma separated kernels to run "
+          "(default: all)"
+       << endl;
+  cout << "\t--repetitions <int>\t\tMeasured runs per kernel (default: 3)"
+       << endl;
+  cout << "\t--insecure\t\t\tUse insecure parameters for all kernels" << endl;
+  cout << "\t--lookup_entries <int>\t\tDatabase size of country_lookup "
+          "(default: 8)"
+       << endl;
+  cout << "\t--board_size <int>\t\tBoard side of life_step (default: 64)"
+       << endl;
+  cout << "\t--count_elements <int>\t\tDatabase size of count_query "
+          "(default: 16)"
+       << endl;
+  cout << "\t--synthetic\t\t\tGenerate the datasets instead of reading "
+          "them from the data directory"
+       << endl;
+  cout << "\t--seed <int>\t\t\tSeed of all generated data (default: 17)"
+       << endl;
+  cout << "\t--json <file>\t\t\tJSON report (default: helayers_bench.json)"
+       << endl;
+  cout << "\t--csv <file>\t\t\tCSV report (default: helayers_bench.csv)"
+       << endl;
+  cout << "\t--seal_pools\t\t\tAlso run seal with every memory pool mode "
+          "and compare them"
+       << endl;
+  cout << "\t--list\t\t\t\tList the backends and kernels" << endl;
+  cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  BenchOptions options;
+  vector<string> backendNames;
+  vector<string> kernelNames;
+  int repetitions = 3;
+  string jsonFile = "helayers_bench.json";
+  string csvFile = "helayers_bench.csv";
+  bool list = false;
+  bool sealPools = false;
+
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--help") {
+      usage();
+      return 0;
+    }
+    if (arg == "--backends" && i < argc)
+      backendNames = splitList(argv[i++]);
+    else if (arg == "--kernels" && i < argc)
+      kernelNames = splitList(argv[i++]);
+    else if (arg == "--repetitions" && i < argc)
+      repetitions = stoi(argv[i++]);
+    else if (arg == "--insecure")
+      options.insecure = true;
+    else if (arg == "--lookup_entries" && i < argc)
+      options.lookupEntries = stoi(argv[i++]);
+    else if (arg == "--board_size" && i < argc)
+      options.boardSize = stoi(argv[i++]);
+    else if (arg == "--count_elements" && i < argc)
+      options.countElements = stoi(argv[i++]);
+    else if (arg == "--synthetic")
+      options.synthetic = true;
+    else if (arg == "--seed" && i < argc)
+      options.seed = stoull(argv[i++]);
+    else if (arg == "--json" && i < argc)
+      jsonFile = argv[i++];
+    else if (arg == "--csv" && i < argc)
+      csvFile = argv[i++];
+    else if (arg == "--list")
+      list = true;
+    else if (arg == "--seal_pools")
+      sealPools = true;
+    else {
+      usage();
+      throw runtime_error("Unsupported argument: " + arg);
+    }
+  }
+  always_assert(repetitions > 0);
+
+  vector<Backend> backends = getBackends(sealPools);
+  vector<shared_ptr<BenchKernel>> kernels = createKernels(options);
+
+  if (list) {
+    cout << "Backends:" << endl;
+    for (const Backend& backend : backends)
+      cout << "\t" << backend.name << endl;
+    cout << "Kernels:" << endl;
+    for (const auto& kernel : kernels)
+      cout << "\t" << kernel->getName() << " (" << kernel->getExample() << ")"
+           << endl;
+    cout << "Examples without a kernel:" << endl;
+    for (const auto& example : getUncoveredExamples())
+      cout << "\t" << example.first << " (" << example.second << ")" << endl;
+    return 0;
+  }
+
+  BenchReport report;
+  for (const auto& kernel : kernels) {
+    if (!selected(kernelNames, kernel->getName()))
+      continue;
+    for (const Backend& backend : backends) {
+      if (!selected(backendNames, backend.name))
+        continue;
+      cout << "Running " << kernel->getName() << " on " << backend.name
+           << " . . ." << endl;
+      report.add(runKernel(*kernel, backend, repetitions));
+    }
+  }
+
+  cout << endl;
+  report.printSummary(cout);
+  if (sealPools) {
+    cout << endl << "SEAL memory pools, per measured run:" << endl;
+    report.printPoolSummary(cout);
+  }
+  cout << getUncoveredExamples().size()
+       << " examples have no kernel, see --list" << endl;
+
+  ofstream json(jsonFile);
+  report.writeJson(json);
+  ofstream csv(csvFile);
+  report.writeCsv(csv);
+  cout << endl << "Reports written to " << jsonFile << " and " << csvFile
+       << endl;
+
+  for (const BenchResult& r : report.getResults())
+    if (r.status == "failed")
+      return 1;
+  return 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// See more information about this program in the readme file.
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/mockup/EmptyContext.h"
+#include "BenchKernels.h"
+#include "BenchReport.h"
+
+using namespace std;
+using namespace helayers;
+
+// Runs the kernels of helayers_bench under an EmptyContext, which counts HE
+// operations without performing any cryptography, and compares the counts of
+// ciphertext-ciphertext multiplications, squares, rotations and bootstraps
+// with a golden file. Any increase, and any kernel missing from the golden
+// file, fails the run. Run with --update after an intended change of the
+// counts.
+
+// kernel -> operation -> count
+typedef map<string, map<string, double>> OpCounts;
+
+// Returns the guarded operation that the counted operation name belongs to,
+// or an empty string if it is not guarded. Only the expensive operations are
+// guarded: additions, and multiplications by plaintexts or scalars, change
+// with harmless refactorings and cost little.
+static string getGuardedOperation(const string& name)
+{
+  string lower = name;
+  transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+  auto contains = [&lower](const string& s) {
+    return lower.find(s) != string::npos;
+  };
+  if (contains("boot"))
+    return "bootstrap";
+  if (contains("rot"))
+    return "rotate";
+  if (contains("square"))
+    return "square";
+  if (contains("mul") && !contains("plain") && !contains("scalar"))
+    return "multiply";
+  return "";
+}
+
+static OpCounts loadGolden(const string& fileName)
+{
+  ifstream in(fileName);
+  if (!in)
+    throw runtime_error("Failed to open golden file " + fileName +
+                        ". Run with --update to create it.");
+  OpCounts res;
+  string line;
+  getline(in, line); // header
+  while (getline(in, line)) {
+    if (line.empty())
+      continue;
+    stringstream ss(line);
+    string kernel, op, count;
+    getline(ss, kernel, ',');
+    getline(ss, op, ',');
+    getline(ss, count, ',');
+    res[kernel][op] = stod(count);
+  }
+  return res;
+}
+
+static void saveGolden(const string& fileName, const OpCounts& counts)
+{
+  ofstream out(fileName);
+  if (!out)
+    throw runtime_error("Failed to open " + fileName);
+  out << "kernel,operation,count" << endl;
+  for (const auto& kernel : counts)
+    for (const auto& op : kernel.second)
+      out << kernel.first << "," << op.first << "," << op.second << endl;
+}
+
+static map<string, double> countKernel(BenchKernel& kernel)
+{
+  shared_ptr<EmptyContext> he = make_shared<EmptyContext>();
+  he->init(getTrackingRequirement(kernel.getRequirement()));
+  kernel.setup(*he);
+
+  he->startOperationCountTrack();
+  kernel.run(*he);
+  stringstream stats;
+  he->printStatsAndClear(stats);
+
+  kernel.teardown();
+
+  map<string, double> res;
+  for (const auto& op : BenchReport::parseOpCounts(stats.str())) {
+    string guarded = getGuardedOperation(op.first);
+    if (!guarded.empty() && op.second > 0)
+      res[guarded] += op.second;
+  }
+  return res;
+}
+
+void usage()
+{
+  cout << "Usage:" << endl;
+  cout << endl;
+  cout << "\t--golden <file>\t\tGolden counts (default: op_counts_golden.csv)"
+       << endl;
+  cout << "\t--update\t\tOverwrite the golden file with the current counts"
+       << endl;
+  cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  string goldenFile = "op_counts_golden.csv";
+  bool update = false;
+
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--help") {
+      usage();
+      return 0;
+    }
+    if (arg == "--golden" && i < argc)
+      goldenFile = argv[i++];
+    else if (arg == "--update")
+      update = true;
+    else {
+      usage();
+      throw runtime_error("Unsupported argument: " + arg);
+    }
+  }
+
+  // The kernels use their default options, which the golden file refers to.
+  BenchOptions options;
+  OpCounts current;
+  vector<string> unguarded;
+  for (const auto& kernel : createKernels(options)) {
+    // EmptyContext implements approximate arithmetic only, so the kernels
+    // that need modular arithmetic have no guard.
+    if (kernel->requiresModularArithmetic()) {
+      cout << "NOT GUARDED " << kernel->getName()
+           << " (requires modular arithmetic)" << endl;
+      unguarded.push_back(kernel->getName());
+      continue;
+    }
+    cout << "Counting operations of " << kernel->getName() << " . . ." << endl;
+    current[kernel->getName()] = countKernel(*kernel);
+  }
+
+  if (update) {
+    saveGolden(goldenFile, current);
+    cout << "Golden counts written to " << goldenFile << endl;
+    return 0;
+  }
+
+  OpCounts golden = loadGolden(goldenFile);
+  int regressions = 0;
+  int improvements = 0;
+  int missing = 0;
+  for (const auto& kernel : current) {
+    if (golden.count(kernel.first) == 0) {
+      cout << "MISSING    " << kernel.first << ": no golden counts" << endl;
+      missing++;
+      continue;
+    }
+    const map<string, double>& expected = golden[kernel.first];
+    for (const auto& op : kernel.second) {
+      auto it = expected.find(op.first);
+      double before = it == expected.end() ? 0 : it->second;
+      if (op.second > before) {
+        cout << "REGRESSION " << kernel.first << " " << op.first << ": "
+             << before << " -> " << op.second << endl;
+        regressions++;
+      } else if (op.second < before) {
+        cout << "improved   " << kernel.first << " " << op.first << ": "
+             << before << " -> " << op.second << endl;
+        improvements++;
+      }
+    }
+    for (const auto& op : expected)
+      if (kernel.second.count(op.first) == 0) {
+        cout << "improved   " << kernel.first << " " << op.first << ": "
+             << op.second << " -> 0" << endl;
+        improvements++;
+      }
+  }
+
+  if (!unguarded.empty()) {
+    cout << unguarded.size() << " kernel(s) not guarded:";
+    for (const string& name : unguarded)
+      cout << " " << name;
+    cout << endl;
+  }
+  if (improvements > 0)
+    cout << "Some counts decreased, run with --update to lock them in."
+         << endl;
+  if (missing > 0)
+    cout << missing << " kernel(s) missing from " << goldenFile
+         << ", run with --update to add them." << endl;
+  if (regressions > 0)
+    cout << regressions << " operation count(s) increased." << endl;
+  if (regressions > 0 || missing > 0)
+    return 1;
+  cout << "No operation count increased." << endl;
+  return 0;
+}
@@ -0,0 +1,553 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// See more information about this program in the readme file.
+
+#include <omp.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "helayers/ai/AiGlobals.h"
+#include "helayers/ai/DatasetPlain.h"
+#include "helayers/ai/HeModel.h"
+#include "helayers/ai/logistic_regression/LogisticRegression.h"
+#include "helayers/ai/nn/NeuralNet.h"
+#include "helayers/db/Table.h"
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/openfhe/OpenFheCkksContext.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/utils/TextIoUtils.h"
+#include "BenchKernels.h"
+#include "DataGenerator.h"
+#include "TraceRecorder.h"
+
+using namespace std;
+using namespace chrono;
+using namespace helayers;
+
+// Reruns HE kernels at an increasing number of OpenMP threads and reports
+// speedup, parallel efficiency and the Karp-Flatt serial fraction, both for
+// the whole kernel and for each of its phases. Phases are the trace spans
+// (see common/TraceRecorder.h) that a kernel opens on the calling thread.
+
+namespace {
+
+// A kernel measured at several thread counts. setup() runs once with all
+// threads, run() is the measured part.
+class ScalingKernel
+{
+public:
+  virtual ~ScalingKernel() {}
+  virtual string getName() const = 0;
+  virtual void setup() = 0;
+  virtual void run() = 0;
+
+  // What the phases of the kernel do not break down further, printed with
+  // its report (empty if nothing).
+  virtual string getPhaseNote() const { return ""; }
+};
+
+// NeuralNetwork_FraudDetection: encrypted inference of a batch, from
+// encrypting the samples to decrypting the predictions.
+class NnPredictKernel : public ScalingKernel
+{
+  int batchSize;
+  shared_ptr<HeModel> nn;
+  shared_ptr<HeContext> he;
+  shared_ptr<ModelIoEncoder> modelIoEncoder;
+  DoubleTensorCPtr plainSamples;
+
+public:
+  explicit NnPredictKernel(int batchSize) : batchSize(batchSize) {}
+
+  string getName() const override { return "nn_predict"; }
+
+  void setup() override
+  {
+    string inputPath = getDataSetsDir() + "/net_fraud";
+    DatasetPlain ds(batchSize);
+    ds.loadFromH5(
+        inputPath + "/x_test.h5", "x_test", inputPath + "/y_test.h5", "y_test");
+    plainSamples = make_shared<DoubleTensor>(ds.getSamples(0));
+
+    HeRunRequirements heRunReq;
+    heRunReq.setHeContextOptions({make_shared<SealCkksContext>()});
+    heRunReq.optimizeForBatchSize(batchSize);
+    nn = make_shared<NeuralNet>();
+    nn->encodeEncrypt({inputPath + "/model.json", inputPath + "/model.h5"},
+                      heRunReq);
+    he = nn->getCreatedHeContext();
+    modelIoEncoder = make_shared<ModelIoEncoder>(*nn);
+  }
+
+  void run() override
+  {
+    EncryptedData samples(*he);
+    {
+      HELAYERS_TRACE_SECTION("encode");
+      modelIoEncoder->encodeEncrypt(samples, {plainSamples});
+    }
+    EncryptedData predictions(*he);
+    {
+      HELAYERS_TRACE_SECTION("predict");
+      nn->predict(predictions, samples);
+    }
+    {
+      HELAYERS_TRACE_SECTION("decode");
+      modelIoEncoder->decryptDecodeOutput(predictions);
+    }
+  }
+
+  string getPhaseNote() const override
+  {
+    return "predict runs all the layers inside HeModel::predict, which has no "
+           "per-layer breakdown";
+  }
+};
+
+// logistic_regression_training: one epoch of encrypted training, of a single
+// iteration, from encrypting the samples to decrypting the trained model.
+class LrFitKernel : public ScalingKernel
+{
+  static const DimInt inputSize = 30;
+  static const DimInt batchSize = 984;
+
+  // Generate the samples instead of reading them from the data directory.
+  bool synthetic;
+  uint64_t seed;
+
+  shared_ptr<HeModel> lr;
+  shared_ptr<ModelIoEncoder> modelIoEncoder;
+  vector<DoubleTensorCPtr> plainInputs;
+
+public:
+  LrFitKernel(bool synthetic, uint64_t seed) : synthetic(synthetic), seed(seed)
+  {}
+
+  string getName() const override { return "lr_fit"; }
+
+  void setup() override
+  {
+    DoubleTensor input;
+    if (synthetic)
+      input = DataGenerator(seed).generateFraudSamples(batchSize, inputSize);
+    else
+      input = TextIoUtils::readMatrixFromCsvFile(
+          getDataSetsDir() +
+          "/logistic_regression/processed_creditcard_balanced_sample.csv");
+    DoubleTensor labels = input.getSlice(1, inputSize);
+    input.removeSlice(1, inputSize);
+    input = input.getSlice(0, 0, batchSize);
+    labels = labels.getSlice(0, 0, batchSize);
+
+    PlainModelHyperParams hp;
+    hp.numberOfFeatures(inputSize);
+    hp.fitHyperParams.numberOfEpochs(1);
+    hp.fitHyperParams.numberOfIterations(1);
+    hp.fitHyperParams.learningRate(0.1);
+    hp.logisticRegressionActivation(LR_ACTIVATION_SIGMOID_POLY_3_APPROXIMATION);
+    hp.trainable(true);
+    hp.verbose(false);
+
+    HeRunRequirements heRunReq;
+    heRunReq.setHeContextOptions({make_shared<OpenFheCkksContext>()});
+    heRunReq.setMaxContextMemory(10L * 1024L * 1024L * 1024L); // 10 GB
+    heRunReq.optimizeForBatchSize(batchSize);
+    lr = make_shared<LogisticRegression>();
+    lr->encodeEncrypt({}, heRunReq, hp);
+
+    modelIoEncoder = make_shared<ModelIoEncoder>(*lr);
+    plainInputs = {make_shared<DoubleTensor>(input),
+                   make_shared<DoubleTensor>(labels)};
+  }
+
+  void run() override
+  {
+    EncryptedData inputs(*lr->getCreatedHeContext());
+    {
+      HELAYERS_TRACE_SECTION("encode");
+      modelIoEncoder->encodeEncrypt(inputs, plainInputs);
+    }
+    {
+      HELAYERS_TRACE_SECTION("fit");
+      lr->fit(inputs);
+    }
+    {
+      HELAYERS_TRACE_SECTION("decode");
+      lr->decryptDecode();
+    }
+  }
+
+  string getPhaseNote() const override
+  {
+    return "fit is the single iteration of the epoch; HeModel::fit has no "
+           "breakdown into its forward pass, gradient and update";
+  }
+};
+
+// game_of_life: one step of the game, as in helayers_bench.
+class LifeStepKernel : public ScalingKernel
+{
+  shared_ptr<BenchKernel> kernel;
+  shared_ptr<HeContext> he;
+
+public:
+  // The ciphertexts of the kernel belong to he, which is destroyed first.
+  ~LifeStepKernel()
+  {
+    if (kernel)
+      kernel->teardown();
+  }
+
+  string getName() const override { return "life_step"; }
+
+  void setup() override
+  {
+    for (const auto& k : createKernels(BenchOptions()))
+      if (k->getName() == "life_step")
+        kernel = k;
+    he = make_shared<OpenFheCkksContext>();
+    he->init(kernel->getRequirement());
+    kernel->setup(*he);
+  }
+
+  void run() override { kernel->run(*he); }
+};
+
+// fhe_db: count, sum, average and standard deviation queries over the first
+// rows of the transactions table.
+class DbQueryKernel : public ScalingKernel
+{
+  int numRows;
+  // Generate the table instead of reading it from the data directory.
+  bool synthetic;
+  uint64_t seed;
+  shared_ptr<HeContext> he;
+  shared_ptr<Table> table;
+  shared_ptr<Field> compareField;
+
+  const string opCol = "tx_sum";
+  const string compareCol = "client_id";
+
+public:
+  DbQueryKernel(int numRows, bool synthetic, uint64_t seed)
+      : numRows(numRows), synthetic(synthetic), seed(seed)
+  {}
+
+  string getName() const override { return "db_query"; }
+
+  void setup() override
+  {
+    HeConfigRequirement req;
+    req.multiplicationDepth = 9;
+    req.numSlots = 16384;
+    req.fractionalPartPrecision = 50;
+    req.integerPartPrecision = 10;
+    he = make_shared<SealCkksContext>();
+    he->init(req);
+
+    // The header line and the first numRows rows.
+    stringstream rows;
+    if (synthetic)
+      DataGenerator(seed).writeTransactionsCsv(rows, numRows);
+    else {
+      ifstream ifs = FileUtils::openIfstream(
+          getDataSetsDir() + "/db/txsmillion11Bits.csv", ios_base::in);
+      string line;
+      for (int i = 0; i <= numRows && getline(ifs, line); ++i)
+        rows << line << endl;
+    }
+    table = make_shared<Table>(*he, rows);
+    compareField =
+        make_shared<Field>(table->createCompareValue(9, compareCol));
+  }
+
+  void run() override
+  {
+    {
+      HELAYERS_TRACE_SECTION("count");
+      table->countQuery(compareCol, *compareField, IS_EQUAL);
+    }
+    {
+      HELAYERS_TRACE_SECTION("sum");
+      table->sumQuery(opCol, compareCol, *compareField, IS_EQUAL);
+    }
+    {
+      HELAYERS_TRACE_SECTION("average");
+      table->averageQuery(opCol, compareCol, *compareField, IS_EQUAL);
+    }
+    {
+      HELAYERS_TRACE_SECTION("stddev");
+      table->standardDeviationQuery(opCol, compareCol, *compareField, IS_EQUAL);
+    }
+  }
+};
+
+} // namespace
+
+// Mean seconds per run() at one thread count, in total and per phase.
+struct Measurement
+{
+  int threads;
+  double total;
+  map<string, double> phases;
+};
+
+static Measurement measure(ScalingKernel& kernel, int threads, int repetitions)
+{
+  omp_set_num_threads(threads);
+  TraceRecorder& trace = TraceRecorder::getInstance();
+  trace.clear();
+  trace.setEnabled(true);
+
+  auto start = high_resolution_clock::now();
+  for (int i = 0; i < repetitions; ++i)
+    kernel.run();
+  double total = duration<double>(high_resolution_clock::now() - start).count();
+  trace.setEnabled(false);
+
+  Measurement res;
+  res.threads = threads;
+  res.total = total / repetitions;
+  int mainThread = trace.getThreadId();
+  for (const TraceRecorder::Span& span : trace.getSpans())
+    if (span.threadId == mainThread && span.depth == 0)
+      res.phases[span.name] += span.duration * 1e-6 / repetitions;
+  return res;
+}
+
+// Karp-Flatt metric: the experimentally determined serial fraction.
+static double serialFraction(double speedup, double threads)
+{
+  return (1 / speedup - 1 / threads) / (1 - 1 / threads);
+}
+
+static void report(const string& kernel,
+                   const string& phase,
+                   const vector<pair<int, double>>& times,
+                   ostream& csv)
+{
+  double base = times.front().second;
+  cout << "  " << phase << endl;
+  cout << "    " << setw(8) << "threads" << setw(14) << "seconds" << setw(10)
+       << "speedup" << setw(12) << "efficiency" << setw(10) << "serial"
+       << endl;
+  for (const auto& t : times) {
+    double speedup = base / t.second;
+    double efficiency = speedup / t.first * times.front().first;
+    cout << "    " << setw(8) << t.first << setw(14) << t.second << setw(10)
+         << speedup << setw(12) << efficiency;
+    csv << kernel << "," << phase << "," << t.first << "," << t.second << ","
+        << speedup << "," << efficiency << ",";
+    if (t.first > times.front().first) {
+      double e =
+          serialFraction(speedup, (double)t.first / times.front().first);
+      cout << setw(10) << e;
+      csv << e;
+    }
+    cout << endl;
+    csv << endl;
+  }
+}
+
+// OMP_PROC_BIND and OMP_PLACES are read when the OpenMP runtime starts, i.e.
+// before main(), so pinning requires re-executing the program with them set.
+static void pinThreads(char* argv[])
+{
+  if (getenv("OMP_PROC_BIND") != nullptr)
+    return;
+  setenv("OMP_PROC_BIND", "close", 1);
+  setenv("OMP_PLACES", "cores", 1);
+  execv("/proc/self/exe", argv);
+  cerr << "WARNING: failed to re-execute with pinned threads, running unpinned"
+       << endl;
+}
+
+void usage()
+{
+  cout << "Usage:" << endl;
+  cout << endl;
+  cout << "\t--kernels <list>\tComma separated kernels: nn_predict, lr_fit, "
+          "life_step, db_query (default: all)"
+       << endl;
+  cout << "\t--threads <list>\tComma separated thread counts (default: 1, 2, "
+          "4, ... up to the number of processors)"
+       << endl;
+  cout << "\t--repetitions <int>\tMeasured runs per thread count (default: 1)"
+       << endl;
+  cout << "\t--nn_batch <int>\tBatch size of nn_predict (default: 4096)"
+       << endl;
+  cout << "\t--db_rows <int>\t\tTable rows of db_query (default: 16384)"
+       << endl;
+  cout << "\t--synthetic\t\tGenerate the data of lr_fit and db_query instead "
+          "of reading it from the data directory"
+       << endl;
+  cout << "\t--seed <int>\t\tSeed of the generated data (default: 17)"
+       << endl;
+  cout << "\t--no_pin\t\tDo not pin threads to cores" << endl;
+  cout << "\t--csv <file>\t\tCSV report (default: thread_scaling.csv)" << endl;
+  cout << endl;
+}
+
+static vector<int> parseList(const string& list)
+{
+  vector<int> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(stoi(item));
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  string kernelList;
+  vector<int> threadCounts;
+  int repetitions = 1;
+  int nnBatch = 4096;
+  int dbRows = 16384;
+  bool pin = true;
+  bool synthetic = false;
+  uint64_t seed = DataGenerator::DEFAULT_SEED;
+  string csvFile = "thread_scaling.csv";
+
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--help") {
+      usage();
+      return 0;
+    }
+    if (arg == "--kernels" && i < argc)
+      kernelList = "," + string(argv[i++]) + ",";
+    else if (arg == "--threads" && i < argc)
+      threadCounts = parseList(argv[i++]);
+    else if (arg == "--repetitions" && i < argc)
+      repetitions = stoi(argv[i++]);
+    else if (arg == "--nn_batch" && i < argc)
+      nnBatch = stoi(argv[i++]);
+    else if (arg == "--db_rows" && i < argc)
+      dbRows = stoi(argv[i++]);
+    else if (arg == "--no_pin")
+      pin = false;
+    else if (arg == "--synthetic")
+      synthetic = true;
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--csv" && i < argc)
+      csvFile = argv[i++];
+    else {
+      usage();
+      throw runtime_error("Unsupported argument: " + arg);
+    }
+  }
+
+  if (pin)
+    pinThreads(argv);
+  cout << "OMP_PROC_BIND="
+       << (getenv("OMP_PROC_BIND") ? getenv("OMP_PROC_BIND") : "unset")
+       << " OMP_PLACES="
+       << (getenv("OMP_PLACES") ? getenv("OMP_PLACES") : "unset") << endl;
+
+  int maxThreads = omp_get_num_procs();
+  if (threadCounts.empty()) {
+    for (int t = 1; t < maxThreads; t *= 2)
+      threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+  }
+
+  vector<shared_ptr<ScalingKernel>> kernels = {
+      make_shared<NnPredictKernel>(nnBatch),
+      make_shared<LrFitKernel>(synthetic, seed),
+      make_shared<LifeStepKernel>(),
+      make_shared<DbQueryKernel>(dbRows, synthetic, seed)};
+
+  ofstream csv(csvFile);
+  csv << "kernel,phase,threads,seconds,speedup,efficiency,serial_fraction"
+      << endl;
+
+  for (const auto& kernel : kernels) {
+    if (!kernelList.empty() &&
+        kernelList.find("," + kernel->getName() + ",") == string::npos)
+      continue;
+
+    cout << endl << "=== " << kernel->getName() << " ===" << endl;
+    omp_set_num_threads(maxThreads);
+    kernel->setup();
+
+    vector<Measurement> measurements;
+    for (int threads : threadCounts) {
+      cout << "Running with " << threads << " threads . . ." << endl;
+      measurements.push_back(measure(*kernel, threads, repetitions));
+    }
+
+    vector<pair<int, double>> totals;
+    map<string, vector<pair<int, double>>> phases;
+    for (const Measurement& m : measurements) {
+      totals.emplace_back(m.threads, m.total);
+      for (const auto& phase : m.phases)
+        phases[phase.first].emplace_back(m.threads, phase.second);
+    }
+    report(kernel->getName(), "total", totals, csv);
+    for (const auto& phase : phases)
+      report(kernel->getName(), phase.first, phase.second, csv);
+    if (!kernel->getPhaseNote().empty())
+      cout << "  Note: " << kernel->getPhaseNote() << endl;
+
+    // The phase that loses the most time to serial execution at the highest
+    // thread count is the first one to fix.
+    if (threadCounts.size() > 1) {
+      string worst;
+      double worstSerialSeconds = 0;
+      for (const auto& phase : phases) {
+        const auto& times = phase.second;
+        double speedup = times.front().second / times.back().second;
+        double ratio = (double)times.back().first / times.front().first;
+        if (ratio <= 1)
+          continue;
+        double serialSeconds =
+            serialFraction(speedup, ratio) * times.front().second;
+        if (serialSeconds > worstSerialSeconds) {
+          worstSerialSeconds = serialSeconds;
+          worst = phase.first;
+        }
+      }
+      if (!worst.empty())
+        cout << "  Largest serial component: " << worst << " ("
+             << worstSerialSeconds << " s at " << threadCounts.front()
+             << " thread(s))" << endl;
+    }
+  }
+
+  cout << endl << "Report written to " << csvFile << endl;
+  return 0;
+}
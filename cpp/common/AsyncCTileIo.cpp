@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "AsyncCTileIo.h"
+
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+
+using namespace std;
+using namespace chrono;
+using namespace helayers;
+
+double IoPipelineStats::getOverlapEfficiency(double wallSeconds) const
+{
+  double computeSeconds = max(0.0, wallSeconds - waitSeconds);
+  double hidden = computeSeconds + ioSeconds - wallSeconds;
+  double hideable = min(computeSeconds, ioSeconds);
+  if (hideable <= 0)
+    return 1;
+  return min(1.0, max(0.0, hidden / hideable));
+}
+
+void IoPipelineStats::print(ostream& out,
+                            const string& title,
+                            double wallSeconds) const
+{
+  out << title << ": " << numCiphertexts << " ciphertexts, "
+      << fixed << setprecision(2) << numBytes / (1024.0 * 1024.0) << " MB"
+      << endl;
+  out << "  wall time   : " << wallSeconds << " s" << endl;
+  out << "  compute time: " << max(0.0, wallSeconds - waitSeconds) << " s"
+      << endl;
+  out << "  I/O time    : " << ioSeconds << " s" << endl;
+  out << "  overlap efficiency: " << setprecision(1)
+      << 100 * getOverlapEfficiency(wallSeconds) << "%" << endl;
+  out << defaultfloat << setprecision(6);
+}
+
+AsyncCTileWriter::AsyncCTileWriter(size_t queueCapacity)
+    : queue(queueCapacity), worker(&AsyncCTileWriter::run, this)
+{}
+
+AsyncCTileWriter::~AsyncCTileWriter()
+{
+  try {
+    close();
+  } catch (exception& e) {
+    cerr << "AsyncCTileWriter: " << e.what() << endl;
+  }
+}
+
+void AsyncCTileWriter::run()
+{
+  while (optional<Job> job = queue.pop()) {
+    if (error)
+      continue; // drain the queue so that the producer never blocks forever
+    try {
+      auto start = high_resolution_clock::now();
+      job->ctile.saveToFile(job->fileName);
+      stats.numBytes += filesystem::file_size(job->fileName);
+      stats.ioSeconds +=
+          duration<double>(high_resolution_clock::now() - start).count();
+      ++stats.numCiphertexts;
+    } catch (...) {
+      error = current_exception();
+    }
+  }
+}
+
+void AsyncCTileWriter::rethrowIfFailed()
+{
+  if (error)
+    rethrow_exception(error);
+}
+
+void AsyncCTileWriter::write(CTile&& ctile, const string& fileName)
+{
+  if (closed)
+    throw runtime_error("AsyncCTileWriter: write after close");
+  stats.waitSeconds += queue.push(Job{std::move(ctile), fileName});
+}
+
+void AsyncCTileWriter::close()
+{
+  if (!closed) {
+    closed = true;
+    auto start = high_resolution_clock::now();
+    queue.close();
+    worker.join();
+    stats.waitSeconds +=
+        duration<double>(high_resolution_clock::now() - start).count();
+  }
+  rethrowIfFailed();
+}
+
+AsyncCTileReader::AsyncCTileReader(const HeContext& he,
+                                   const vector<string>& fileNames,
+                                   size_t queueCapacity)
+    : he(he),
+      fileNames(fileNames),
+      queue(queueCapacity),
+      worker(&AsyncCTileReader::run, this)
+{}
+
+AsyncCTileReader::~AsyncCTileReader()
+{
+  // Unblock the worker in case the consumer stopped reading early.
+  queue.close();
+  worker.join();
+}
+
+void AsyncCTileReader::run()
+{
+  try {
+    for (const string& fileName : fileNames) {
+      auto start = high_resolution_clock::now();
+      CTile c(he);
+      c.loadFromFile(fileName);
+      stats.numBytes += filesystem::file_size(fileName);
+      stats.ioSeconds +=
+          duration<double>(high_resolution_clock::now() - start).count();
+      queue.push(std::move(c));
+    }
+  } catch (...) {
+    // A closed queue means the consumer went away; anything else is reported
+    // on the next read().
+    error = current_exception();
+  }
+  queue.close();
+}
+
+bool AsyncCTileReader::read(CTile& res)
+{
+  auto start = high_resolution_clock::now();
+  optional<CTile> c = queue.pop();
+  stats.waitSeconds +=
+      duration<double>(high_resolution_clock::now() - start).count();
+  if (!c) {
+    if (error)
+      rethrow_exception(error);
+    return false;
+  }
+  res = std::move(*c);
+  ++stats.numCiphertexts;
+  return true;
+}
@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef ASYNC_CTILE_IO_H_
+#define ASYNC_CTILE_IO_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// A blocking FIFO queue with a fixed capacity. push() blocks while the queue is
+// full and pop() blocks while it is empty. Once close() is called, pop()
+// drains the remaining elements and then returns an empty optional.
+template <typename T>
+class BoundedQueue
+{
+  std::queue<T> items;
+  size_t capacity;
+  bool closed = false;
+  std::mutex mtx;
+  std::condition_variable notFull;
+  std::condition_variable notEmpty;
+
+public:
+  explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+  // Returns the number of seconds the caller was blocked waiting for space.
+  double push(T&& item)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::unique_lock<std::mutex> lock(mtx);
+    notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+    auto end = std::chrono::high_resolution_clock::now();
+    if (closed)
+      throw std::runtime_error("BoundedQueue: push to a closed queue");
+    items.push(std::move(item));
+    notEmpty.notify_one();
+    return std::chrono::duration<double>(end - start).count();
+  }
+
+  std::optional<T> pop()
+  {
+    std::unique_lock<std::mutex> lock(mtx);
+    notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+    if (items.empty())
+      return std::nullopt;
+    T item = std::move(items.front());
+    items.pop();
+    notFull.notify_one();
+    return item;
+  }
+
+  void close()
+  {
+    std::lock_guard<std::mutex> lock(mtx);
+    closed = true;
+    notFull.notify_all();
+    notEmpty.notify_all();
+  }
+};
+
+// Timing counters of an asynchronous I/O pipeline.
+struct IoPipelineStats
+{
+  // Number of ciphertexts that went through the pipeline.
+  size_t numCiphertexts = 0;
+  // Number of bytes read or written.
+  size_t numBytes = 0;
+  // Time spent by the background thread on serialization and file I/O.
+  double ioSeconds = 0;
+  // Time the foreground (compute) thread was blocked on the queue.
+  double waitSeconds = 0;
+
+  // Given the wall clock time of the foreground stage, returns the fraction of
+  // the smaller of compute/io time that was hidden behind the other one.
+  // 1 means perfect overlap, 0 means fully sequential behaviour.
+  double getOverlapEfficiency(double wallSeconds) const;
+
+  void print(std::ostream& out,
+             const std::string& title,
+             double wallSeconds) const;
+};
+
+// Saves ciphertexts to files from a background thread, so that the caller can
+// compute ciphertext N+1 while ciphertext N is being written.
+class AsyncCTileWriter
+{
+  struct Job
+  {
+    helayers::CTile ctile;
+    std::string fileName;
+  };
+
+  BoundedQueue<Job> queue;
+  IoPipelineStats stats;
+  std::exception_ptr error;
+  std::thread worker;
+  bool closed = false;
+
+  void run();
+  void rethrowIfFailed();
+
+public:
+  explicit AsyncCTileWriter(size_t queueCapacity = 16);
+
+  ~AsyncCTileWriter();
+
+  // Queues ctile to be saved into fileName. Blocks if the queue is full.
+  void write(helayers::CTile&& ctile, const std::string& fileName);
+
+  // Waits until all queued ciphertexts are written.
+  void close();
+
+  const IoPipelineStats& getStats() const { return stats; }
+};
+
+// Loads ciphertexts from a list of files in a background thread, prefetching
+// up to queueCapacity ciphertexts ahead of the consumer.
+class AsyncCTileReader
+{
+  const helayers::HeContext& he;
+  std::vector<std::string> fileNames;
+  BoundedQueue<helayers::CTile> queue;
+  IoPipelineStats stats;
+  std::exception_ptr error;
+  std::thread worker;
+
+  void run();
+
+public:
+  AsyncCTileReader(const helayers::HeContext& he,
+                   const std::vector<std::string>& fileNames,
+                   size_t queueCapacity = 16);
+
+  ~AsyncCTileReader();
+
+  // Moves the next ciphertext (in the order of fileNames) into res.
+  // Returns false when all files were read.
+  bool read(helayers::CTile& res);
+
+  const IoPipelineStats& getStats() const { return stats; }
+};
+
+#endif
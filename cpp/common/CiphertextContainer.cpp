@@ -0,0 +1,341 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "CiphertextContainer.h"
+
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const char MAGIC[8] = {'H', 'E', 'C', 'T', 'X', 'C', 'N', 'T'};
+const uint32_t VERSION = 1;
+const size_t HEADER_SIZE = 40;
+const size_t ENTRY_SIZE = 20;
+
+struct Header
+{
+  uint32_t alignment;
+  uint64_t numEntries;
+  uint64_t indexOffset;
+  uint32_t indexCrc;
+};
+
+// Flushes the data of path to the disk, so that it survives a power loss or
+// an OS crash and not only a crash of the process.
+void syncPath(const string& path, bool directory)
+{
+  int fd = open(path.c_str(), O_RDONLY | (directory ? O_DIRECTORY : 0));
+  if (fd < 0)
+    throw runtime_error("Failed to open " + path);
+  int res = fsync(fd);
+  close(fd);
+  if (res != 0)
+    throw runtime_error("Failed to sync " + path);
+}
+
+void putU32(char* p, uint32_t v)
+{
+  for (int i = 0; i < 4; ++i)
+    p[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+void putU64(char* p, uint64_t v)
+{
+  for (int i = 0; i < 8; ++i)
+    p[i] = static_cast<char>((v >> (8 * i)) & 0xff);
+}
+
+uint32_t getU32(const char* p)
+{
+  uint32_t v = 0;
+  for (int i = 0; i < 4; ++i)
+    v |= static_cast<uint32_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return v;
+}
+
+uint64_t getU64(const char* p)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i)
+    v |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (8 * i);
+  return v;
+}
+
+uint64_t alignUp(uint64_t offset, uint32_t alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+string encodeHeader(const Header& h)
+{
+  string res(HEADER_SIZE, '\0');
+  memcpy(&res[0], MAGIC, sizeof(MAGIC));
+  putU32(&res[8], VERSION);
+  putU32(&res[12], h.alignment);
+  putU64(&res[16], h.numEntries);
+  putU64(&res[24], h.indexOffset);
+  putU32(&res[32], h.indexCrc);
+  return res;
+}
+
+Header decodeHeader(const char* p, const string& fileName)
+{
+  if (memcmp(p, MAGIC, sizeof(MAGIC)) != 0)
+    throw runtime_error(fileName + " is not a ciphertext container");
+  if (getU32(p + 8) != VERSION)
+    throw runtime_error("Unsupported ciphertext container version in " +
+                        fileName);
+  Header h;
+  h.alignment = getU32(p + 12);
+  if (h.alignment < HEADER_SIZE)
+    throw runtime_error("Invalid alignment in ciphertext container " +
+                        fileName);
+  h.numEntries = getU64(p + 16);
+  h.indexOffset = getU64(p + 24);
+  h.indexCrc = getU32(p + 32);
+  return h;
+}
+
+string encodeIndex(const vector<CiphertextContainer::Entry>& entries)
+{
+  string res(entries.size() * ENTRY_SIZE, '\0');
+  for (size_t i = 0; i < entries.size(); ++i) {
+    char* p = &res[i * ENTRY_SIZE];
+    putU64(p, entries[i].offset);
+    putU64(p + 8, entries[i].size);
+    putU32(p + 16, entries[i].crc);
+  }
+  return res;
+}
+
+vector<CiphertextContainer::Entry> decodeIndex(const char* p,
+                                               const Header& h,
+                                               const string& fileName)
+{
+  if (CiphertextContainer::crc32(p, h.numEntries * ENTRY_SIZE) != h.indexCrc)
+    throw runtime_error("Corrupted index in ciphertext container " + fileName);
+  vector<CiphertextContainer::Entry> entries(h.numEntries);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const char* e = p + i * ENTRY_SIZE;
+    entries[i].offset = getU64(e);
+    entries[i].size = getU64(e + 8);
+    entries[i].crc = getU32(e + 16);
+  }
+  return entries;
+}
+
+array<uint32_t, 256> makeCrcTable()
+{
+  array<uint32_t, 256> table;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k)
+      c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+    table[i] = c;
+  }
+  return table;
+}
+
+} // namespace
+
+uint32_t CiphertextContainer::crc32(const char* data, size_t size)
+{
+  static const array<uint32_t, 256> table = makeCrcTable();
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i)
+    c = table[(c ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (c >> 8);
+  return c ^ 0xFFFFFFFFu;
+}
+
+void CiphertextContainer::create(const string& fileName, uint32_t alignment)
+{
+  if (alignment < HEADER_SIZE)
+    throw invalid_argument("Container alignment must be at least " +
+                           to_string(HEADER_SIZE) + " bytes");
+  ofstream out(fileName, ios::binary | ios::trunc);
+  if (!out)
+    throw runtime_error("Failed to create " + fileName);
+  Header h{alignment, 0, alignment, crc32(nullptr, 0)};
+  out << encodeHeader(h);
+  out.close();
+  if (!out)
+    throw runtime_error("Failed to write " + fileName);
+  syncPath(fileName, false);
+  string dir = filesystem::path(fileName).parent_path().string();
+  syncPath(dir.empty() ? "." : dir, true);
+}
+
+CiphertextContainer::CiphertextContainer(const string& fileName)
+    : fileName(fileName)
+{
+  ifstream in(fileName, ios::binary);
+  if (!in)
+    throw runtime_error("Failed to open " + fileName);
+  char buf[HEADER_SIZE];
+  in.read(buf, HEADER_SIZE);
+  if (!in)
+    throw runtime_error(fileName + " is not a ciphertext container");
+  Header h = decodeHeader(buf, fileName);
+  alignment = h.alignment;
+  indexOffset = h.indexOffset;
+
+  // The index of an empty container is empty, and create() does not pad the
+  // file up to its offset.
+  string index(h.numEntries * ENTRY_SIZE, '\0');
+  if (h.numEntries > 0) {
+    in.seekg(h.indexOffset);
+    in.read(&index[0], index.size());
+    if (!in)
+      throw runtime_error("Truncated ciphertext container " + fileName);
+  }
+  entries = decodeIndex(index.data(), h, fileName);
+}
+
+size_t CiphertextContainer::appendBlobs(const vector<string>& blobs)
+{
+  size_t first = entries.size();
+  fstream f(fileName, ios::binary | ios::in | ios::out);
+  if (!f)
+    throw runtime_error("Failed to open " + fileName + " for appending");
+
+  // New entries are written after the current index, which stays valid
+  // until writeIndexAndHeader() rewrites the header.
+  uint64_t pos = alignUp(indexOffset + entries.size() * ENTRY_SIZE, alignment);
+  for (const string& blob : blobs) {
+    f.seekp(pos);
+    f.write(blob.data(), blob.size());
+    entries.push_back({pos, blob.size(), crc32(blob.data(), blob.size())});
+    pos = alignUp(pos + blob.size(), alignment);
+  }
+  f.flush();
+  indexOffset = pos;
+  writeIndexAndHeader(f);
+  return first;
+}
+
+void CiphertextContainer::writeIndexAndHeader(fstream& f)
+{
+  string index = encodeIndex(entries);
+  f.seekp(indexOffset);
+  f.write(index.data(), index.size());
+  f.flush();
+  if (!f)
+    throw runtime_error("Failed to write " + fileName);
+  // The entries and the index must be on the disk before the header points
+  // at them, or a power loss could leave a header pointing at pages that
+  // were never written.
+  syncPath(fileName, false);
+  Header h{alignment,
+           entries.size(),
+           indexOffset,
+           crc32(index.data(), index.size())};
+  string header = encodeHeader(h);
+  f.seekp(0);
+  f.write(header.data(), header.size());
+  f.flush();
+  if (!f)
+    throw runtime_error("Failed to write " + fileName);
+  syncPath(fileName, false);
+}
+
+string CiphertextContainer::readBlob(size_t i) const
+{
+  const Entry& e = entries.at(i);
+  ifstream in(fileName, ios::binary);
+  in.seekg(e.offset);
+  string res(e.size, '\0');
+  in.read(&res[0], e.size);
+  if (!in)
+    throw runtime_error("Failed to read entry " + to_string(i) + " of " +
+                        fileName);
+  if (crc32(res.data(), res.size()) != e.crc)
+    throw runtime_error("Checksum mismatch in entry " + to_string(i) +
+                        " of " + fileName);
+  return res;
+}
+
+MappedCiphertextContainer::MappedCiphertextContainer(const string& fileName,
+                                                     bool verifyChecksums)
+    : verifyChecksums(verifyChecksums)
+{
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw runtime_error("Failed to open " + fileName);
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < HEADER_SIZE) {
+    close(fd);
+    throw runtime_error(fileName + " is not a ciphertext container");
+  }
+  mappedSize = st.st_size;
+  void* p = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED)
+    throw runtime_error("Failed to map " + fileName);
+  data = static_cast<const char*>(p);
+
+  try {
+    Header h = decodeHeader(data, fileName);
+    // See CiphertextContainer() for empty containers.
+    if (h.numEntries == 0)
+      entries = decodeIndex(data, h, fileName);
+    else {
+      if (h.indexOffset + h.numEntries * ENTRY_SIZE > mappedSize)
+        throw runtime_error("Truncated ciphertext container " + fileName);
+      entries = decodeIndex(data + h.indexOffset, h, fileName);
+    }
+  } catch (...) {
+    munmap(const_cast<char*>(data), mappedSize);
+    throw;
+  }
+  // Entries are typically accessed in random order.
+  madvise(const_cast<char*>(data), mappedSize, MADV_RANDOM);
+}
+
+MappedCiphertextContainer::~MappedCiphertextContainer()
+{
+  munmap(const_cast<char*>(data), mappedSize);
+}
+
+const CiphertextContainer::Entry& MappedCiphertextContainer::getVerifiedEntry(
+    size_t i) const
+{
+  const CiphertextContainer::Entry& e = entries.at(i);
+  if (e.offset + e.size > mappedSize)
+    throw runtime_error("Entry " + to_string(i) + " exceeds the mapped file");
+  if (verifyChecksums &&
+      CiphertextContainer::crc32(data + e.offset, e.size) != e.crc)
+    throw runtime_error("Checksum mismatch in entry " + to_string(i));
+  return e;
+}
@@ -0,0 +1,177 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef CIPHERTEXT_CONTAINER_H_
+#define CIPHERTEXT_CONTAINER_H_
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// A single file holding many serialized ciphertexts (CTile, CTileTensor or any
+// other object with save(ostream&)/load(istream&) methods).
+//
+// File layout (all integers are little endian):
+//   header  - magic, version, alignment, number of entries, index offset
+//   entries - serialized objects, each starting at a multiple of alignment
+//   index   - (offset, size, crc32) per entry, following the last entry
+//
+// Appending writes the new entries after the old index, then a new index after
+// them, syncs them to the disk and only then updates and syncs the header.
+// Until the header is rewritten, it still points at the old index, which the
+// append does not touch, so a crash of the process or of the machine in the
+// middle of an append leaves the container as it was before it.
+//
+// The space of the old index is never reused: every append leaves the
+// previous index behind as dead space of 20 bytes per entry, padded to the
+// alignment. A container appended to many times can be compacted by copying
+// its blobs (readBlob()) into a new one with a single appendBlobs().
+class CiphertextContainer
+{
+public:
+  struct Entry
+  {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc;
+  };
+
+  // Creates a new empty container, overwriting fileName if it exists.
+  static void create(const std::string& fileName, uint32_t alignment = 4096);
+
+  // Opens an existing container for reading and appending.
+  explicit CiphertextContainer(const std::string& fileName);
+
+  size_t size() const { return entries.size(); }
+
+  const Entry& getEntry(size_t i) const { return entries.at(i); }
+
+  uint32_t getAlignment() const { return alignment; }
+
+  // Appends serialized objects. All blobs of one call are written with a
+  // single index and header update. Returns the index of the first one.
+  size_t appendBlobs(const std::vector<std::string>& blobs);
+
+  template <typename T>
+  size_t append(const T& obj)
+  {
+    return appendBlobs({serialize(obj)});
+  }
+
+  template <typename T>
+  size_t append(const std::vector<T>& objs)
+  {
+    std::vector<std::string> blobs;
+    blobs.reserve(objs.size());
+    for (const T& obj : objs)
+      blobs.push_back(serialize(obj));
+    return appendBlobs(blobs);
+  }
+
+  // Reads entry i and verifies its checksum.
+  std::string readBlob(size_t i) const;
+
+  // Random access load of entry i into res (e.g., a CTile or CTileTensor).
+  template <typename T>
+  void load(size_t i, T& res) const
+  {
+    std::istringstream in(readBlob(i));
+    res.load(in);
+  }
+
+  template <typename T>
+  static std::string serialize(const T& obj)
+  {
+    std::ostringstream out;
+    obj.save(out);
+    return out.str();
+  }
+
+  static uint32_t crc32(const char* data, size_t size);
+
+private:
+  std::string fileName;
+  uint32_t alignment;
+  std::vector<Entry> entries;
+  uint64_t indexOffset;
+
+  void writeIndexAndHeader(std::fstream& f);
+};
+
+// Read-only, memory mapped view of a CiphertextContainer file. Entries are
+// deserialized directly from the mapped pages, without first copying them
+// into an intermediate buffer.
+class MappedCiphertextContainer
+{
+  // An input stream buffer over a fixed memory region.
+  class MemoryStreamBuf : public std::streambuf
+  {
+  public:
+    MemoryStreamBuf(const char* data, size_t size)
+    {
+      char* p = const_cast<char*>(data);
+      setg(p, p, p + size);
+    }
+  };
+
+  const char* data = nullptr;
+  size_t mappedSize = 0;
+  std::vector<CiphertextContainer::Entry> entries;
+  bool verifyChecksums;
+
+public:
+  // If verifyChecksums is true, every load() verifies the checksum of the
+  // entry first. This touches the whole entry twice, so it can be turned off
+  // for trusted local files.
+  explicit MappedCiphertextContainer(const std::string& fileName,
+                                     bool verifyChecksums = true);
+
+  ~MappedCiphertextContainer();
+
+  MappedCiphertextContainer(const MappedCiphertextContainer&) = delete;
+  MappedCiphertextContainer& operator=(const MappedCiphertextContainer&) =
+      delete;
+
+  size_t size() const { return entries.size(); }
+
+  template <typename T>
+  void load(size_t i, T& res) const
+  {
+    const CiphertextContainer::Entry& e = getVerifiedEntry(i);
+    MemoryStreamBuf buf(data + e.offset, e.size);
+    std::istream in(&buf);
+    res.load(in);
+  }
+
+private:
+  const CiphertextContainer::Entry& getVerifiedEntry(size_t i) const;
+};
+
+#endif
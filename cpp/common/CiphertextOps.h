@@ -0,0 +1,143 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef CIPHERTEXT_OPS_H_
+#define CIPHERTEXT_OPS_H_
+
+#include <iostream>
+#include <string>
+
+#include "helayers/hebase/hebase.h"
+
+// Helpers for writing ciphertext arithmetic without redundant copies.
+//
+// The CTile and CTileTensor operations are in-place: a.multiply(b) overwrites
+// a. Computing c = a * b therefore needs a copy of a, and code often creates a
+// new ciphertext for it on every iteration. The "Into" functions below write
+// the result into an existing destination instead. When the destination is
+// one of the operands no copy is made at all. Otherwise the copy is an
+// assignment into an existing ciphertext; this saves creating a new object,
+// but the assignment still clones the backend's ciphertext, so its buffers
+// are allocated again. Reusing buffers is up to the backend's allocator (see
+// SealMemoryPool.h).
+//
+// Every ciphertext copy made through these helpers is counted, so that
+// examples can report how many copies their hot paths make. Copies made by
+// plain assignments and copy constructors, or inside the library (e.g. by
+// getSquare()), are not counted. To compare with code that does not use the
+// helpers, its copies have to be routed through copyInto() as well.
+//
+// Note that there is no cheap swap of ciphertexts: CTile and CTileTensor have
+// no move operations, so std::swap on them makes three deep copies. Swap
+// pointers to them instead.
+class CiphertextCopyCounter
+{
+  long copies = 0;
+
+  CiphertextCopyCounter() {}
+
+public:
+  static CiphertextCopyCounter& getInstance()
+  {
+    static CiphertextCopyCounter instance;
+    return instance;
+  }
+
+  void countCopy() { copies++; }
+
+  long getCopies() const { return copies; }
+
+  void clear() { copies = 0; }
+
+  // Prints the number of copies, and their number per unit (e.g. per entry
+  // of a search) if units is positive.
+  void printStats(std::ostream& out,
+                  const std::string& title,
+                  long units = 0,
+                  const std::string& unitName = "") const
+  {
+    out << title << ": " << copies << " ciphertext copies";
+    if (units > 0)
+      out << ", " << static_cast<double>(copies) / units << " per "
+          << unitName;
+    out << std::endl;
+  }
+};
+
+// dest = src, counted as a copy.
+template <typename T>
+void copyInto(T& dest, const T& src)
+{
+  if (&dest == &src)
+    return;
+  CiphertextCopyCounter::getInstance().countCopy();
+  dest = src;
+}
+
+// dest = a + b
+template <typename T>
+void addInto(T& dest, const T& a, const T& b)
+{
+  if (&dest == &b) {
+    dest.add(a);
+    return;
+  }
+  copyInto(dest, a);
+  dest.add(b);
+}
+
+// dest = a - b
+template <typename T>
+void subInto(T& dest, const T& a, const T& b)
+{
+  if (&dest == &b) {
+    dest.negate();
+    dest.add(a);
+    return;
+  }
+  copyInto(dest, a);
+  dest.sub(b);
+}
+
+// dest = a * b
+template <typename T>
+void multiplyInto(T& dest, const T& a, const T& b)
+{
+  if (&dest == &b) {
+    dest.multiply(a);
+    return;
+  }
+  copyInto(dest, a);
+  dest.multiply(b);
+}
+
+// dest = a rotated by n slots
+inline void rotateInto(helayers::CTile& dest, const helayers::CTile& a, int n)
+{
+  copyInto(dest, a);
+  dest.rotate(n);
+}
+
+#endif
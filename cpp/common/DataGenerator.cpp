@@ -0,0 +1,248 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "DataGenerator.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#include <stdlib.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace helayers;
+
+static const vector<string> syllables = {
+    "al", "an", "ar", "ba", "bel", "bo", "ca", "da", "den", "do", "el",
+    "en", "fa", "ga", "gi", "ha", "in", "is", "ka", "la", "li", "lo",
+    "ma", "mi", "mon", "na", "ni", "no", "or", "pa", "ra", "ri", "ro",
+    "sa", "si", "ta", "ti", "to", "ur", "va", "vi", "za"};
+
+static const vector<string> firstNames = {
+    "Alice", "Bob", "Carol", "David", "Erin", "Frank", "Grace", "Heidi",
+    "Ivan", "Judy", "Mallory", "Niaj", "Olivia", "Peggy", "Rupert", "Sybil",
+    "Trent", "Uma", "Victor", "Walter"};
+
+static const vector<string> lastNames = {
+    "Adams", "Baker", "Clark", "Davis", "Evans", "Flatt", "Garcia", "Hill",
+    "Irwin", "Jones", "King", "Lopez", "Martin", "Nolan", "Owens", "Parker",
+    "Quinn", "Reed", "Smith", "Turner"};
+
+static const vector<string> domains = {
+    "example.com", "example.org", "mail.com", "stanford.edu", "technion.ac.il",
+    "university.edu"};
+
+static const vector<string> streets = {
+    "Main St", "Oak Ave", "Pine St", "Maple Ave", "Cedar Rd", "Elm St",
+    "Dewey St", "Lake Dr", "Hill Rd", "Park Ave"};
+
+static const vector<string> states = {
+    "AL", "CA", "CO", "FL", "ID", "MN", "NM", "NY", "OH", "TX", "WA"};
+
+template <typename T>
+static const T& pick(mt19937_64& rng, const vector<T>& values)
+{
+  uniform_int_distribution<size_t> dist(0, values.size() - 1);
+  return values[dist(rng)];
+}
+
+static int uniformInt(mt19937_64& rng, int low, int high)
+{
+  return uniform_int_distribution<int>(low, high)(rng);
+}
+
+DataGenerator::DataGenerator(uint64_t seed) : rng(seed) {}
+
+string DataGenerator::generateWord(int minSyllables, int maxSyllables)
+{
+  string res;
+  int numSyllables = uniformInt(rng, minSyllables, maxSyllables);
+  for (int i = 0; i < numSyllables; ++i)
+    res += pick(rng, syllables);
+  res[0] = toupper(res[0]);
+  return res;
+}
+
+vector<pair<string, string>> DataGenerator::generateCountries(int numCountries,
+                                                              int maxLen)
+{
+  if (maxLen < 4)
+    throw invalid_argument("Country names need at least 4 characters");
+  int maxSyllables = max(2, min(4, maxLen / 3));
+
+  vector<pair<string, string>> res;
+  set<string> used;
+  long attempts = 0;
+  while (res.size() < numCountries) {
+    if (++attempts > 100L * numCountries)
+      throw invalid_argument("Cannot generate " + to_string(numCountries) +
+                             " distinct names of up to " + to_string(maxLen) +
+                             " characters");
+    string country = generateWord(2, maxSyllables);
+    if (country.size() > maxLen || !used.insert(country).second)
+      continue;
+    string capital = generateWord(2, maxSyllables).substr(0, maxLen);
+    res.emplace_back(country, capital);
+  }
+  return res;
+}
+
+void DataGenerator::writeTransactionsCsv(ostream& out,
+                                         int numRows,
+                                         int numBits,
+                                         int maxSum)
+{
+  int maxId = (1 << numBits) - 1;
+  out << "tx_id,client_id,tx_sum" << endl;
+  for (int i = 0; i < numRows; ++i)
+    out << uniformInt(rng, 0, maxId) << "," << uniformInt(rng, 0, maxId) << ","
+        << uniformInt(rng, 0, maxSum) << endl;
+}
+
+void DataGenerator::writeClientProfilesCsv(ostream& out,
+                                           int numBits,
+                                           int numSegments)
+{
+  out << "client_id,segment" << endl;
+  for (int id = 0; id < (1 << numBits); ++id)
+    if (uniformInt(rng, 0, 7) != 0)
+      out << id << "," << uniformInt(rng, 0, numSegments - 1) << endl;
+}
+
+// The 15 fields of an ER record, in the order of er_basic_example.cpp.
+static vector<string> generateErRecord(mt19937_64& rng)
+{
+  string first = pick(rng, firstNames);
+  string last = pick(rng, lastNames);
+  return {first,
+          last,
+          first + "." + last,
+          pick(rng, domains),
+          to_string(uniformInt(rng, 10000, 99999)),
+          to_string(uniformInt(rng, 1, 9999)) + " " + pick(rng, streets),
+          "Suite " + to_string(uniformInt(rng, 1, 99999)),
+          pick(rng, lastNames) + "ville",
+          pick(rng, states),
+          "USA",
+          to_string(uniformInt(rng, 10000, 99999)),
+          to_string(uniformInt(rng, 1000, 9999)),
+          to_string(uniformInt(rng, 200, 999)),
+          to_string(uniformInt(rng, 200, 999)),
+          to_string(uniformInt(rng, 1000, 9999))};
+}
+
+static void writeCsvLine(ostream& out, const vector<string>& fields)
+{
+  for (size_t i = 0; i < fields.size(); ++i)
+    out << (i == 0 ? "" : ",") << fields[i];
+  out << endl;
+}
+
+void DataGenerator::writeErRecordsCsv(ostream& first,
+                                      ostream& second,
+                                      int numRecords,
+                                      double matchRate)
+{
+  vector<vector<string>> firstRecords(numRecords);
+  for (auto& record : firstRecords)
+    record = generateErRecord(rng);
+
+  bernoulli_distribution isMatch(matchRate);
+  bernoulli_distribution hasTypo(0.5);
+  vector<vector<string>> secondRecords(numRecords);
+  for (int i = 0; i < numRecords; ++i) {
+    if (!isMatch(rng)) {
+      secondRecords[i] = generateErRecord(rng);
+      continue;
+    }
+    secondRecords[i] = firstRecords[i];
+    if (hasTypo(rng)) {
+      // Swap two adjacent characters of one field.
+      vector<string>& record = secondRecords[i];
+      string& field = record[uniformInt(rng, 0, record.size() - 1)];
+      if (field.size() > 1) {
+        size_t pos = uniformInt(rng, 0, field.size() - 2);
+        swap(field[pos], field[pos + 1]);
+      }
+    }
+  }
+  shuffle(secondRecords.begin(), secondRecords.end(), rng);
+
+  for (const auto& record : firstRecords)
+    writeCsvLine(first, record);
+  for (const auto& record : secondRecords)
+    writeCsvLine(second, record);
+}
+
+// Creates an empty temporary file with a unique name starting with prefix
+// and returns its name.
+static string createTempFile(const string& prefix)
+{
+  string name =
+      (filesystem::temp_directory_path() / (prefix + "_XXXXXX")).string();
+  vector<char> buf(name.begin(), name.end());
+  buf.push_back('\0');
+  int fd = mkstemp(buf.data());
+  if (fd < 0)
+    throw runtime_error("Failed to create a temporary file " + name);
+  close(fd);
+  return buf.data();
+}
+
+pair<string, string> DataGenerator::writeErRecordsFiles(int numRecords,
+                                                        double matchRate)
+{
+  string firstFile = createTempFile("er_synthetic_alice");
+  string secondFile = createTempFile("er_synthetic_bob");
+  ofstream first(firstFile);
+  ofstream second(secondFile);
+  writeErRecordsCsv(first, second, numRecords, matchRate);
+  if (!first || !second)
+    throw runtime_error("Failed to write the generated ER tables");
+  return {firstFile, secondFile};
+}
+
+DoubleTensor DataGenerator::generateFraudSamples(int numSamples,
+                                                 int numFeatures,
+                                                 double fraudRate)
+{
+  // The number of leading features in which fraudulent samples differ.
+  const int numInformative = min(numFeatures, 4);
+
+  normal_distribution<double> normal(0, 1);
+  bernoulli_distribution isFraud(fraudRate);
+  DoubleTensor res({numSamples, numFeatures + 1});
+  for (int i = 0; i < numSamples; ++i) {
+    bool fraud = isFraud(rng);
+    for (int j = 0; j < numFeatures; ++j) {
+      double shift = fraud && j < numInformative ? 1.5 : 0;
+      res.at(i, j) = normal(rng) + shift;
+    }
+    res.at(i, numFeatures) = fraud ? 1 : 0;
+  }
+  return res;
+}
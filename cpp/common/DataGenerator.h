@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef DATA_GENERATOR_H_
+#define DATA_GENERATOR_H_
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "helayers/math/DoubleTensor.h"
+
+// Synthesises datasets with the same schema as the files that the examples
+// read from getDataSetsDir(), at any size. All the data is derived from a
+// single seed, so runs are reproducible and need no downloaded files.
+//
+// The generated values follow simple distributions. They exercise the same
+// code paths and sizes as the real datasets, but results that depend on the
+// data itself (e.g. model accuracy) are not comparable to the real ones.
+class DataGenerator
+{
+  std::mt19937_64 rng;
+
+  std::string generateWord(int minSyllables, int maxSyllables);
+
+public:
+  static const uint64_t DEFAULT_SEED = 17;
+
+  explicit DataGenerator(uint64_t seed = DEFAULT_SEED);
+
+  // The random engine, for examples that draw their own values.
+  std::mt19937_64& getEngine() { return rng; }
+
+  // Country and capital names as in data/countries/countries.csv: distinct,
+  // capitalised, and no longer than maxLen characters.
+  std::vector<std::pair<std::string, std::string>> generateCountries(
+      int numCountries,
+      int maxLen);
+
+  // A transactions table as in data/db/txsmillion11Bits.csv, with the
+  // columns tx_id, client_id and tx_sum. Ids are below 2^numBits, as the
+  // table stores them in hybrid bitwise columns of numBits bits.
+  void writeTransactionsCsv(std::ostream& out,
+                            int numRows,
+                            int numBits = 11,
+                            int maxSum = 50000);
+
+  // A client profiles table, with the columns client_id and segment, to
+  // join with writeTransactionsCsv(). Every client id below 2^numBits has a
+  // profile, except about 1 in 8, and segments are in 0, ..., numSegments - 1.
+  void writeClientProfilesCsv(std::ostream& out,
+                              int numBits = 8,
+                              int numSegments = 4);
+
+  // A pair of record tables as in data/er/out1.csv and data/er/out2.csv,
+  // with the 15 fields listed in er_basic_example.cpp. About matchRate of
+  // the records of the second table are copies of records of the first one,
+  // some with a typo in one field.
+  void writeErRecordsCsv(std::ostream& first,
+                         std::ostream& second,
+                         int numRecords,
+                         double matchRate = 0.1);
+
+  // Writes the tables of writeErRecordsCsv() to new temporary files, with
+  // unique names so that concurrent runs do not overwrite each other, and
+  // returns their names. The caller removes the files once it has read them.
+  std::pair<std::string, std::string> writeErRecordsFiles(
+      int numRecords,
+      double matchRate = 0.1);
+
+  // Credit card transaction features as in
+  // data/logistic_regression/processed_creditcard_balanced_sample.csv: a
+  // numSamples x (numFeatures + 1) matrix of standardised features, with the
+  // 0/1 fraud label in the last column. Fraudulent samples are shifted in
+  // the first features, so that models can learn to separate them.
+  helayers::DoubleTensor generateFraudSamples(int numSamples,
+                                              int numFeatures = 30,
+                                              double fraudRate = 0.5);
+};
+
+#endif
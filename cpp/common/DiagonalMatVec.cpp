@@ -0,0 +1,149 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "DiagonalMatVec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace helayers;
+
+DiagonalMatVec::DiagonalMatVec(const HeContext& he,
+                               const vector<vector<double>>& matrix,
+                               int n)
+    : he(he), n(n)
+{
+  if (n <= 0 || (n & (n - 1)) != 0 || he.slotCount() % n != 0)
+    throw invalid_argument("DiagonalMatVec: n must be a power of 2 dividing "
+                           "the slot count");
+  if (matrix.size() > n)
+    throw invalid_argument("DiagonalMatVec: more than " + to_string(n) +
+                           " rows");
+  for (const auto& row : matrix)
+    if (row.size() > n)
+      throw invalid_argument("DiagonalMatVec: more than " + to_string(n) +
+                             " columns");
+
+  Encoder enc(he);
+  for (int d = 0; d < n; ++d) {
+    vector<double> diagonal(n, 0);
+    bool zero = true;
+    for (size_t i = 0; i < matrix.size(); ++i) {
+      size_t j = (i + d) % n;
+      if (j < matrix[i].size())
+        diagonal[i] = matrix[i][j];
+      zero = zero && diagonal[i] == 0;
+    }
+    if (zero)
+      continue;
+    vector<double> vals(he.slotCount());
+    for (int s = 0; s < he.slotCount(); ++s)
+      vals[s] = diagonal[s % n];
+    PTile ptile(he);
+    enc.encode(ptile, vals);
+    keptDiagonals.push_back(d);
+    diagonals.push_back(ptile);
+  }
+}
+
+void DiagonalMatVec::setRotationSteps(HeConfigRequirement& req, int n)
+{
+  vector<int> steps;
+  for (int step = 1; step < n; ++step)
+    steps.push_back(step);
+  req.publicFunctions.rotate(CUSTOM_ROTATIONS);
+  req.publicFunctions.rotationSteps(steps);
+}
+
+void DiagonalMatVec::pruneDiagonals(vector<vector<double>>& matrix,
+                                    int n,
+                                    double ratio)
+{
+  vector<double> norms(n, 0);
+  for (size_t i = 0; i < matrix.size(); ++i)
+    for (size_t j = 0; j < matrix[i].size(); ++j)
+      norms[(j + n - i % n) % n] += matrix[i][j] * matrix[i][j];
+
+  vector<int> order(n);
+  for (int d = 0; d < n; ++d)
+    order[d] = d;
+  stable_sort(order.begin(), order.end(), [&norms](int a, int b) {
+    return norms[a] < norms[b];
+  });
+
+  vector<bool> pruned(n, false);
+  int numPruned = lround(ratio * n);
+  for (int k = 0; k < numPruned && k < n; ++k)
+    pruned[order[k]] = true;
+  for (size_t i = 0; i < matrix.size(); ++i)
+    for (size_t j = 0; j < matrix[i].size(); ++j)
+      if (pruned[(j + n - i % n) % n])
+        matrix[i][j] = 0;
+}
+
+int DiagonalMatVec::getNumRotations() const
+{
+  int res = keptDiagonals.size();
+  if (!keptDiagonals.empty() && keptDiagonals[0] == 0)
+    --res;
+  return res;
+}
+
+CTile DiagonalMatVec::encryptVector(const vector<double>& vec) const
+{
+  if (vec.size() > n)
+    throw invalid_argument("DiagonalMatVec: vector longer than " +
+                           to_string(n));
+  vector<double> vals(he.slotCount(), 0);
+  for (int s = 0; s < he.slotCount(); ++s)
+    if (s % n < vec.size())
+      vals[s] = vec[s % n];
+  Encoder enc(he);
+  CTile res(he);
+  enc.encodeEncrypt(res, vals);
+  return res;
+}
+
+void DiagonalMatVec::multiply(CTile& res, const CTile& vec) const
+{
+  if (keptDiagonals.empty()) {
+    res = vec;
+    res.multiplyScalar(0.0);
+    return;
+  }
+  CTile rotated(he);
+  for (size_t k = 0; k < keptDiagonals.size(); ++k) {
+    CTile& dest = k == 0 ? res : rotated;
+    dest = vec;
+    if (keptDiagonals[k] != 0)
+      dest.rotate(keptDiagonals[k]);
+    dest.multiplyPlain(diagonals[k]);
+    if (k > 0)
+      res.add(rotated);
+  }
+}
@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef DIAGONAL_MAT_VEC_H_
+#define DIAGONAL_MAT_VEC_H_
+
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Product of a plain matrix and an encrypted vector by the diagonal method.
+//
+// The matrix is padded to n x n, and its diagonals are encoded: diagonal d
+// holds M[i][(i + d) % n] in slot i. The vector is encrypted replicated with
+// period n across all slots, so that rotating the ciphertext by d rotates the
+// vector cyclically. Then M * v is the sum over d of diagonal d times v
+// rotated by d, which costs a rotation and a plaintext multiplication per
+// diagonal. The result is replicated with period n as well, so it can be fed
+// to the next product directly.
+//
+// Diagonals whose entries are all zero contribute nothing and are detected
+// when the matrix is encoded. Their rotations and multiplications are
+// skipped, so a matrix pruned by diagonals (see pruneDiagonals()) is
+// multiplied in time proportional to the diagonals it keeps.
+class DiagonalMatVec
+{
+  const helayers::HeContext& he;
+  int n;
+  std::vector<int> keptDiagonals;
+  std::vector<helayers::PTile> diagonals;
+
+public:
+  // matrix is given by rows, with at most n rows and n columns. n must be a
+  // power of 2 dividing the slot count.
+  DiagonalMatVec(const helayers::HeContext& he,
+                 const std::vector<std::vector<double>>& matrix,
+                 int n);
+
+  // Adds the rotation steps 1, ..., n - 1 used by multiply() to req.
+  static void setRotationSteps(helayers::HeConfigRequirement& req, int n);
+
+  // Zeroes the fraction ratio of the n diagonals with the smallest L2 norm,
+  // in place. This is structured pruning matched to the diagonal packing:
+  // pruning individual weights rarely zeroes a whole diagonal.
+  static void pruneDiagonals(std::vector<std::vector<double>>& matrix,
+                             int n,
+                             double ratio);
+
+  int getNumDiagonals() const { return n; }
+  int getNumKeptDiagonals() const { return keptDiagonals.size(); }
+
+  // Returns the number of rotations of multiply(): the kept diagonals other
+  // than diagonal 0.
+  int getNumRotations() const;
+
+  // Encrypts vec replicated with period n.
+  helayers::CTile encryptVector(const std::vector<double>& vec) const;
+
+  // res = M * vec, where vec is encrypted by encryptVector() and res is a
+  // different ciphertext. The first n slots of res hold the product.
+  void multiply(helayers::CTile& res, const helayers::CTile& vec) const;
+};
+
+#endif
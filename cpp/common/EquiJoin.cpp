@@ -0,0 +1,237 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "EquiJoin.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace helayers;
+
+EquiJoin::EquiJoin(const HeContext& he, int numBits, int numGroups)
+    : he(he), numBits(numBits), numGroups(numGroups)
+{
+  if (numBits < 1 || numBits > 30)
+    throw invalid_argument("EquiJoin: numBits must be in 1..30");
+  if (numGroups < 1)
+    throw invalid_argument("EquiJoin: numGroups must be positive");
+}
+
+int EquiJoin::getDepth() const
+{
+  // Broadcast mask, bit equality, product of the bits, group, value.
+  return 4 + (int)ceil(log2(numBits));
+}
+
+vector<CTile> EquiJoin::encryptBits(const vector<int>& keys, int begin) const
+{
+  Encoder enc(he);
+  vector<CTile> res(numBits, CTile(he));
+  for (int b = 0; b < numBits; ++b) {
+    vector<double> bits(he.slotCount(), 0);
+    for (int i = 0; i < he.slotCount() && begin + i < keys.size(); ++i)
+      bits[i] = (keys[begin + i] >> b) & 1;
+    enc.encodeEncrypt(res[b], bits);
+  }
+  return res;
+}
+
+void EquiJoin::encryptFacts(const vector<int>& keys,
+                            const vector<double>& values,
+                            double maxValue)
+{
+  if (keys.size() != values.size())
+    throw invalid_argument("EquiJoin: keys and values differ in size");
+  for (int key : keys)
+    if (key < 0 || key >= (1 << numBits))
+      throw invalid_argument("EquiJoin: key " + to_string(key) +
+                             " out of range");
+  Encoder enc(he);
+  valueScale = maxValue;
+  chunks.clear();
+  for (size_t begin = 0; begin < keys.size(); begin += he.slotCount()) {
+    Chunk chunk(he);
+    chunk.keyBits = encryptBits(keys, begin);
+    vector<double> vals(he.slotCount(), 0);
+    vector<double> valid(he.slotCount(), 0);
+    for (int i = 0; i < he.slotCount() && begin + i < keys.size(); ++i) {
+      vals[i] = values[begin + i] / maxValue;
+      valid[i] = 1;
+    }
+    enc.encodeEncrypt(chunk.values, vals);
+    enc.encode(chunk.valid, valid);
+    chunks.push_back(move(chunk));
+  }
+}
+
+void EquiJoin::encryptDimension(const vector<int>& keys,
+                                const vector<int>& groups)
+{
+  if (keys.size() != groups.size())
+    throw invalid_argument("EquiJoin: keys and groups differ in size");
+  if (keys.size() > he.slotCount())
+    throw invalid_argument("EquiJoin: more dimension rows than slots");
+  vector<bool> seen(1 << numBits, false);
+  for (int key : keys) {
+    if (key < 0 || key >= (1 << numBits) || seen[key])
+      throw invalid_argument("EquiJoin: dimension key " + to_string(key) +
+                             " out of range or repeated");
+    seen[key] = true;
+  }
+  Encoder enc(he);
+  numDimRows = keys.size();
+  dimKeyBits = encryptBits(keys, 0);
+  dimGroups.assign(numGroups, CTile(he));
+  for (int g = 0; g < numGroups; ++g) {
+    vector<double> oneHot(he.slotCount(), 0);
+    for (int i = 0; i < numDimRows; ++i)
+      oneHot[i] = groups[i] == g;
+    enc.encodeEncrypt(dimGroups[g], oneHot);
+  }
+}
+
+CTile EquiJoin::broadcastSlot(const CTile& ct, int slot) const
+{
+  Encoder enc(he);
+  vector<double> mask(he.slotCount(), 0);
+  mask[slot] = 1;
+  PTile maskPlain(he);
+  enc.encode(maskPlain, mask);
+  CTile res = ct;
+  res.multiplyPlain(maskPlain);
+  for (int rot = 1; rot < he.slotCount(); rot *= 2) {
+    CTile rotated = res;
+    rotated.rotate(rot);
+    res.add(rotated);
+  }
+  return res;
+}
+
+CTile EquiJoin::equal(const vector<CTile>& keyBits,
+                      const vector<CTile>& key) const
+{
+  vector<CTile> eq;
+  for (int b = 0; b < numBits; ++b) {
+    // 1 - a - b + 2ab, with the doubling as an addition to save a level.
+    CTile bitEq = keyBits[b];
+    bitEq.multiply(key[b]);
+    bitEq.add(bitEq);
+    bitEq.sub(keyBits[b]);
+    bitEq.sub(key[b]);
+    bitEq.addScalar(1.0);
+    eq.push_back(move(bitEq));
+  }
+  // Product tree of the bit equalities.
+  while (eq.size() > 1) {
+    vector<CTile> next;
+    for (size_t i = 0; i + 1 < eq.size(); i += 2) {
+      next.push_back(eq[i]);
+      next.back().multiply(eq[i + 1]);
+    }
+    if (eq.size() % 2 == 1)
+      next.push_back(eq.back());
+    eq = move(next);
+  }
+  return eq[0];
+}
+
+vector<vector<CTile>> EquiJoin::join() const
+{
+  if (chunks.empty() || numDimRows == 0)
+    throw runtime_error("EquiJoin: encrypt both tables before joining");
+  vector<vector<CTile>> joined(chunks.size(),
+                               vector<CTile>(numGroups, CTile(he)));
+
+  for (int row = 0; row < numDimRows; ++row) {
+    // Broadcast the key bits and the group of the dimension row, shared by
+    // all chunks.
+    vector<CTile> key(numBits, CTile(he));
+    vector<CTile> group(numGroups, CTile(he));
+#pragma omp parallel for
+    for (int i = 0; i < numBits + numGroups; ++i) {
+      if (i < numBits)
+        key[i] = broadcastSlot(dimKeyBits[i], row);
+      else
+        group[i - numBits] = broadcastSlot(dimGroups[i - numBits], row);
+    }
+
+#pragma omp parallel for
+    for (int c = 0; c < chunks.size(); ++c) {
+      CTile match = equal(chunks[c].keyBits, key);
+      for (int g = 0; g < numGroups; ++g) {
+        CTile matchGroup = match;
+        matchGroup.multiply(group[g]);
+        if (row == 0)
+          joined[c][g] = matchGroup;
+        else
+          joined[c][g].add(matchGroup);
+      }
+    }
+  }
+  return joined;
+}
+
+EquiJoin::GroupedAggregates EquiJoin::aggregate() const
+{
+  vector<vector<CTile>> joined = join();
+  GroupedAggregates res;
+  res.sums.assign(numGroups, CTile(he));
+  res.counts.assign(numGroups, CTile(he));
+#pragma omp parallel for
+  for (int g = 0; g < numGroups; ++g) {
+    for (size_t c = 0; c < chunks.size(); ++c) {
+      CTile sum = joined[c][g];
+      sum.multiply(chunks[c].values);
+      // Padding rows may have joined the dimension row of key 0.
+      CTile count = joined[c][g];
+      count.multiplyPlain(chunks[c].valid);
+      if (c == 0) {
+        res.sums[g] = sum;
+        res.counts[g] = count;
+      } else {
+        res.sums[g].add(sum);
+        res.counts[g].add(count);
+      }
+    }
+  }
+  return res;
+}
+
+void EquiJoin::decrypt(const GroupedAggregates& res,
+                       vector<double>& sums,
+                       vector<double>& counts) const
+{
+  Encoder enc(he);
+  sums.assign(numGroups, 0);
+  counts.assign(numGroups, 0);
+  for (int g = 0; g < numGroups; ++g) {
+    for (double v : enc.decryptDecodeDouble(res.sums[g]))
+      sums[g] += v * valueScale;
+    for (double v : enc.decryptDecodeDouble(res.counts[g]))
+      counts[g] += v;
+  }
+}
@@ -0,0 +1,136 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef EQUI_JOIN_H_
+#define EQUI_JOIN_H_
+
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Encrypted equi-join of a fact table with a dimension table on a key
+// column, followed by aggregates grouped by an attribute of the dimension
+// table. For example, the SUM and COUNT of the transactions of every client
+// segment, where transactions have a client_id and tx_sum and client profiles
+// have a client_id and a segment, with both tables encrypted.
+//
+// Keys are integers of numBits bits, stored bitwise as in the hybrid bitwise
+// columns of helayers::Table: one ciphertext per bit. The fact table is
+// packed in chunks of slotCount rows, so a single equality test compares a
+// key with slotCount rows at once. The dimension table is packed in one
+// ciphertext per bit and one per group, holding the one-hot encoding of the
+// group of every row, so it takes at most slotCount rows and its keys must be
+// distinct.
+//
+// The join handles the dimension rows one after the other. Each is first
+// broadcast to all slots, with a masking multiplication and log(slotCount)
+// rotations, and then compared with all chunks in parallel. Two keys are
+// equal when all their bits are, and bits a and b are equal when
+// 1 - a - b + 2ab is 1. Every chunk accumulates, for every group, the
+// indicator that its rows joined a dimension row of that group. The
+// aggregates multiply these indicators by the values of the rows and sum over
+// the chunks; the sum over the slots is left to decryption, as in
+// helayers::Table. Rows without a matching key are left out, as in an inner
+// join.
+//
+// The join costs numDimRows * numChunks equality tests, in depth
+// getDepth(), so it suits dimension tables with a few hundred rows.
+class EquiJoin
+{
+public:
+  // The encrypted results of an aggregate query: per group, a ciphertext
+  // whose slots sum up to the SUM and one whose slots sum up to the COUNT.
+  struct GroupedAggregates
+  {
+    std::vector<helayers::CTile> sums;
+    std::vector<helayers::CTile> counts;
+  };
+
+private:
+  struct Chunk
+  {
+    std::vector<helayers::CTile> keyBits;
+    helayers::CTile values;
+    // 1 in the slots of rows, 0 in the padding of the last chunk.
+    helayers::PTile valid;
+
+    explicit Chunk(const helayers::HeContext& he) : values(he), valid(he) {}
+  };
+
+  const helayers::HeContext& he;
+  int numBits;
+  int numGroups;
+  double valueScale = 1;
+  std::vector<Chunk> chunks;
+  std::vector<helayers::CTile> dimKeyBits;
+  std::vector<helayers::CTile> dimGroups;
+  int numDimRows = 0;
+
+  std::vector<helayers::CTile> encryptBits(const std::vector<int>& keys,
+                                           int begin) const;
+
+  // Returns a ciphertext with slot of ct in all slots.
+  helayers::CTile broadcastSlot(const helayers::CTile& ct, int slot) const;
+
+  // Returns the equality of the keys of a chunk with a broadcast key.
+  helayers::CTile equal(const std::vector<helayers::CTile>& keyBits,
+                        const std::vector<helayers::CTile>& key) const;
+
+public:
+  EquiJoin(const helayers::HeContext& he, int numBits, int numGroups);
+
+  // Returns the multiplication depth of aggregate().
+  int getDepth() const;
+
+  int getNumChunks() const { return chunks.size(); }
+
+  // Encrypts the fact table: the key and the value of every row. Values are
+  // scaled by 1 / maxValue before encryption, and scaled back by decrypt().
+  void encryptFacts(const std::vector<int>& keys,
+                    const std::vector<double>& values,
+                    double maxValue);
+
+  // Encrypts the dimension table: the key and the group, in
+  // 0, ..., numGroups - 1, of every row.
+  void encryptDimension(const std::vector<int>& keys,
+                        const std::vector<int>& groups);
+
+  // Joins the tables on their keys and returns, for every chunk and every
+  // group, the encrypted indicator of the rows of the chunk that joined a
+  // dimension row of that group.
+  std::vector<std::vector<helayers::CTile>> join() const;
+
+  // SUM value, COUNT * GROUP BY the group of the joined dimension row.
+  GroupedAggregates aggregate() const;
+
+  // Decrypts the results of aggregate(), summing the slots of every
+  // ciphertext.
+  void decrypt(const GroupedAggregates& res,
+               std::vector<double>& sums,
+               std::vector<double>& counts) const;
+};
+
+#endif
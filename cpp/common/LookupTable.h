@@ -0,0 +1,532 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef LOOKUP_TABLE_H_
+#define LOOKUP_TABLE_H_
+
+#include <cmath>
+#include <map>
+#include <optional>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Evaluation of lookup tables f(x), x in 0, ..., n, over an encrypted x.
+//
+// The examples look up encrypted small integers in several ad-hoc ways:
+// game_of_life tests a neighbour count for equality with a Lagrange basis
+// polynomial, and BGV_world_country_db_lookup with Fermat's little theorem.
+// LookupTable evaluates any table with one of three methods, and game_of_life
+// --lagrange uses it for its checks:
+//
+// LAGRANGE evaluates the interpolating polynomial of degree n as a linear
+// combination of the powers 1, ..., n of x. It needs n - 1 multiplications.
+//
+// PATERSON_STOCKMEYER splits the polynomial into blocks of k = ceil(sqrt(n +
+// 1)) coefficients: p(x) = sum_j q_j(x) x^jk, with every q_j a combination
+// of the baby steps x, ..., x^(k-1). It needs the baby steps and the giant
+// steps x^k, x^2k, ..., plus one multiplication per block, about 2 sqrt(n)
+// multiplications for the first table of an input.
+//
+// FERMAT, for BGV only, sums the indicators 1 - (x - a)^(p-1) of the entries
+// that differ from the most common value of the table. Every indicator costs
+// about 2 log2(p) multiplications whatever n is, so it wins on large domains
+// such as a whole byte.
+//
+// All the ciphertexts a table needs from its input, the powers and the
+// indicators, are computed by a LutInput and kept there, so that every further
+// table of the same input uses them for free. LutMethod::AUTO picks the method
+// with the fewest multiplications given what the input already holds, so the
+// second table of an input often uses a different method than the first.
+//
+// With CKKS the powers are the Chebyshev polynomials T_d(u) of
+// u = 2x/n - 1, which is in [-1, 1], rather than x^d: the values of T_d(u)
+// stay in [-1, 1] and the coefficients stay small, so the evaluation is
+// accurate with the small integer precision the examples use. With BGV they are x^d modulo the
+// plaintext modulus p, and the coefficients are solved modulo p.
+enum class LutMethod
+{
+  AUTO,
+  LAGRANGE,
+  PATERSON_STOCKMEYER,
+  FERMAT
+};
+
+inline std::string getLutMethodName(LutMethod method)
+{
+  switch (method) {
+  case LutMethod::AUTO:
+    return "auto";
+  case LutMethod::LAGRANGE:
+    return "lagrange";
+  case LutMethod::PATERSON_STOCKMEYER:
+    return "paterson-stockmeyer";
+  case LutMethod::FERMAT:
+    return "fermat";
+  }
+  return "";
+}
+
+// An encrypted x in 0, ..., n, with the powers and indicators computed from
+// it so far. T is CTile or CTileTensor. A modulus of 0 means CKKS, any other
+// modulus is the BGV plaintext modulus, which must be a prime above n.
+template <typename T>
+class LutInput
+{
+  T x;
+  int n;
+  int modulus;
+  // Degree d -> T_d(u) (CKKS) or x^d (BGV).
+  std::map<int, T> powers;
+  // a -> 1 where x == a, 0 elsewhere (BGV only).
+  std::map<int, T> indicators;
+
+  void addMissingPowers(int d, std::set<int>& missing) const
+  {
+    if (d == 0 || powers.count(d) > 0 || missing.count(d) > 0)
+      return;
+    missing.insert(d);
+    addMissingPowers((d + 1) / 2, missing);
+    addMissingPowers(d / 2, missing);
+  }
+
+public:
+  LutInput(const T& x, int n, int modulus = 0) : x(x), n(n), modulus(modulus)
+  {
+    if (n < 1)
+      throw std::invalid_argument("LutInput: the range must hold at least "
+                                  "two values");
+    if (modulus != 0 && n >= modulus)
+      throw std::invalid_argument("LutInput: the range exceeds the plaintext "
+                                  "modulus");
+    T first = x;
+    if (modulus == 0) {
+      first.multiplyScalar(2.0 / n);
+      first.addScalar(-1.0);
+    }
+    powers.emplace(1, std::move(first));
+  }
+
+  int getMaxValue() const { return n; }
+
+  int getModulus() const { return modulus; }
+
+  bool hasIndicator(int a) const { return indicators.count(a) > 0; }
+
+  // Returns how many multiplications computing all of the given powers
+  // takes, given the powers already computed.
+  int countMissingPowers(const std::vector<int>& degrees) const
+  {
+    std::set<int> missing;
+    for (int d : degrees)
+      addMissingPowers(d, missing);
+    return missing.size();
+  }
+
+  // Returns T_d(u) with CKKS, x^d with BGV, for 1 <= d <= n. x^2h is
+  // computed from x^h and x^2h+1 from x^h+1 and x^h, so x^d is
+  // ceil(log2(d)) multiplications deep.
+  const T& getPower(int d)
+  {
+    auto it = powers.find(d);
+    if (it != powers.end())
+      return it->second;
+    if (d < 1 || d > n)
+      throw std::invalid_argument("LutInput: no power " + std::to_string(d));
+    T t = getPower((d + 1) / 2);
+    if (d % 2 == 0)
+      t.square();
+    else
+      t.multiply(getPower(d / 2));
+    if (modulus == 0) {
+      // T_2h = 2 T_h^2 - 1 and T_2h+1 = 2 T_h+1 T_h - T_1.
+      t.add(t);
+      if (d % 2 == 0)
+        t.addScalar(-1.0);
+      else
+        t.sub(powers.at(1));
+    }
+    return powers.emplace(d, std::move(t)).first->second;
+  }
+
+  // Returns the multiplications one Fermat indicator takes.
+  int getIndicatorCost() const
+  {
+    int cost = 0;
+    for (int e = modulus - 1; e > 1; e /= 2)
+      cost += 1 + e % 2;
+    return cost;
+  }
+
+  // Returns 1 - (x - a)^(p-1), which is 1 where x == a and 0 elsewhere.
+  // BGV only.
+  const T& getIndicator(int a)
+  {
+    auto it = indicators.find(a);
+    if (it != indicators.end())
+      return it->second;
+    if (modulus == 0)
+      throw std::logic_error("LutInput: Fermat indicators need BGV");
+    T y = x;
+    y.addScalar(-a);
+    // Right to left square and multiply, as in BGV_world_country_db_lookup.
+    std::optional<T> acc;
+    for (int e = modulus - 1; e > 1; e /= 2) {
+      if (e % 2 == 1) {
+        if (acc)
+          acc->multiply(y);
+        else
+          acc = y;
+      }
+      y.square();
+    }
+    if (acc)
+      y.multiply(*acc);
+    y.negate();
+    y.addScalar(1);
+    return indicators.emplace(a, std::move(y)).first->second;
+  }
+};
+
+// A table of n + 1 values, evaluated on LutInputs of the same n and modulus.
+// With BGV the values must be integers and are taken modulo p.
+class LookupTable
+{
+  std::vector<double> table;
+  int modulus;
+  LutMethod method;
+  // Number of baby steps -> coefficients, see getCoefficients().
+  mutable std::map<int, std::vector<double>> coefficients;
+
+  int getMaxValue() const { return table.size() - 1; }
+
+  bool isZero(double c) const
+  {
+    return modulus == 0 ? std::abs(c) < 1e-12 : c == 0;
+  }
+
+  long reduce(long v) const { return ((v % modulus) + modulus) % modulus; }
+
+  long powMod(long b, long e) const
+  {
+    long res = 1;
+    for (b = reduce(b); e > 0; e /= 2, b = b * b % modulus)
+      if (e % 2 == 1)
+        res = res * b % modulus;
+    return res;
+  }
+
+  // The value at x = a of the power of degree d of the input.
+  double getPowerValue(int d, int a) const
+  {
+    if (modulus != 0)
+      return powMod(a, d);
+    int n = getMaxValue();
+    double u = 2.0 * a / n - 1;
+    double prev = 1;
+    double cur = u;
+    if (d == 0)
+      return 1;
+    for (int k = 2; k <= d; ++k) {
+      double next = 2 * u * cur - prev;
+      prev = cur;
+      cur = next;
+    }
+    return cur;
+  }
+
+  // Solves a c = b by Gaussian elimination, over the reals with CKKS and
+  // modulo p with BGV.
+  std::vector<double> solve(std::vector<std::vector<double>> a,
+                            std::vector<double> b) const
+  {
+    int size = b.size();
+    for (int col = 0; col < size; ++col) {
+      int pivot = col;
+      for (int row = col + 1; row < size; ++row)
+        if (modulus == 0 ? std::abs(a[row][col]) > std::abs(a[pivot][col])
+                         : a[pivot][col] == 0)
+          pivot = row;
+      std::swap(a[col], a[pivot]);
+      std::swap(b[col], b[pivot]);
+      double scale = modulus == 0 ? 1 / a[col][col]
+                                  : powMod(a[col][col], modulus - 2);
+      for (int row = 0; row < size; ++row) {
+        if (row == col || a[row][col] == 0)
+          continue;
+        double factor = a[row][col] * scale;
+        if (modulus != 0)
+          factor = reduce(factor);
+        for (int k = col; k < size; ++k) {
+          a[row][k] -= factor * a[col][k];
+          if (modulus != 0)
+            a[row][k] = reduce(a[row][k]);
+        }
+        b[row] -= factor * b[col];
+        if (modulus != 0)
+          b[row] = reduce(b[row]);
+      }
+    }
+    std::vector<double> c(size);
+    for (int i = 0; i < size; ++i)
+      c[i] = modulus == 0 ? b[i] / a[i][i]
+                          : reduce(b[i] * powMod(a[i][i], modulus - 2));
+    return c;
+  }
+
+  // With k baby steps the table is the sum over i < k and j of c[jk + i]
+  // times power i times power jk. The products have distinct degrees jk + i
+  // in 0, ..., n, so the coefficients are the solution of the linear system
+  // that requires the sum to match the table at every point. LAGRANGE is the
+  // case k = n + 1.
+  const std::vector<double>& getCoefficients(int k) const
+  {
+    auto it = coefficients.find(k);
+    if (it != coefficients.end())
+      return it->second;
+    int n = getMaxValue();
+    std::vector<std::vector<double>> system(n + 1,
+                                            std::vector<double>(n + 1));
+    for (int a = 0; a <= n; ++a)
+      for (int d = 0; d <= n; ++d) {
+        system[a][d] = getPowerValue(d % k, a) * getPowerValue(d - d % k, a);
+        if (modulus != 0)
+          system[a][d] = reduce(system[a][d]);
+      }
+    return coefficients.emplace(k, solve(system, table)).first->second;
+  }
+
+  int getBabySteps(LutMethod m) const
+  {
+    int n = getMaxValue();
+    if (m == LutMethod::LAGRANGE)
+      return n + 1;
+    return std::ceil(std::sqrt(n + 1.0));
+  }
+
+  // The value that FERMAT adds as a constant.
+  double getDefaultValue() const
+  {
+    std::map<double, int> counts;
+    for (double v : table)
+      counts[v]++;
+    auto best = counts.begin();
+    for (auto it = counts.begin(); it != counts.end(); ++it)
+      if (it->second > best->second)
+        best = it;
+    return best->first;
+  }
+
+  template <typename T>
+  void scale(T& t, double c) const
+  {
+    if (modulus == 0)
+      t.multiplyScalar(c);
+    else if (c != 1)
+      t.multiplyScalar((int)c);
+  }
+
+  template <typename T>
+  void addConstant(T& t, double c) const
+  {
+    if (isZero(c))
+      return;
+    if (modulus == 0)
+      t.addScalar(c);
+    else
+      t.addScalar((int)c);
+  }
+
+  template <typename T>
+  static void accumulate(std::optional<T>& res, T&& term)
+  {
+    if (res)
+      res->add(term);
+    else
+      res = std::move(term);
+  }
+
+  template <typename T>
+  void checkInput(const LutInput<T>& input) const
+  {
+    if (input.getMaxValue() != getMaxValue() ||
+        input.getModulus() != modulus)
+      throw std::invalid_argument("LookupTable: the input has a different "
+                                  "range or modulus");
+  }
+
+  template <typename T>
+  void evaluatePolynomial(T& res, LutInput<T>& input, int k) const
+  {
+    int n = getMaxValue();
+    const std::vector<double>& c = getCoefficients(k);
+    std::optional<T> sum;
+    for (int j = 0; j * k <= n; ++j) {
+      std::optional<T> block;
+      for (int i = 1; i < k && j * k + i <= n; ++i) {
+        if (isZero(c[j * k + i]))
+          continue;
+        T term = input.getPower(i);
+        scale(term, c[j * k + i]);
+        accumulate(block, std::move(term));
+      }
+      if (j == 0) {
+        if (block)
+          accumulate(sum, std::move(*block));
+        continue;
+      }
+      if (block) {
+        addConstant(*block, c[j * k]);
+        block->multiply(input.getPower(j * k));
+      } else if (!isZero(c[j * k])) {
+        block = input.getPower(j * k);
+        scale(*block, c[j * k]);
+      } else
+        continue;
+      accumulate(sum, std::move(*block));
+    }
+    if (!sum) {
+      sum = input.getPower(1);
+      sum->multiplyScalar(0);
+    }
+    addConstant(*sum, c[0]);
+    res = std::move(*sum);
+  }
+
+  template <typename T>
+  void evaluateFermat(T& res, LutInput<T>& input) const
+  {
+    double def = getDefaultValue();
+    std::optional<T> sum;
+    for (int a = 0; a <= getMaxValue(); ++a) {
+      if (table[a] == def)
+        continue;
+      T term = input.getIndicator(a);
+      scale(term, reduce((long)(table[a] - def)));
+      accumulate(sum, std::move(term));
+    }
+    if (!sum) {
+      sum = input.getPower(1);
+      sum->multiplyScalar(0);
+    }
+    addConstant(*sum, def);
+    res = std::move(*sum);
+  }
+
+public:
+  LookupTable(const std::vector<double>& table,
+              int modulus = 0,
+              LutMethod method = LutMethod::AUTO)
+      : table(table), modulus(modulus), method(method)
+  {
+    if (table.size() < 2)
+      throw std::invalid_argument("LookupTable: the table must hold at least "
+                                  "two values");
+    if (modulus == 0 && method == LutMethod::FERMAT)
+      throw std::invalid_argument("LookupTable: Fermat evaluation needs BGV");
+    if (modulus != 0) {
+      if (getMaxValue() >= modulus)
+        throw std::invalid_argument("LookupTable: the table is larger than "
+                                    "the plaintext modulus");
+      for (double& v : this->table) {
+        if (v != std::floor(v))
+          throw std::invalid_argument("LookupTable: BGV tables must hold "
+                                      "integers");
+        v = reduce(v);
+      }
+    }
+  }
+
+  LutMethod getMethod() const { return method; }
+
+  // Returns the number of multiplications evaluating the table on input
+  // with method m takes, given what the input already holds, or -1 if m
+  // does not apply. For PATERSON_STOCKMEYER this is an upper bound, since
+  // blocks that are constant need no multiplication.
+  template <typename T>
+  int getCost(const LutInput<T>& input, LutMethod m) const
+  {
+    int n = getMaxValue();
+    if (m == LutMethod::FERMAT) {
+      if (modulus == 0)
+        return -1;
+      double def = getDefaultValue();
+      int cost = 0;
+      for (int a = 0; a <= n; ++a)
+        if (table[a] != def && !input.hasIndicator(a))
+          cost += input.getIndicatorCost();
+      return cost;
+    }
+    int k = getBabySteps(m);
+    std::vector<int> degrees;
+    for (int i = 1; i < k && i <= n; ++i)
+      degrees.push_back(i);
+    int blocks = 0;
+    for (int j = 1; j * k <= n; ++j, ++blocks)
+      degrees.push_back(j * k);
+    return input.countMissingPowers(degrees) + blocks;
+  }
+
+  // Returns the method evaluate() uses on input: the one given to the
+  // constructor, or with AUTO the cheapest one, preferring LAGRANGE, then
+  // PATERSON_STOCKMEYER on ties.
+  template <typename T>
+  LutMethod chooseMethod(const LutInput<T>& input) const
+  {
+    if (method != LutMethod::AUTO)
+      return method;
+    LutMethod best = LutMethod::AUTO;
+    int bestCost = -1;
+    for (LutMethod m : {LutMethod::LAGRANGE,
+                        LutMethod::PATERSON_STOCKMEYER,
+                        LutMethod::FERMAT}) {
+      int cost = getCost(input, m);
+      if (cost >= 0 && (bestCost < 0 || cost < bestCost)) {
+        best = m;
+        bestCost = cost;
+      }
+    }
+    return best;
+  }
+
+  // res = table[x]. Returns the method used.
+  template <typename T>
+  LutMethod evaluate(T& res, LutInput<T>& input) const
+  {
+    checkInput(input);
+    LutMethod m = chooseMethod(input);
+    if (m == LutMethod::FERMAT)
+      evaluateFermat(res, input);
+    else
+      evaluatePolynomial(res, input, getBabySteps(m));
+    return m;
+  }
+};
+
+#endif
@@ -0,0 +1,212 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "NumaExecutor.h"
+
+#include <omp.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+static const string nodeDir = "/sys/devices/system/node";
+
+// Parses a cpulist such as "0-3,8-11".
+static vector<int> parseCpuList(const string& list)
+{
+  vector<int> res;
+  stringstream ss(list);
+  string range;
+  while (getline(ss, range, ',')) {
+    if (range.empty() || range == "\n")
+      continue;
+    size_t dash = range.find('-');
+    int first = stoi(range.substr(0, dash));
+    int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu)
+      res.push_back(cpu);
+  }
+  return res;
+}
+
+vector<NumaNode> NumaExecutor::getNodes()
+{
+  vector<NumaNode> nodes;
+  error_code ec;
+  for (const auto& entry : filesystem::directory_iterator(nodeDir, ec)) {
+    string name = entry.path().filename().string();
+    if (name.rfind("node", 0) != 0 ||
+        name.find_first_not_of("0123456789", 4) != string::npos)
+      continue;
+    ifstream in(entry.path() / "cpulist");
+    string list;
+    getline(in, list);
+    NumaNode node{stoi(name.substr(4)), parseCpuList(list)};
+    if (!node.cpus.empty())
+      nodes.push_back(node);
+  }
+  if (nodes.empty()) {
+    NumaNode node{0, {}};
+    for (unsigned int cpu = 0; cpu < thread::hardware_concurrency(); ++cpu)
+      node.cpus.push_back(cpu);
+    nodes.push_back(node);
+  }
+  sort(nodes.begin(), nodes.end(), [](const NumaNode& a, const NumaNode& b) {
+    return a.id < b.id;
+  });
+  return nodes;
+}
+
+NumaExecutor::NumaExecutor(bool bind) : bind(bind)
+{
+  for (const NumaNode& node : getNodes()) {
+    workers.push_back(make_unique<Worker>());
+    workers.back()->node = node;
+  }
+  for (auto& worker : workers)
+    worker->thread = thread(&NumaExecutor::workerLoop, this, ref(*worker));
+}
+
+NumaExecutor::~NumaExecutor()
+{
+  for (auto& worker : workers) {
+    {
+      lock_guard<mutex> lock(worker->mtx);
+      worker->stop = true;
+    }
+    worker->cv.notify_one();
+  }
+  for (auto& worker : workers)
+    worker->thread.join();
+}
+
+void NumaExecutor::workerLoop(Worker& worker)
+{
+  if (bind) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : worker.node.cpus)
+      CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+      cerr << "WARNING: failed to pin the worker of NUMA node "
+           << worker.node.id << endl;
+  }
+  // Each worker gets as many OpenMP threads as its node has CPUs, so that
+  // bound and unbound runs use the same amount of parallelism.
+  omp_set_num_threads(worker.node.cpus.size());
+
+  while (true) {
+    packaged_task<void()> task;
+    {
+      unique_lock<mutex> lock(worker.mtx);
+      worker.cv.wait(lock,
+                     [&worker] { return worker.stop || !worker.tasks.empty(); });
+      if (worker.tasks.empty())
+        return;
+      task = std::move(worker.tasks.front());
+      worker.tasks.pop();
+    }
+    task();
+  }
+}
+
+future<void> NumaExecutor::submit(int i, function<void()> task)
+{
+  Worker& worker = *workers.at(i);
+  packaged_task<void()> packaged(std::move(task));
+  future<void> res = packaged.get_future();
+  {
+    lock_guard<mutex> lock(worker.mtx);
+    worker.tasks.push(std::move(packaged));
+  }
+  worker.cv.notify_one();
+  return res;
+}
+
+void NumaExecutor::runOnAllNodes(const function<void(int)>& task)
+{
+  vector<future<void>> futures;
+  for (int i = 0; i < getNumNodes(); ++i)
+    futures.push_back(submit(i, [&task, i] { task(i); }));
+  // Wait for all tasks before rethrowing, since they reference task.
+  for (auto& f : futures)
+    f.wait();
+  for (auto& f : futures)
+    f.get();
+}
+
+NumaStats NumaStats::read()
+{
+  NumaStats res;
+  for (const NumaNode& node : NumaExecutor::getNodes()) {
+    ifstream in(nodeDir + "/node" + to_string(node.id) + "/numastat");
+    string name;
+    long value;
+    while (in >> name >> value)
+      res.counters[node.id][name] = value;
+  }
+  return res;
+}
+
+NumaStats NumaStats::operator-(const NumaStats& other) const
+{
+  NumaStats res = *this;
+  for (auto& node : res.counters) {
+    auto otherNode = other.counters.find(node.first);
+    if (otherNode == other.counters.end())
+      continue;
+    for (auto& counter : node.second) {
+      auto otherCounter = otherNode->second.find(counter.first);
+      if (otherCounter != otherNode->second.end())
+        counter.second -= otherCounter->second;
+    }
+  }
+  return res;
+}
+
+double NumaStats::getCrossNodeRate(double seconds)
+{
+  NumaStats before = read();
+  this_thread::sleep_for(chrono::duration<double>(seconds));
+  return (read() - before).getCrossNodeAllocations() / seconds;
+}
+
+long NumaStats::getTotal(const string& counter) const
+{
+  long res = 0;
+  for (const auto& node : counters) {
+    auto it = node.second.find(counter);
+    if (it != node.second.end())
+      res += it->second;
+  }
+  return res;
+}
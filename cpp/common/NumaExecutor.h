@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef NUMA_EXECUTOR_H_
+#define NUMA_EXECUTOR_H_
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct NumaNode
+{
+  int id;
+  std::vector<int> cpus;
+};
+
+// Per-node allocation counters from /sys/devices/system/node/node*/numastat.
+// These count page allocations, not memory traffic: other_node counts pages
+// allocated on a node for a process running on another node, which is the
+// cross-node traffic that node-local execution avoids.
+//
+// The counters are system-wide: the difference of two readings includes the
+// allocations of every process on the machine between them, not only those
+// of the caller. Measure on an otherwise idle machine, or subtract the
+// background rate of the counters (see getCrossNodeRate()).
+struct NumaStats
+{
+  // node -> counter name -> value
+  std::map<int, std::map<std::string, long>> counters;
+
+  static NumaStats read();
+
+  NumaStats operator-(const NumaStats& other) const;
+
+  long getTotal(const std::string& counter) const;
+
+  // Pages that were allocated on a node other than the one of the requesting
+  // CPU.
+  long getCrossNodeAllocations() const { return getTotal("other_node"); }
+
+  // Samples the cross-node allocations of the whole system over the given
+  // interval, and returns their rate per second. Taken before a measurement,
+  // it estimates the background allocations of other processes during it.
+  static double getCrossNodeRate(double seconds);
+};
+
+// Runs tasks on one worker thread per NUMA node. When binding is on, every
+// worker is pinned to the CPUs of its node, so both its computation and the
+// memory it touches first (Linux allocates pages on the node of the thread
+// that first writes them) stay on that node. Objects that a worker should
+// process are therefore best created by a task of that worker. OpenMP teams
+// started by a worker inherit its CPU set.
+//
+// With binding off, the workers run unpinned, which serves as a baseline.
+class NumaExecutor
+{
+  struct Worker
+  {
+    NumaNode node;
+    std::thread thread;
+    std::queue<std::packaged_task<void()>> tasks;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool stop = false;
+  };
+
+  bool bind;
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  void workerLoop(Worker& worker);
+
+public:
+  // Returns the NUMA nodes that have CPUs. Falls back to a single node with
+  // all CPUs if the system does not expose NUMA information.
+  static std::vector<NumaNode> getNodes();
+
+  explicit NumaExecutor(bool bind = true);
+
+  ~NumaExecutor();
+
+  NumaExecutor(const NumaExecutor&) = delete;
+  NumaExecutor& operator=(const NumaExecutor&) = delete;
+
+  int getNumNodes() const { return workers.size(); }
+
+  const NumaNode& getNode(int i) const { return workers.at(i)->node; }
+
+  bool isBound() const { return bind; }
+
+  // Queues task on the worker of the i-th node.
+  std::future<void> submit(int i, std::function<void()> task);
+
+  // Runs task(i) on the worker of every node i and waits for all of them.
+  // Rethrows the first exception thrown by a task.
+  void runOnAllNodes(const std::function<void(int)>& task);
+};
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "OneHotEncoder.h"
+
+#include <cmath>
+#include <stdexcept>
+
+#include "helayers/math/TTEncoder.h"
+
+using namespace std;
+using namespace helayers;
+
+OneHotEncoder::OneHotEncoder(const HeContext& he,
+                             const vector<int>& numCategories)
+    : he(he), numCategories(numCategories)
+{
+  for (size_t f = 0; f < numCategories.size(); ++f) {
+    if (numCategories[f] <= 0)
+      throw invalid_argument("OneHotEncoder: feature " + to_string(f) +
+                             " has no categories");
+    for (int v = 0; v < numCategories[f]; ++v) {
+      columnFeature.push_back(f);
+      columnValue.push_back(v);
+    }
+    maxAbs = max(maxAbs, numCategories[f] - 1);
+  }
+  if (getNumColumns() > he.slotCount())
+    throw invalid_argument("OneHotEncoder: more columns than slots");
+}
+
+int OneHotEncoder::getDepth() const
+{
+  return maxAbs == 0 ? 0 : 2 + ceil(log2(maxAbs));
+}
+
+TTShape OneHotEncoder::getBatchShape(int batchSize) const
+{
+  int tileColumns = 1;
+  while (tileColumns < getNumColumns())
+    tileColumns *= 2;
+  TTShape shape{he.slotCount() / tileColumns, tileColumns};
+  shape.setOriginalSizes({batchSize, getNumColumns()});
+  return shape;
+}
+
+DoubleTensor OneHotEncoder::getCodesTensor(
+    const vector<vector<int>>& codes) const
+{
+  int batchSize = codes.size();
+  DoubleTensor vals({batchSize, getNumColumns()});
+  for (int s = 0; s < batchSize; ++s) {
+    if (codes[s].size() != numCategories.size())
+      throw invalid_argument("OneHotEncoder: sample " + to_string(s) +
+                             " has a wrong number of features");
+    for (int j = 0; j < getNumColumns(); ++j)
+      vals.at(s, j) = codes[s][columnFeature[j]];
+  }
+  return vals;
+}
+
+CTileTensor OneHotEncoder::encryptCodes(
+    const vector<vector<int>>& codes) const
+{
+  TTEncoder enc(he);
+  CTileTensor res(he);
+  enc.encodeEncrypt(res, getBatchShape(codes.size()), getCodesTensor(codes));
+  return res;
+}
+
+void OneHotEncoder::encode(CTileTensor& x) const
+{
+  if (maxAbs == 0) {
+    // A single category per feature: every column is 1.
+    x.multiplyScalar(0.0);
+    x.addScalar(1.0);
+    return;
+  }
+
+  // x - (value of the column), for all samples at once. The offsets are
+  // duplicated over the batch in the tile layout of x.
+  DoubleTensor offsets({1, getNumColumns()});
+  for (int j = 0; j < getNumColumns(); ++j)
+    offsets.at(0, j) = -columnValue[j];
+  TTShape offsetsShape = x.getShape().getWithDuplicatedDim(0);
+  offsetsShape.setOriginalSizes({1, getNumColumns()});
+  TTEncoder enc(he);
+  PTileTensor plainOffsets(he);
+  enc.encode(plainOffsets, offsetsShape, offsets, x.getChainIndex());
+  x.addPlain(plainOffsets);
+
+  // The factors 1 - x^2 / v^2. Pairing small v with large v keeps the
+  // partial products small at the integers where one factor is 0 but the
+  // others are large.
+  vector<int> order;
+  for (int low = 1, high = maxAbs; low <= high; ++low, --high) {
+    order.push_back(low);
+    if (low != high)
+      order.push_back(high);
+  }
+  CTileTensor square = x.getSquare();
+  vector<CTileTensor> factors;
+  for (int v : order) {
+    factors.push_back(square);
+    factors.back().multiplyScalar(-1.0 / (v * v));
+    factors.back().addScalar(1.0);
+  }
+
+  // Product tree.
+  while (factors.size() > 1) {
+    vector<CTileTensor> next;
+    for (size_t i = 0; i + 1 < factors.size(); i += 2) {
+      factors[i].multiply(factors[i + 1]);
+      next.push_back(std::move(factors[i]));
+    }
+    if (factors.size() % 2 == 1)
+      next.push_back(std::move(factors.back()));
+    factors = std::move(next);
+  }
+  x = std::move(factors[0]);
+}
+
+DoubleTensor OneHotEncoder::encodePlain(
+    const vector<vector<int>>& codes) const
+{
+  int batchSize = codes.size();
+  DoubleTensor res({batchSize, getNumColumns()});
+  for (int s = 0; s < batchSize; ++s)
+    for (int j = 0; j < getNumColumns(); ++j)
+      res.at(s, j) = codes[s][columnFeature[j]] == columnValue[j];
+  return res;
+}
@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef ONE_HOT_ENCODER_H_
+#define ONE_HOT_ENCODER_H_
+
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/DoubleTensor.h"
+
+// One-hot encoding of encrypted categorical features.
+//
+// Feature f takes the integer codes 0, ..., numCategories[f] - 1 and is
+// expanded to numCategories[f] one-hot columns. All features of a batch of
+// samples are kept in one tile tensor of shape [batch, columns], the layout
+// of the inputs of the linear and neural network models, so the result can
+// be fed to a model directly.
+//
+// The data owner encrypts the code of every feature in each of its columns
+// (see encryptCodes()). Column j of feature f is then 1 if and only if the
+// code minus j is 0, so the encoding subtracts a plaintext holding the value
+// of every column and evaluates a single indicator of zero on the whole
+// tensor. This is the packed counterpart of comparing with every value
+// separately, as checkEqualTensorInPlace() of game_of_life does: one
+// evaluation covers all samples, features and categories at once.
+//
+// The differences are integers in [-m, m], where m + 1 is the largest number
+// of categories, and the indicator is the polynomial
+// prod_{v=1..m} (1 - x^2 / v^2), which is exactly 1 at 0 and 0 at every other
+// integer in this range. It is computed as a product tree of depth
+// 2 + ceil(log2(m)).
+class OneHotEncoder
+{
+  const helayers::HeContext& he;
+  std::vector<int> numCategories;
+  // The feature and the category of every column.
+  std::vector<int> columnFeature;
+  std::vector<int> columnValue;
+  int maxAbs = 0;
+
+public:
+  OneHotEncoder(const helayers::HeContext& he,
+                const std::vector<int>& numCategories);
+
+  int getNumColumns() const { return columnFeature.size(); }
+
+  // Returns the multiplication depth of encode().
+  int getDepth() const;
+
+  // Returns the shape of the tensor of encryptCodes() for batchSize samples.
+  helayers::TTShape getBatchShape(int batchSize) const;
+
+  // Returns codes[sample][feature] with the code of every feature replicated
+  // in each of its columns, a tensor of shape [samples, columns]. It can be
+  // encrypted by encryptCodes(), or by the ModelIoEncoder of a model whose
+  // inputs are the one-hot columns, to get the model's input layout.
+  helayers::DoubleTensor getCodesTensor(
+      const std::vector<std::vector<int>>& codes) const;
+
+  // Encrypts getCodesTensor(codes) in the shape of getBatchShape().
+  helayers::CTileTensor encryptCodes(
+      const std::vector<std::vector<int>>& codes) const;
+
+  // Replaces the codes of x, as encrypted by encryptCodes() or in any other
+  // tile layout of shape [samples, columns], with their one-hot encoding.
+  void encode(helayers::CTileTensor& x) const;
+
+  // Returns the one-hot encoding of codes in plain, a tensor of shape
+  // [samples, columns].
+  helayers::DoubleTensor encodePlain(
+      const std::vector<std::vector<int>>& codes) const;
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "PirDatabase.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using namespace helayers;
+
+PirDatabase::PirDatabase(const HeContext& he,
+                         const vector<vector<int>>& rows,
+                         int dimensions)
+    : he(he), numRows(rows.size()), dimensions(dimensions)
+{
+  if (rows.empty())
+    throw invalid_argument("PirDatabase: no rows");
+  if (dimensions < 1)
+    throw invalid_argument("PirDatabase: dimensions must be positive");
+  size_t maxLen = 1;
+  for (const auto& row : rows)
+    maxLen = max(maxLen, row.size());
+  if (maxLen > he.slotCount())
+    throw invalid_argument("PirDatabase: a row is longer than slotCount");
+  rowSlots = 1;
+  while (rowSlots < maxLen)
+    rowSlots *= 2;
+  rowsPerTile = he.slotCount() / rowSlots;
+
+  int numTiles = (numRows + rowsPerTile - 1) / rowsPerTile;
+  // The smallest n with n^dimensions >= numTiles. pow() may round either
+  // way, so n is adjusted in integers.
+  auto getCapacity = [dimensions](int n) {
+    int capacity = 1;
+    for (int d = 0; d < dimensions; ++d)
+      capacity *= n;
+    return capacity;
+  };
+  dimSize = max(1, (int)floor(pow(numTiles, 1.0 / dimensions)));
+  while (getCapacity(dimSize) < numTiles)
+    ++dimSize;
+  int capacity = getCapacity(dimSize);
+
+  // The missing tiles of the last dimensions are zero.
+  Encoder enc(he);
+  tiles.resize(capacity, PTile(he));
+  for (int t = 0; t < capacity; ++t) {
+    vector<int> vals(he.slotCount(), 0);
+    for (int r = 0; r < rowsPerTile; ++r) {
+      int index = t * rowsPerTile + r;
+      if (index >= numRows)
+        break;
+      for (size_t i = 0; i < rows[index].size(); ++i)
+        vals[r * rowSlots + i] = rows[index][i];
+    }
+    enc.encode(tiles[t], vals);
+  }
+}
+
+vector<CTile> PirDatabase::encryptQuery(int index) const
+{
+  if (index < 0 || index >= numRows)
+    throw out_of_range("PirDatabase: row index " + to_string(index) +
+                       " out of range");
+  Encoder enc(he);
+  int tile = index / rowsPerTile;
+  int offset = index % rowsPerTile;
+  vector<int> rowMask(he.slotCount(), 0);
+  for (int i = 0; i < rowSlots; ++i)
+    rowMask[offset * rowSlots + i] = 1;
+
+  vector<CTile> query(getQuerySize(), CTile(he));
+  for (int d = 0; d < dimensions; ++d) {
+    int digit = tile % dimSize;
+    tile /= dimSize;
+    for (int j = 0; j < dimSize; ++j) {
+      CTile& ct = query[d * dimSize + j];
+      if (j != digit)
+        enc.encodeEncrypt(ct, vector<int>(he.slotCount(), 0));
+      else if (d == 0)
+        enc.encodeEncrypt(ct, rowMask);
+      else
+        enc.encodeEncrypt(ct, vector<int>(he.slotCount(), 1));
+    }
+  }
+  return query;
+}
+
+void PirDatabase::retrieve(CTile& res, const vector<CTile>& query) const
+{
+  if (query.size() != getQuerySize())
+    throw invalid_argument("PirDatabase: query of a wrong size");
+
+  // The first dimension, with plaintext multiplications only: every n
+  // consecutive tiles are folded into one ciphertext.
+  int numGroups = tiles.size() / dimSize;
+  vector<CTile> folded(numGroups, CTile(he));
+#pragma omp parallel for
+  for (int g = 0; g < numGroups; ++g) {
+    CTile prod(he);
+    for (int j = 0; j < dimSize; ++j) {
+      if (j == 0) {
+        folded[g] = query[0];
+        folded[g].multiplyPlain(tiles[g * dimSize]);
+      } else {
+        prod = query[j];
+        prod.multiplyPlain(tiles[g * dimSize + j]);
+        folded[g].add(prod);
+      }
+    }
+  }
+
+  // The further dimensions fold every n consecutive ciphertexts the same
+  // way, with ciphertext multiplications.
+  for (int d = 1; d < dimensions; ++d) {
+    numGroups /= dimSize;
+    vector<CTile> next(numGroups, CTile(he));
+#pragma omp parallel for
+    for (int g = 0; g < numGroups; ++g) {
+      for (int j = 0; j < dimSize; ++j) {
+        CTile& ct = folded[g * dimSize + j];
+        ct.multiply(query[d * dimSize + j]);
+        if (j == 0)
+          next[g] = ct;
+        else
+          next[g].add(ct);
+      }
+    }
+    folded = move(next);
+  }
+  res = folded[0];
+}
+
+vector<int> PirDatabase::decryptRow(const CTile& res, int index) const
+{
+  Encoder enc(he);
+  vector<int> vals = enc.decryptDecodeInt(res);
+  int begin = (index % rowsPerTile) * rowSlots;
+  return vector<int>(vals.begin() + begin, vals.begin() + begin + rowSlots);
+}
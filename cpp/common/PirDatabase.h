@@ -0,0 +1,99 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef PIR_DATABASE_H_
+#define PIR_DATABASE_H_
+
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Private information retrieval of the rows of a plaintext database by their
+// index.
+//
+// When the client knows the index of the row it wants, it does not need the
+// server to compare keys: it sends an encrypted one-hot selection of the row,
+// and the server multiplies every plaintext of the database by its selection
+// bit and sums, with no rotation and no equality test.
+//
+// Rows are packed: every row takes rowSlots slots, the longest row rounded up
+// to a power of 2, so that every plaintext tile holds slotCount / rowSlots
+// rows. Tile t is addressed by the digits of t in base n, one digit per
+// dimension, where n^dimensions is at least the number of tiles. The query
+// of a row holds n ciphertexts per dimension, all zeros except the one of
+// the digit of the tile in that dimension. In the first dimension, that
+// ciphertext is 1 on the slots of the row within its tile, and in the other
+// dimensions it is all ones.
+//
+// retrieve() multiplies the tiles by the first dimension of the query in
+// plain and sums every n consecutive products, then folds each further
+// dimension the same way with ciphertext multiplications. A single
+// dimension needs a ciphertext per tile in the query but only plaintext
+// multiplications. Every further dimension shrinks the query to
+// dimensions * n ciphertexts, at the cost of one multiplication depth and of
+// a ciphertext multiplication per remaining product.
+class PirDatabase
+{
+  const helayers::HeContext& he;
+  int numRows;
+  int rowSlots;
+  int rowsPerTile;
+  int dimensions;
+  int dimSize;
+  std::vector<helayers::PTile> tiles;
+
+public:
+  // Packs rows, each of at most slotCount values, for queries of the given
+  // number of dimensions.
+  PirDatabase(const helayers::HeContext& he,
+              const std::vector<std::vector<int>>& rows,
+              int dimensions = 1);
+
+  int getNumRows() const { return numRows; }
+
+  int getNumTiles() const { return tiles.size(); }
+
+  int getRowSlots() const { return rowSlots; }
+
+  // Returns the multiplication depth of retrieve().
+  int getDepth() const { return dimensions; }
+
+  // Returns the number of ciphertexts in a query.
+  int getQuerySize() const { return dimensions * dimSize; }
+
+  // Client side: encrypts the query of the row at index.
+  std::vector<helayers::CTile> encryptQuery(int index) const;
+
+  // Server side: stores into res the row selected by query, in the slots it
+  // takes in its tile, and zeros elsewhere.
+  void retrieve(helayers::CTile& res,
+                const std::vector<helayers::CTile>& query) const;
+
+  // Client side: decrypts the row at index from the result of retrieve().
+  std::vector<int> decryptRow(const helayers::CTile& res, int index) const;
+};
+
+#endif
@@ -0,0 +1,285 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "QueryServer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Sends all of data, looping on short writes. Returns false if the peer has
+// gone. MSG_NOSIGNAL turns the SIGPIPE of a closed connection, which would
+// kill the process, into an EPIPE error.
+static bool sendAll(int fd, const string& data)
+{
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+    sent += n;
+  }
+  return true;
+}
+
+double LatencyStats::getTotal() const
+{
+  double total = 0;
+  for (double s : seconds)
+    total += s;
+  return total;
+}
+
+double LatencyStats::getPercentile(double p) const
+{
+  if (seconds.empty())
+    return 0;
+  vector<double> sorted = seconds;
+  sort(sorted.begin(), sorted.end());
+  size_t rank = ceil(p / 100 * sorted.size());
+  return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+double LatencyStats::getThroughput(size_t warmup) const
+{
+  if (seconds.size() <= warmup)
+    warmup = 0;
+  double total = 0;
+  for (size_t i = warmup; i < seconds.size(); ++i)
+    total += seconds[i];
+  return total == 0 ? 0 : (seconds.size() - warmup) / total;
+}
+
+void LatencyStats::print(ostream& out, const string& title) const
+{
+  out << title << ": " << seconds.size() << " queries in " << fixed
+      << setprecision(3) << getTotal() << " s" << endl;
+  if (seconds.empty())
+    return;
+  out << "\tLatency (ms): p50 " << getPercentile(50) * 1e3 << ", p90 "
+      << getPercentile(90) * 1e3 << ", p99 " << getPercentile(99) * 1e3
+      << ", max " << getPercentile(100) * 1e3 << endl;
+  out << "\tSteady state throughput: " << getThroughput() << " queries/s"
+      << endl;
+}
+
+bool QueryServer::serveLine(const string& line, string& response)
+{
+  if (line == "quit")
+    return false;
+  if (line == "stats") {
+    ostringstream out;
+    stats.print(out, "Served");
+    response = out.str();
+    return true;
+  }
+  // A malformed query fails its own request only, and is not counted in the
+  // latencies.
+  auto start = chrono::steady_clock::now();
+  try {
+    response = handler(line) + "\n";
+  } catch (const exception& e) {
+    response = string("error: ") + e.what() + "\n";
+    return true;
+  } catch (...) {
+    response = "error: unknown exception\n";
+    return true;
+  }
+  stats.add(chrono::duration<double>(chrono::steady_clock::now() - start)
+                .count());
+  return true;
+}
+
+void QueryServer::serveStream(istream& in, ostream& out)
+{
+  string line, response;
+  while (getline(in, line)) {
+    if (line.empty())
+      continue;
+    if (!serveLine(line, response))
+      return;
+    out << response << flush;
+  }
+}
+
+void QueryServer::serveSocket(const string& path)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw runtime_error("Socket path too long: " + path);
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0)
+    throw runtime_error("Failed to create a socket");
+  unlink(path.c_str());
+  if (bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+      listen(listener, 1) < 0) {
+    close(listener);
+    throw runtime_error("Failed to listen on " + path);
+  }
+
+  bool stop = false;
+  while (!stop) {
+    int client = accept(listener, nullptr, nullptr);
+    // A signal, or a client that disconnected before being accepted, does
+    // not stop the server.
+    if (client < 0 && (errno == EINTR || errno == ECONNABORTED))
+      continue;
+    if (client < 0)
+      break;
+    // Lines may arrive split over several reads, or several in one read.
+    string pending, response;
+    char buf[4096];
+    ssize_t n;
+    bool connected = true;
+    while (connected && !stop) {
+      n = read(client, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        break;
+      pending.append(buf, n);
+      size_t end;
+      while (connected && !stop &&
+             (end = pending.find('\n')) != string::npos) {
+        string line = pending.substr(0, end);
+        pending.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r')
+          line.pop_back();
+        if (line.empty())
+          continue;
+        if (!serveLine(line, response))
+          stop = true;
+        else if (!sendAll(client, response))
+          connected = false;
+      }
+    }
+    close(client);
+  }
+  close(listener);
+  unlink(path.c_str());
+}
+
+QueryClient::QueryClient(const string& path)
+{
+  sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw runtime_error("Socket path too long: " + path);
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    throw runtime_error("Failed to create a socket");
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+    close(fd);
+    throw runtime_error("Failed to connect to " + path);
+  }
+}
+
+QueryClient::~QueryClient() { close(fd); }
+
+string QueryClient::query(const string& line)
+{
+  if (!sendAll(fd, line + "\n"))
+    throw runtime_error("QueryClient: connection closed");
+  size_t end;
+  char buf[4096];
+  while ((end = pending.find('\n')) == string::npos) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      throw runtime_error("QueryClient: connection closed");
+    pending.append(buf, n);
+  }
+  string response = pending.substr(0, end);
+  pending.erase(0, end + 1);
+  return response;
+}
+
+static const string base64Chars =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+string toBase64(const string& data)
+{
+  string res;
+  res.reserve((data.size() + 2) / 3 * 4);
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32_t n = (uint8_t)data[i] << 16;
+    if (i + 1 < data.size())
+      n |= (uint8_t)data[i + 1] << 8;
+    if (i + 2 < data.size())
+      n |= (uint8_t)data[i + 2];
+    res.push_back(base64Chars[(n >> 18) & 63]);
+    res.push_back(base64Chars[(n >> 12) & 63]);
+    res.push_back(i + 1 < data.size() ? base64Chars[(n >> 6) & 63] : '=');
+    res.push_back(i + 2 < data.size() ? base64Chars[n & 63] : '=');
+  }
+  return res;
+}
+
+string fromBase64(const string& text)
+{
+  if (text.size() % 4 != 0)
+    throw invalid_argument("fromBase64: length not a multiple of 4");
+  string res;
+  res.reserve(text.size() / 4 * 3);
+  for (size_t i = 0; i < text.size(); i += 4) {
+    uint32_t n = 0;
+    int padding = 0;
+    for (int j = 0; j < 4; ++j) {
+      char c = text[i + j];
+      size_t v = 0;
+      if (c == '=' && i + 4 == text.size() && j >= 2)
+        ++padding;
+      else if ((v = base64Chars.find(c)) == string::npos || padding > 0)
+        throw invalid_argument("fromBase64: invalid character");
+      n = (n << 6) | v;
+    }
+    res.push_back((n >> 16) & 255);
+    if (padding < 2)
+      res.push_back((n >> 8) & 255);
+    if (padding < 1)
+      res.push_back(n & 255);
+  }
+  return res;
+}
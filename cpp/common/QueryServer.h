@@ -0,0 +1,118 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef QUERY_SERVER_H_
+#define QUERY_SERVER_H_
+
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Latencies of the queries served by a QueryServer.
+class LatencyStats
+{
+  std::vector<double> seconds;
+
+public:
+  void add(double seconds) { this->seconds.push_back(seconds); }
+
+  size_t size() const { return seconds.size(); }
+
+  // Total time spent serving queries, excluding the time spent waiting for
+  // them.
+  double getTotal() const;
+
+  // The p-th percentile, 0 <= p <= 100, by the nearest rank method.
+  double getPercentile(double p) const;
+
+  // Queries per second served once warm, i.e. excluding the first warmup
+  // queries, which also allocate the buffers reused by the later ones.
+  double getThroughput(size_t warmup = 1) const;
+
+  // Prints the percentiles, in milliseconds, and the throughput.
+  void print(std::ostream& out, const std::string& title) const;
+};
+
+// Serves line based queries with the state of a long running process, e.g. a
+// context and an encrypted database, so that initializing them is paid once
+// for all queries. Every query line is answered by the line the handler
+// returns, or by "error: " and its message if the handler throws, after which
+// the server goes on serving. Empty lines are skipped, and a "stats" line is
+// answered by the statistics so far instead of being passed to the handler.
+class QueryServer
+{
+public:
+  typedef std::function<std::string(const std::string&)> Handler;
+
+private:
+  Handler handler;
+  LatencyStats stats;
+
+  // Answers a single line. Returns false if the line asks to stop.
+  bool serveLine(const std::string& line, std::string& response);
+
+public:
+  explicit QueryServer(const Handler& handler) : handler(handler) {}
+
+  // Serves the lines of in until its end or a "quit" line.
+  void serveStream(std::istream& in, std::ostream& out);
+
+  // Listens on a unix domain socket at path and serves its clients one after
+  // the other, until one of them sends a "quit" line. A client is served
+  // until it closes its connection. An existing file at path is replaced.
+  void serveSocket(const std::string& path);
+
+  const LatencyStats& getStats() const { return stats; }
+};
+
+// A client of QueryServer::serveSocket().
+class QueryClient
+{
+  int fd = -1;
+  // Received data not returned yet.
+  std::string pending;
+
+public:
+  // Connects to the server listening at path.
+  explicit QueryClient(const std::string& path);
+
+  ~QueryClient();
+
+  QueryClient(const QueryClient&) = delete;
+  QueryClient& operator=(const QueryClient&) = delete;
+
+  // Sends a query line and returns the line answering it. Not for "stats",
+  // which is answered by several lines.
+  std::string query(const std::string& line);
+};
+
+// Binary data, such as serialized ciphertexts, is sent to and from a
+// QueryServer as a single line of base64 text.
+std::string toBase64(const std::string& data);
+std::string fromBase64(const std::string& text);
+
+#endif
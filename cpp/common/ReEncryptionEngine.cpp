@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ReEncryptionEngine.h"
+
+#include <sstream>
+#include <stdexcept>
+
+#include "ciphertext-ser.h"
+#include "cryptocontext-ser.h"
+#include "key/key-ser.h"
+#include "scheme/bgvrns/bgvrns-ser.h"
+
+using namespace std;
+using namespace lbcrypto;
+
+ReEncryptionEngine::ReEncryptionEngine(uint64_t plaintextModulus,
+                                       int depth,
+                                       uint32_t ringDimension)
+{
+  CCParams<CryptoContextBGVRNS> params;
+  params.SetPlaintextModulus(plaintextModulus);
+  params.SetMultiplicativeDepth(depth);
+  params.SetPREMode(INDCPA);
+  params.SetKeySwitchTechnique(HYBRID);
+  if (ringDimension != 0)
+    params.SetRingDim(ringDimension);
+  cc = GenCryptoContext(params);
+  cc->Enable(PKE);
+  cc->Enable(KEYSWITCH);
+  cc->Enable(LEVELEDSHE);
+  cc->Enable(PRE);
+}
+
+ReEncryptionEngine::KeyPair ReEncryptionEngine::generateKeys() const
+{
+  KeyPair keys = cc->KeyGen();
+  if (!keys.good())
+    throw runtime_error("ReEncryptionEngine: key generation failed");
+  return keys;
+}
+
+ReEncryptionEngine::ReKey ReEncryptionEngine::generateReKey(
+    const PrivateKey& oldKey,
+    const PublicKey& newKey) const
+{
+  return cc->ReKeyGen(oldKey, newKey);
+}
+
+ReEncryptionEngine::Ciphertext ReEncryptionEngine::encrypt(
+    const PublicKey& key,
+    const vector<int64_t>& vals) const
+{
+  if (vals.size() > getSlotCount())
+    throw invalid_argument("ReEncryptionEngine: " + to_string(vals.size()) +
+                           " values do not fit in " +
+                           to_string(getSlotCount()) + " slots");
+  return cc->Encrypt(key, cc->MakePackedPlaintext(vals));
+}
+
+vector<int64_t> ReEncryptionEngine::decrypt(const PrivateKey& key,
+                                            const Ciphertext& ctxt,
+                                            int length) const
+{
+  Plaintext res;
+  cc->Decrypt(key, ctxt, &res);
+  res->SetLength(length);
+  return res->GetPackedValue();
+}
+
+ReEncryptionEngine::Ciphertext ReEncryptionEngine::reEncrypt(
+    const Ciphertext& ctxt,
+    const ReKey& reKey) const
+{
+  return cc->ReEncrypt(ctxt, reKey);
+}
+
+void ReEncryptionEngine::reEncryptAll(vector<Ciphertext>& ctxts,
+                                      const ReKey& reKey) const
+{
+#pragma omp parallel for
+  for (size_t i = 0; i < ctxts.size(); ++i)
+    ctxts[i] = cc->ReEncrypt(ctxts[i], reKey);
+}
+
+string ReEncryptionEngine::serialize(const Ciphertext& ctxt)
+{
+  ostringstream out;
+  Serial::Serialize(ctxt, out, SerType::BINARY);
+  return out.str();
+}
+
+ReEncryptionEngine::Ciphertext ReEncryptionEngine::deserialize(
+    const string& blob)
+{
+  Ciphertext res;
+  istringstream in(blob);
+  Serial::Deserialize(res, in, SerType::BINARY);
+  return res;
+}
@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef RE_ENCRYPTION_ENGINE_H_
+#define RE_ENCRYPTION_ENGINE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "openfhe.h"
+
+// Proxy re-encryption of BGV ciphertexts, for rotating keys without
+// decrypting the data.
+//
+// The owner of the old secret key derives a re-encryption key from it and
+// the new public key alone: the new secret key never leaves its owner, and
+// the old one never leaves the old owner. Whoever holds the re-encryption
+// key (a server storing the ciphertexts) can then turn any ciphertext of the
+// old key into a ciphertext of the same plaintext under the new key, without
+// a round trip to either owner and without learning anything about the
+// data. The re-encrypted ciphertexts support the same homomorphic
+// operations as fresh ones.
+//
+// helayers does not expose key switching between unrelated secret keys, so
+// the engine uses the proxy re-encryption of OpenFHE directly, in the
+// IND-CPA mode: the server is trusted to follow the protocol, as in the
+// other examples.
+class ReEncryptionEngine
+{
+public:
+  typedef lbcrypto::CryptoContext<lbcrypto::DCRTPoly> Context;
+  typedef lbcrypto::KeyPair<lbcrypto::DCRTPoly> KeyPair;
+  typedef lbcrypto::PublicKey<lbcrypto::DCRTPoly> PublicKey;
+  typedef lbcrypto::PrivateKey<lbcrypto::DCRTPoly> PrivateKey;
+  typedef lbcrypto::EvalKey<lbcrypto::DCRTPoly> ReKey;
+  typedef lbcrypto::Ciphertext<lbcrypto::DCRTPoly> Ciphertext;
+
+private:
+  Context cc;
+
+public:
+  // A BGV context with the given plaintext modulus and multiplicative depth
+  // left for computations on the re-encrypted ciphertexts. A ring dimension
+  // of 0 lets OpenFHE choose the smallest one for 128-bit security.
+  ReEncryptionEngine(uint64_t plaintextModulus,
+                     int depth,
+                     uint32_t ringDimension = 0);
+
+  const Context& getContext() const { return cc; }
+
+  int getSlotCount() const { return cc->GetRingDimension(); }
+
+  // Generates a fresh key pair, e.g. for the next key period.
+  KeyPair generateKeys() const;
+
+  // Run by the owner of oldKey: derives the key that re-encrypts
+  // ciphertexts of oldKey for the owner of newKey.
+  ReKey generateReKey(const PrivateKey& oldKey, const PublicKey& newKey) const;
+
+  Ciphertext encrypt(const PublicKey& key,
+                     const std::vector<int64_t>& vals) const;
+
+  // Returns the first length slots of ctxt.
+  std::vector<int64_t> decrypt(const PrivateKey& key,
+                               const Ciphertext& ctxt,
+                               int length) const;
+
+  Ciphertext reEncrypt(const Ciphertext& ctxt, const ReKey& reKey) const;
+
+  // Re-encrypts all ciphertexts in place, in parallel.
+  void reEncryptAll(std::vector<Ciphertext>& ctxts, const ReKey& reKey) const;
+
+  static std::string serialize(const Ciphertext& ctxt);
+  static Ciphertext deserialize(const std::string& blob);
+};
+
+#endif
@@ -0,0 +1,147 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ReKeyPipeline.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <future>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "CiphertextContainer.h"
+
+using namespace std;
+
+namespace {
+
+// Flushes the file or directory at path to the disk.
+void syncPath(const string& path, bool directory)
+{
+  int fd = open(path.c_str(), O_RDONLY | (directory ? O_DIRECTORY : 0));
+  if (fd < 0)
+    throw runtime_error("ReKeyPipeline: failed to open " + path);
+  int res = fsync(fd);
+  close(fd);
+  if (res != 0)
+    throw runtime_error("ReKeyPipeline: failed to sync " + path);
+}
+
+} // namespace
+
+ReKeyStats& ReKeyStats::operator+=(const ReKeyStats& other)
+{
+  files += other.files;
+  ciphertexts += other.ciphertexts;
+  bytesRead += other.bytesRead;
+  bytesWritten += other.bytesWritten;
+  seconds += other.seconds;
+  return *this;
+}
+
+double ReKeyStats::getGbPerHour() const
+{
+  return seconds > 0 ? bytesRead / 1e9 / (seconds / 3600) : 0;
+}
+
+ReKeyPipeline::ReKeyPipeline(const ReEncryptionEngine& engine,
+                             const ReEncryptionEngine::ReKey& reKey,
+                             size_t batchSize)
+    : engine(engine), reKey(reKey), batchSize(batchSize)
+{
+  if (batchSize == 0)
+    throw invalid_argument("ReKeyPipeline: the batch size must be positive");
+}
+
+ReKeyStats ReKeyPipeline::reKeyFile(const string& fileName) const
+{
+  auto start = chrono::high_resolution_clock::now();
+  CiphertextContainer in(fileName);
+  string tmpName = fileName + ".rekey";
+  CiphertextContainer::create(tmpName, in.getAlignment());
+  CiphertextContainer out(tmpName);
+
+  ReKeyStats stats;
+  stats.files = 1;
+  stats.ciphertexts = in.size();
+
+  // Deserialization looks the crypto context up in a registry shared by all
+  // threads, so it runs in the reader thread only.
+  auto readBatch = [&in, &stats](size_t first, size_t last) {
+    vector<ReEncryptionEngine::Ciphertext> batch;
+    for (size_t i = first; i < last; ++i) {
+      string blob = in.readBlob(i);
+      stats.bytesRead += blob.size();
+      batch.push_back(ReEncryptionEngine::deserialize(blob));
+    }
+    return batch;
+  };
+
+  size_t n = in.size();
+  future<vector<ReEncryptionEngine::Ciphertext>> next =
+      async(launch::async, readBatch, 0, min(n, batchSize));
+  for (size_t first = 0; first < n; first += batchSize) {
+    vector<ReEncryptionEngine::Ciphertext> batch = next.get();
+    size_t nextFirst = first + batchSize;
+    if (nextFirst < n)
+      next = async(
+          launch::async, readBatch, nextFirst, min(n, nextFirst + batchSize));
+
+    vector<string> blobs(batch.size());
+#pragma omp parallel for
+    for (size_t i = 0; i < batch.size(); ++i) {
+      ReEncryptionEngine::Ciphertext res = engine.reEncrypt(batch[i], reKey);
+      blobs[i] = ReEncryptionEngine::serialize(res);
+    }
+    for (const string& blob : blobs)
+      stats.bytesWritten += blob.size();
+    out.appendBlobs(blobs);
+  }
+
+  // The new file must be on the disk before it replaces the original one,
+  // and the rename must be on the disk before the run is reported as done.
+  // Otherwise a power loss could leave a truncated file in place of the
+  // original.
+  syncPath(tmpName, false);
+  if (rename(tmpName.c_str(), fileName.c_str()) != 0)
+    throw runtime_error("ReKeyPipeline: failed to replace " + fileName);
+  string dir = filesystem::path(fileName).parent_path().string();
+  syncPath(dir.empty() ? "." : dir, true);
+  stats.seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  return stats;
+}
+
+ReKeyStats ReKeyPipeline::reKeyFiles(const vector<string>& fileNames) const
+{
+  ReKeyStats stats;
+  for (const string& fileName : fileNames)
+    stats += reKeyFile(fileName);
+  return stats;
+}
@@ -0,0 +1,80 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef RE_KEY_PIPELINE_H_
+#define RE_KEY_PIPELINE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ReEncryptionEngine.h"
+
+// Throughput counters of a ReKeyPipeline run.
+struct ReKeyStats
+{
+  size_t files = 0;
+  size_t ciphertexts = 0;
+  uint64_t bytesRead = 0;
+  uint64_t bytesWritten = 0;
+  double seconds = 0;
+
+  ReKeyStats& operator+=(const ReKeyStats& other);
+
+  double getGbPerHour() const;
+};
+
+// Re-keys stored ciphertexts in bulk, for key rotation without decryption.
+//
+// The ciphertexts are stored in CiphertextContainer files (see
+// CiphertextContainer.h), as serialized OpenFHE ciphertexts. A file is
+// streamed in batches: a reader thread loads and deserializes the next batch
+// while the workers re-encrypt the current one in parallel, serialize it and
+// append it to a new container. Only batchSize ciphertexts of a file are in
+// memory at a time, whatever the size of the file.
+//
+// A file is re-keyed in place: the new container is written next to it and
+// renamed over it once all its entries are re-keyed and synced to the disk.
+// If the pipeline is interrupted, even by a power loss, the original file is
+// left intact under the old key, and the partial file, with a ".rekey"
+// suffix, is overwritten by the next run.
+class ReKeyPipeline
+{
+  const ReEncryptionEngine& engine;
+  ReEncryptionEngine::ReKey reKey;
+  size_t batchSize;
+
+public:
+  ReKeyPipeline(const ReEncryptionEngine& engine,
+                const ReEncryptionEngine::ReKey& reKey,
+                size_t batchSize = 64);
+
+  ReKeyStats reKeyFile(const std::string& fileName) const;
+
+  // Re-keys the files one after the other.
+  ReKeyStats reKeyFiles(const std::vector<std::string>& fileNames) const;
+};
+
+#endif
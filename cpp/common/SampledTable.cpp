@@ -0,0 +1,266 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "SampledTable.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace helayers;
+
+// Returns z such that a standard normal variable is in [-z, z] with the
+// given probability.
+static double getNormalQuantile(double confidence)
+{
+  if (confidence <= 0 || confidence >= 1)
+    throw invalid_argument("SampledTable: confidence must be in (0, 1)");
+  double low = 0, high = 40;
+  for (int i = 0; i < 100; ++i) {
+    double mid = (low + high) / 2;
+    if (erf(mid / sqrt(2.0)) < confidence)
+      low = mid;
+    else
+      high = mid;
+  }
+  return (low + high) / 2;
+}
+
+double SampledTable::Estimate::getRelativeError() const
+{
+  if (value == 0)
+    return high == low ? 0 : numeric_limits<double>::infinity();
+  return (high - low) / 2 / fabs(value);
+}
+
+SampledTable::SampledTable(const HeContext& he, istream& in, int chunkRows)
+{
+  if (chunkRows <= 0)
+    throw invalid_argument("SampledTable: chunkRows must be positive");
+  string header, line;
+  if (!getline(in, header))
+    throw runtime_error("SampledTable: missing header line");
+  bool done = false;
+  while (!done) {
+    stringstream chunk;
+    chunk << header << "\n";
+    int rows = 0;
+    while (rows < chunkRows && getline(in, line)) {
+      if (line.empty())
+        continue;
+      chunk << line << "\n";
+      ++rows;
+    }
+    done = rows < chunkRows;
+    if (rows > 0) {
+      chunks.push_back(make_shared<Table>(he, chunk));
+      numRows += rows;
+    }
+  }
+  if (chunks.empty())
+    throw runtime_error("SampledTable: empty table");
+}
+
+vector<int> SampledTable::sampleChunks(double fraction, uint64_t seed) const
+{
+  if (fraction <= 0 || fraction > 1)
+    throw invalid_argument("SampledTable: fraction must be in (0, 1]");
+  int numChunks = getNumChunks();
+  int sampleSize = min(numChunks, max(2, (int)ceil(fraction * numChunks)));
+  vector<int> indices(numChunks);
+  iota(indices.begin(), indices.end(), 0);
+  mt19937_64 rng(seed);
+  shuffle(indices.begin(), indices.end(), rng);
+  indices.resize(sampleSize);
+  sort(indices.begin(), indices.end());
+  return indices;
+}
+
+void SampledTable::queryChunks(const vector<int>& sample,
+                               bool withCount,
+                               const string& sumCol,
+                               const string& compareCol,
+                               int compareVal,
+                               ComparisonType comparisonType,
+                               vector<double>& counts,
+                               vector<double>& sums) const
+{
+  counts.clear();
+  sums.clear();
+  for (int c : sample) {
+    const Table& table = *chunks[c];
+    Field compareField = table.createCompareValue(compareVal, compareCol);
+    if (withCount) {
+      Field count =
+          table.countQuery(compareCol, compareField, comparisonType);
+      counts.push_back(table.postProcessCountQuery(count));
+    }
+    if (!sumCol.empty()) {
+      Field sum =
+          table.sumQuery(sumCol, compareCol, compareField, comparisonType);
+      sums.push_back(table.postProcessSumQuery(sum));
+    }
+  }
+}
+
+SampledTable::Estimate SampledTable::estimateTotal(const vector<double>& totals,
+                                                   double confidence) const
+{
+  int m = totals.size();
+  int numChunks = getNumChunks();
+  double mean = accumulate(totals.begin(), totals.end(), 0.0) / m;
+  double variance = 0;
+  for (double t : totals)
+    variance += (t - mean) * (t - mean);
+  variance /= max(1, m - 1);
+
+  // Variance of numChunks * mean, with the finite population correction.
+  double estimateVariance = (double)numChunks * numChunks *
+                            (1 - (double)m / numChunks) * variance / m;
+  double halfWidth = getNormalQuantile(confidence) * sqrt(estimateVariance);
+  Estimate res;
+  res.value = numChunks * mean;
+  res.low = res.value - halfWidth;
+  res.high = res.value + halfWidth;
+  res.sampledChunks = m;
+  return res;
+}
+
+SampledTable::Estimate SampledTable::estimateRatio(const vector<double>& sums,
+                                                   const vector<double>& counts,
+                                                   double confidence) const
+{
+  int m = sums.size();
+  int numChunks = getNumChunks();
+  double sumTotal = accumulate(sums.begin(), sums.end(), 0.0);
+  double countTotal = accumulate(counts.begin(), counts.end(), 0.0);
+  Estimate res;
+  res.sampledChunks = m;
+  if (countTotal == 0) {
+    // No sampled row matches: the average is undefined.
+    res.value = res.low = res.high = numeric_limits<double>::quiet_NaN();
+    return res;
+  }
+  double ratio = sumTotal / countTotal;
+
+  // Linearization of the ratio: the variance of the residuals of every
+  // chunk, divided by its mean count squared.
+  double variance = 0;
+  for (int i = 0; i < m; ++i) {
+    double residual = sums[i] - ratio * counts[i];
+    variance += residual * residual;
+  }
+  variance /= max(1, m - 1);
+  double meanCount = countTotal / m;
+  double estimateVariance = (1 - (double)m / numChunks) * variance /
+                            (m * meanCount * meanCount);
+  double halfWidth = getNormalQuantile(confidence) * sqrt(estimateVariance);
+  res.value = ratio;
+  res.low = ratio - halfWidth;
+  res.high = ratio + halfWidth;
+  return res;
+}
+
+SampledTable::Estimate SampledTable::countQuery(const string& compareCol,
+                                                int compareVal,
+                                                ComparisonType comparisonType,
+                                                double fraction,
+                                                uint64_t seed,
+                                                double confidence) const
+{
+  auto start = chrono::high_resolution_clock::now();
+  vector<double> counts, sums;
+  queryChunks(sampleChunks(fraction, seed),
+              true,
+              "",
+              compareCol,
+              compareVal,
+              comparisonType,
+              counts,
+              sums);
+  Estimate res = estimateTotal(counts, confidence);
+  res.seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  return res;
+}
+
+SampledTable::Estimate SampledTable::sumQuery(const string& sumCol,
+                                              const string& compareCol,
+                                              int compareVal,
+                                              ComparisonType comparisonType,
+                                              double fraction,
+                                              uint64_t seed,
+                                              double confidence) const
+{
+  auto start = chrono::high_resolution_clock::now();
+  vector<double> counts, sums;
+  queryChunks(sampleChunks(fraction, seed),
+              false,
+              sumCol,
+              compareCol,
+              compareVal,
+              comparisonType,
+              counts,
+              sums);
+  Estimate res = estimateTotal(sums, confidence);
+  res.seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  return res;
+}
+
+SampledTable::Estimate SampledTable::averageQuery(
+    const string& avgCol,
+    const string& compareCol,
+    int compareVal,
+    ComparisonType comparisonType,
+    double fraction,
+    uint64_t seed,
+    double confidence) const
+{
+  auto start = chrono::high_resolution_clock::now();
+  vector<double> counts, sums;
+  queryChunks(sampleChunks(fraction, seed),
+              true,
+              avgCol,
+              compareCol,
+              compareVal,
+              comparisonType,
+              counts,
+              sums);
+  Estimate res = estimateRatio(sums, counts, confidence);
+  res.seconds =
+      chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+          .count();
+  return res;
+}
@@ -0,0 +1,141 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef SAMPLED_TABLE_H_
+#define SAMPLED_TABLE_H_
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/db/Table.h"
+
+// Approximate aggregates over an encrypted table, for interactive
+// exploration.
+//
+// The table is split into chunks of consecutive rows, and every chunk is
+// encrypted as its own helayers Table. An exact query runs on all chunks, as
+// a query on a single Table does. An approximate query runs on a random
+// sample of the chunks, drawn from a seed, so its latency is about the
+// sampled fraction of the exact one, and scales the results up to the whole
+// table:
+// - COUNT and SUM are estimated by numChunks times the mean of the sampled
+//   chunk results.
+// - AVG is estimated by the ratio of the sampled SUM and COUNT.
+// Their confidence intervals are the normal approximations of these
+// estimators for a sample of chunks drawn without replacement. Their width
+// shrinks with the number of sampled chunks, and is 0 when all chunks are
+// sampled. Rows should be in random order with respect to the queried
+// columns, or the chunks should be small, for the intervals to be tight.
+//
+// The results of every sampled chunk are decrypted separately, so the
+// holder of the secret key learns the aggregates of each sampled chunk and
+// not only of the whole sample.
+class SampledTable
+{
+public:
+  struct Estimate
+  {
+    double value = 0;
+    // The confidence interval.
+    double low = 0;
+    double high = 0;
+    int sampledChunks = 0;
+    // Time of the encrypted queries and of decrypting their results.
+    double seconds = 0;
+
+    // Half the width of the confidence interval, relative to the value.
+    double getRelativeError() const;
+  };
+
+private:
+  std::vector<std::shared_ptr<helayers::Table>> chunks;
+  int numRows = 0;
+
+  // Runs the query on the given chunks and returns the count of matching
+  // rows of every chunk if withCount is set, and the sum of sumCol over them
+  // if sumCol is not empty.
+  void queryChunks(const std::vector<int>& sample,
+                   bool withCount,
+                   const std::string& sumCol,
+                   const std::string& compareCol,
+                   int compareVal,
+                   helayers::ComparisonType comparisonType,
+                   std::vector<double>& counts,
+                   std::vector<double>& sums) const;
+
+  Estimate estimateTotal(const std::vector<double>& totals,
+                         double confidence) const;
+
+  Estimate estimateRatio(const std::vector<double>& sums,
+                         const std::vector<double>& counts,
+                         double confidence) const;
+
+public:
+  // Reads a CSV table with a header line from in, as helayers::Table does,
+  // and encrypts it in chunks of chunkRows rows.
+  SampledTable(const helayers::HeContext& he, std::istream& in, int chunkRows);
+
+  int getNumChunks() const { return chunks.size(); }
+
+  int getNumRows() const { return numRows; }
+
+  // Returns the sorted indices of fraction of the chunks, rounded up and at
+  // least 2 so that the spread of the chunks can be estimated, drawn from
+  // seed. A fraction of 1 returns all chunks.
+  std::vector<int> sampleChunks(double fraction, uint64_t seed) const;
+
+  // COUNT * WHERE compareCol comparisonType compareVal.
+  Estimate countQuery(const std::string& compareCol,
+                      int compareVal,
+                      helayers::ComparisonType comparisonType,
+                      double fraction,
+                      uint64_t seed,
+                      double confidence = 0.95) const;
+
+  // SUM sumCol WHERE compareCol comparisonType compareVal.
+  Estimate sumQuery(const std::string& sumCol,
+                    const std::string& compareCol,
+                    int compareVal,
+                    helayers::ComparisonType comparisonType,
+                    double fraction,
+                    uint64_t seed,
+                    double confidence = 0.95) const;
+
+  // AVG avgCol WHERE compareCol comparisonType compareVal.
+  Estimate averageQuery(const std::string& avgCol,
+                        const std::string& compareCol,
+                        int compareVal,
+                        helayers::ComparisonType comparisonType,
+                        double fraction,
+                        uint64_t seed,
+                        double confidence = 0.95) const;
+};
+
+#endif
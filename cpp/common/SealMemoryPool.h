@@ -0,0 +1,178 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef SEAL_MEMORY_POOL_H_
+#define SEAL_MEMORY_POOL_H_
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "seal/memorymanager.h"
+
+// Pooling of the polynomial buffers of the SEAL backend.
+//
+// SEAL allocates the buffers of its ciphertexts, plaintexts and of the
+// temporaries of every operation from a seal::MemoryPool, which keeps the
+// buffers that are freed and hands them out again for allocations of the same
+// size. Allocations that do not name a pool, which includes all of those made
+// through helayers, take theirs from the memory manager profile.
+// SealMemoryPool switches the profile for its lifetime to one of:
+//
+// GLOBAL, SEAL's default: one pool for the whole process.
+// THREAD_LOCAL: one pool per thread, so that threads do not contend for the
+// lock of a shared pool.
+// CONTEXT: a pool of its own, e.g. for the lifetime of one HeContext. The
+// pool is released with the last buffer allocated from it.
+// NONE: a new pool for every request, so that no buffer is ever recycled.
+// This is the baseline the other modes save against.
+//
+// It also counts the requests for a pool, about one per ciphertext and per
+// operation, and the bytes the pools it handed out obtained from the system.
+// The pools of NONE are not kept, so their bytes are not counted.
+//
+// The profile is process wide, so there must be a single SealMemoryPool at a
+// time, and the other backends are not affected by it.
+enum class SealPoolMode
+{
+  GLOBAL,
+  THREAD_LOCAL,
+  CONTEXT,
+  NONE
+};
+
+inline std::string getSealPoolModeName(SealPoolMode mode)
+{
+  switch (mode) {
+  case SealPoolMode::GLOBAL:
+    return "global";
+  case SealPoolMode::THREAD_LOCAL:
+    return "thread";
+  case SealPoolMode::CONTEXT:
+    return "context";
+  case SealPoolMode::NONE:
+    return "new";
+  }
+  return "";
+}
+
+class SealMemoryPool
+{
+public:
+  struct Stats
+  {
+    long requests = 0;
+    // -1 with NONE.
+    long allocatedBytes = 0;
+  };
+
+private:
+  // Hands out the pools of another profile and counts them. Called by SEAL
+  // from every thread.
+  class CountingProfile : public seal::MMProf
+  {
+    std::unique_ptr<seal::MMProf> profile;
+    bool keepPools;
+    mutable std::mutex mutex;
+    long requests = 0;
+    // The distinct pools handed out, with their byte count when they were
+    // first handed out.
+    std::vector<std::pair<seal::MemoryPoolHandle, size_t>> pools;
+
+  public:
+    CountingProfile(std::unique_ptr<seal::MMProf> profile, bool keepPools)
+        : profile(std::move(profile)), keepPools(keepPools)
+    {}
+
+    seal::MemoryPoolHandle get_pool(seal::mm_prof_opt_t opt) override
+    {
+      seal::MemoryPoolHandle pool = profile->get_pool(opt);
+      std::lock_guard<std::mutex> lock(mutex);
+      requests++;
+      if (keepPools &&
+          std::none_of(pools.begin(), pools.end(), [&](auto& known) {
+            return pool == known.first;
+          }))
+        pools.emplace_back(pool, pool.alloc_byte_count());
+      return pool;
+    }
+
+    Stats getStats() const
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      Stats stats;
+      stats.requests = requests;
+      stats.allocatedBytes = keepPools ? 0 : -1;
+      for (const auto& known : pools)
+        stats.allocatedBytes += known.first.alloc_byte_count() - known.second;
+      return stats;
+    }
+  };
+
+  CountingProfile* counting;
+  std::unique_ptr<seal::MMProf> previous;
+
+  static std::unique_ptr<seal::MMProf> createProfile(SealPoolMode mode)
+  {
+    switch (mode) {
+    case SealPoolMode::THREAD_LOCAL:
+      return std::make_unique<seal::MMProfThreadLocal>();
+    case SealPoolMode::CONTEXT:
+      return std::make_unique<seal::MMProfFixed>(
+          seal::MemoryPoolHandle::New());
+    case SealPoolMode::NONE:
+      return std::make_unique<seal::MMProfNew>();
+    default:
+      return std::make_unique<seal::MMProfGlobal>();
+    }
+  }
+
+public:
+  explicit SealMemoryPool(SealPoolMode mode)
+  {
+    auto profile = std::make_unique<CountingProfile>(
+        createProfile(mode), mode != SealPoolMode::NONE);
+    counting = profile.get();
+    previous = seal::MemoryManager::SwitchProfile(std::move(profile));
+  }
+
+  // Restores the previous profile. Buffers allocated from the pools of this
+  // one keep them alive until they are freed.
+  ~SealMemoryPool()
+  {
+    seal::MemoryManager::SwitchProfile(std::move(previous));
+  }
+
+  SealMemoryPool(const SealMemoryPool&) = delete;
+  SealMemoryPool& operator=(const SealMemoryPool&) = delete;
+
+  // The requests and bytes since the pool was created.
+  Stats getStats() const { return counting->getStats(); }
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "TraceRecorder.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+using namespace chrono;
+
+TraceRecorder::TraceRecorder() : origin(steady_clock::now()) {}
+
+TraceRecorder& TraceRecorder::getInstance()
+{
+  static TraceRecorder instance;
+  return instance;
+}
+
+vector<TraceRecorder::OpenSpan>& TraceRecorder::getOpenSpans()
+{
+  thread_local vector<OpenSpan> openSpans;
+  return openSpans;
+}
+
+int TraceRecorder::getThreadId()
+{
+  // Chrome trace viewers expect small integer thread ids, so threads are
+  // numbered in order of their first span. Native thread ids are reused once
+  // a thread exits, so the number is kept in a thread local instead.
+  thread_local int threadId = 0;
+  if (threadId == 0)
+    threadId = ++numThreads;
+  return threadId;
+}
+
+void TraceRecorder::begin(const string& name)
+{
+  if (enabled) {
+    getOpenSpans().push_back({name, steady_clock::now(), true});
+    return;
+  }
+  // A span opened while recording is off is not recorded, but if it is
+  // nested in a recorded span it must be kept on the stack, or its end()
+  // would close the recorded span instead.
+  vector<OpenSpan>& openSpans = getOpenSpans();
+  if (!openSpans.empty())
+    openSpans.push_back({string(), steady_clock::time_point(), false});
+}
+
+void TraceRecorder::end()
+{
+  vector<OpenSpan>& openSpans = getOpenSpans();
+  // Spans opened while recording was off with no recorded span around them
+  // were never pushed, so there is nothing to close.
+  if (openSpans.empty())
+    return;
+  auto now = steady_clock::now();
+  OpenSpan open = std::move(openSpans.back());
+  openSpans.pop_back();
+  if (!open.recorded)
+    return;
+
+  Span span;
+  span.name = std::move(open.name);
+  span.depth = openSpans.size();
+  span.start = duration<double, micro>(open.start - origin).count();
+  span.duration = duration<double, micro>(now - open.start).count();
+
+  span.threadId = getThreadId();
+  lock_guard<mutex> lock(mtx);
+  spans.push_back(std::move(span));
+}
+
+void TraceRecorder::setThreadName(const string& name)
+{
+  int threadId = getThreadId();
+  lock_guard<mutex> lock(mtx);
+  threadNames[threadId] = name;
+}
+
+vector<TraceRecorder::Span> TraceRecorder::getSpans()
+{
+  lock_guard<mutex> lock(mtx);
+  return spans;
+}
+
+void TraceRecorder::clear()
+{
+  lock_guard<mutex> lock(mtx);
+  spans.clear();
+}
+
+static string jsonString(const string& s)
+{
+  string res = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      res += '\\';
+      res += c;
+    } else if (c == '\n')
+      res += "\\n";
+    else if (c == '\t')
+      res += "\\t";
+    else if (c == '\r')
+      res += "\\r";
+    else if (static_cast<unsigned char>(c) < 0x20) {
+      // Other control characters are not allowed unescaped in JSON strings.
+      char buf[7];
+      snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned char>(c));
+      res += buf;
+    } else
+      res += c;
+  }
+  return res + "\"";
+}
+
+void TraceRecorder::writeChromeTrace(const string& fileName)
+{
+  ofstream out(fileName);
+  if (!out)
+    throw runtime_error("Failed to open " + fileName);
+
+  lock_guard<mutex> lock(mtx);
+  out << fixed << setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << endl;
+  bool first = true;
+  for (const auto& threadName : threadNames) {
+    out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", "
+        << "\"pid\": 1, \"tid\": " << threadName.first
+        << ", \"args\": {\"name\": " << jsonString(threadName.second) << "}}";
+    first = false;
+  }
+  for (const Span& span : spans) {
+    out << (first ? "" : ",\n") << "{\"name\": " << jsonString(span.name)
+        << ", \"cat\": \"helayers\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+        << span.threadId << ", \"ts\": " << span.start
+        << ", \"dur\": " << span.duration
+        << ", \"args\": {\"depth\": " << span.depth << "}}";
+    first = false;
+  }
+  out << endl << "]}" << endl;
+  if (!out)
+    throw runtime_error("Failed to write " + fileName);
+}
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef TRACE_RECORDER_H_
+#define TRACE_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "helayers/hebase/HelayersTimer.h"
+
+// Records timed spans together with the thread that ran them and their nesting
+// depth, and writes them as a Chrome trace JSON file. The file can be opened
+// in chrome://tracing or https://ui.perfetto.dev to inspect parallel phases on
+// a timeline.
+//
+// Recording is off until setEnabled(true) is called, and costs an atomic load
+// and a check of the thread's open spans per span while off. Spans are usually
+// opened and closed with the macros at the end of this file, which also feed
+// the regular helayers timer.
+class TraceRecorder
+{
+public:
+  struct Span
+  {
+    std::string name;
+    int threadId;
+    int depth;
+    // Microseconds since the recorder was created.
+    double start;
+    double duration;
+  };
+
+private:
+  struct OpenSpan
+  {
+    std::string name;
+    std::chrono::steady_clock::time_point start;
+    // False for a span opened while recording was off, inside a recorded one.
+    // It is kept only so that its end() does not close the recorded span.
+    bool recorded;
+  };
+
+  std::atomic<bool> enabled{false};
+  std::chrono::steady_clock::time_point origin;
+
+  std::mutex mtx;
+  std::vector<Span> spans;
+  std::atomic<int> numThreads{0};
+  std::map<int, std::string> threadNames;
+
+  TraceRecorder();
+
+  static std::vector<OpenSpan>& getOpenSpans();
+
+public:
+  static TraceRecorder& getInstance();
+
+  // The id under which spans of the calling thread are recorded.
+  int getThreadId();
+
+  void setEnabled(bool enabled) { this->enabled = enabled; }
+
+  bool isEnabled() const { return enabled; }
+
+  // Opens a span on the calling thread. Spans of a thread must be closed in
+  // reverse order of opening.
+  void begin(const std::string& name);
+
+  // Closes the most recently opened span of the calling thread. Spans opened
+  // while recording was off are not recorded, even if it is on when they
+  // close.
+  void end();
+
+  // Names the calling thread in the trace, e.g. "alice" or "omp worker".
+  void setThreadName(const std::string& name);
+
+  std::vector<Span> getSpans();
+
+  void clear();
+
+  // Writes all closed spans in the Chrome trace event format.
+  void writeChromeTrace(const std::string& fileName);
+};
+
+// Opens a span in the constructor and closes it in the destructor.
+class TraceSection
+{
+public:
+  explicit TraceSection(const std::string& name)
+  {
+    TraceRecorder::getInstance().begin(name);
+  }
+
+  ~TraceSection() { TraceRecorder::getInstance().end(); }
+
+  TraceSection(const TraceSection&) = delete;
+  TraceSection& operator=(const TraceSection&) = delete;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Records a span for the rest of the enclosing scope, without touching the
+// helayers timer. Safe to use from any thread.
+#define HELAYERS_TRACE_SECTION(name)                                           \
+  TraceSection TRACE_CONCAT(traceSection, __LINE__)(name)
+
+// Drop-in replacements for HELAYERS_TIMER_PUSH/POP, HELAYERS_TIMER_SECTION
+// and HELAYERS_TIMER that also record the span in the trace.
+#define HELAYERS_TRACE_TIMER_PUSH(name)                                        \
+  do {                                                                         \
+    HELAYERS_TIMER_PUSH(name);                                                 \
+    TraceRecorder::getInstance().begin(name);                                  \
+  } while (0)
+
+#define HELAYERS_TRACE_TIMER_POP()                                             \
+  do {                                                                         \
+    TraceRecorder::getInstance().end();                                        \
+    HELAYERS_TIMER_POP();                                                      \
+  } while (0)
+
+#define HELAYERS_TRACE_TIMER_SECTION(name)                                     \
+  HELAYERS_TIMER_SECTION(name);                                                \
+  HELAYERS_TRACE_SECTION(name)
+
+#define HELAYERS_TRACE_TIMER(name)                                             \
+  HELAYERS_TIMER(name);                                                        \
+  HELAYERS_TRACE_SECTION(name)
+
+#endif
@@ -32,6 +32,7 @@
 #include "helayers/hebase/mockup/EmptyContext.h"
 #include "helayers/hebase/utils/PrintUtils.h"
 #include "helayers/math/FunctionEvaluator.h"
+#include "CiphertextOps.h"
 
 using namespace std;
 using namespace helayers;
@@ -53,6 +54,8 @@ int numChildren = 3;
 int repeats = 1;
 int gRep = 4;
 int fRep = 1;
+// Seed of the generated databases and queries, or -1 for seeding by the time.
+long long seed = -1;
 
 // Context options
 bool mockupContext = false;
@@ -97,6 +100,10 @@ void help()
   cout << "--g_rep n\tan integer parameter that controls the accuracy (and "
           "depth) of the comparison method under encryption."
        << endl;
+  cout << "--seed n\tan integer parameter that seeds the generated databases "
+          "and queries, making runs reproducible (default is the current "
+          "time)."
+       << endl;
   cout << endl;
 
   cout << "Context options:" << endl;
@@ -170,6 +177,8 @@ int main(int argc, char** argv)
       fRep = atoi(argv[++i]);
     else if (std::string(argv[i]) == "--g_rep")
       gRep = atoi(argv[++i]);
+    else if (std::string(argv[i]) == "--seed")
+      seed = atoll(argv[++i]);
     else if (std::string(argv[i]) == "--slots")
       numSlots = atoi(argv[++i]);
     else if (std::string(argv[i]) == "--depth")
@@ -188,6 +197,12 @@ int main(int argc, char** argv)
   shared_ptr<HeContext> he = initContext();
   printHeader(he);
 
+  // A single engine for all repeats, so that each repeat generates a
+  // different database.
+  default_random_engine re(seed >= 0 ? seed : time(0));
+  if (seed >= 0)
+    cout << "Seed: " << seed << endl;
+
   for (int repeat = 0; repeat < repeats; repeat++) {
 
     if (repeats > 1)
@@ -197,7 +212,6 @@ int main(int argc, char** argv)
     vector<uint16_t> database(numElements);
     double queryStart, queryEnd;
     uniform_int_distribution<> unif(0, rangeSize + 1);
-    default_random_engine re(time(0));
     for (size_t i = 0; i < database.size(); i++)
       database[i] = unif(re);
 
@@ -387,20 +401,26 @@ bool naiveEmptinessQuery(shared_ptr<HeContext> he,
     he->cudaDeviceSynchronize();
     HELAYERS_TIMER("naive-emptiness-query");
 
+    // The results of compare() are assigned into these temporaries, which are
+    // reused for all elements.
+    CTile lower(*he);
+    CTile upper(*he);
     for (const auto& elem : encryptedDatabase) {
-      CTile tmp = compare(fe, elem, cStart);
-      tmp.multiply(compare(fe, cEnd, elem));
-      tmp.sub(ones);
-      tmp.multiplyScalar(-1);
-      cRes.multiply(tmp);
+      lower = compare(fe, elem, cStart);
+      upper = compare(fe, cEnd, elem);
+      lower.multiply(upper);
+      // 1 - lower, computed without a scalar multiplication.
+      lower.negate();
+      lower.add(ones);
+      cRes.multiply(lower);
     }
 
     // Since we packed the database in SIMD fashion, we need to compute the big
     // AND of all bits in the resulted ciphertext, to get the final indicator.
+    // All rotations are written into the same temporary ciphertext.
     for (int rot = 1; rot < he->slotCount(); rot *= 2) {
-      CTile tmp(cRes);
-      tmp.rotate(rot);
-      cRes.multiply(tmp);
+      rotateInto(lower, cRes, rot);
+      cRes.multiply(lower);
     }
     he->cudaDeviceSynchronize();
   }
@@ -28,6 +28,9 @@
 #include "helayers/hebase/AlwaysAssert.h"
 #include "helayers/hebase/HelayersTimer.h"
 #include "helayers/hebase/utils/HelayersConfig.h"
+#include "DataGenerator.h"
+#include <filesystem>
+#include <tuple>
 
 using namespace std;
 using namespace helayers;
@@ -75,6 +78,10 @@ void help()
        << endl;
   cout << "--quiet\tAn optional flag sets the verbosity level to no verbosity."
        << endl;
+  cout << "--synthetic n\tLink two generated tables of n records each "
+          "instead of the tables in the data directory."
+       << endl;
+  cout << "--seed s\tThe seed of the generated tables." << endl;
   exit(1);
 }
 
@@ -106,6 +113,10 @@ int main(int argc, char* argv[])
   // ./er_basic_example --quiet
   int numRecords = 1000;
   Verbosity verbosity = VERBOSITY_REGULAR;
+  // Number of records of generated tables to link instead of the tables in
+  // the data directory (0 for using the data directory), and their seed.
+  int syntheticRecords = 0;
+  uint64_t seed = DataGenerator::DEFAULT_SEED;
 
   int i = 1;
   while (i < argc) {
@@ -116,6 +127,10 @@ int main(int argc, char* argv[])
       verbosity = VERBOSITY_DETAILED;
     else if (arg == "--quiet")
       verbosity = VERBOSITY_NONE;
+    else if (arg == "--synthetic" && i < argc)
+      syntheticRecords = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
     else
       help();
   }
@@ -131,6 +146,9 @@ int main(int argc, char* argv[])
   initSharedConfig(config);
 
   config.setVerbosity(verbosity);
+  // A generated table is read whole.
+  if (syntheticRecords > 0)
+    numRecords = syntheticRecords;
   printHeader(numRecords, config);
 
   // Here we define the rules by which we will consider two records as linked.
@@ -144,8 +162,20 @@ int main(int argc, char* argv[])
   // This step also processes the records (creates shingles and computes the
   // min-hashes) and encrypts the processed information (thus plaing the part of
   // the 1st party in a Diffie-Hellman like protocol).
-  alice.initRecordsFromFile(getDataSetsDir() + "/er/out1.csv", numRecords);
-  bob.initRecordsFromFile(getDataSetsDir() + "/er/out2.csv", numRecords);
+  string aliceFile = getDataSetsDir() + "/er/out1.csv";
+  string bobFile = getDataSetsDir() + "/er/out2.csv";
+  if (syntheticRecords > 0) {
+    DataGenerator generator(seed);
+    tie(aliceFile, bobFile) = generator.writeErRecordsFiles(syntheticRecords);
+    cout << "Generated two tables of " << syntheticRecords
+         << " records with seed " << seed << endl;
+  }
+  alice.initRecordsFromFile(aliceFile, numRecords);
+  bob.initRecordsFromFile(bobFile, numRecords);
+  if (syntheticRecords > 0) {
+    filesystem::remove(aliceFile);
+    filesystem::remove(bobFile);
+  }
 
   // Here we run the protocol. Each iteration we apply different rule to find
   // linked records. See implementation of runProtocolIteration below.
@@ -28,6 +28,9 @@
 #include "helayers/hebase/AlwaysAssert.h"
 #include "helayers/hebase/HelayersTimer.h"
 #include "helayers/hebase/utils/HelayersConfig.h"
+#include "DataGenerator.h"
+#include <filesystem>
+#include <tuple>
 
 using namespace std;
 using namespace helayers;
@@ -61,6 +64,10 @@ void help()
        << endl;
   cout << "--quiet\tAn optional flag sets the verbosity level to no verbosity."
        << endl;
+  cout << "--synthetic n\tLink two generated tables of n records each "
+          "instead of the tables in the data directory."
+       << endl;
+  cout << "--seed s\tThe seed of the generated tables." << endl;
   exit(1);
 }
 
@@ -80,6 +87,10 @@ int main(int argc, char* argv[])
 {
   int numRecords = 1000;
   Verbosity verbosity = VERBOSITY_REGULAR;
+  // Number of records of generated tables to link instead of the tables in
+  // the data directory (0 for using the data directory), and their seed.
+  int syntheticRecords = 0;
+  uint64_t seed = DataGenerator::DEFAULT_SEED;
 
   int i = 1;
   while (i < argc) {
@@ -90,6 +101,10 @@ int main(int argc, char* argv[])
       verbosity = VERBOSITY_DETAILED;
     else if (arg == "--quiet")
       verbosity = VERBOSITY_NONE;
+    else if (arg == "--synthetic" && i < argc)
+      syntheticRecords = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
     else
       help();
   }
@@ -101,14 +116,29 @@ int main(int argc, char* argv[])
   initSharedConfig(config);
 
   config.setVerbosity(verbosity);
+  // A generated table is read whole.
+  if (syntheticRecords > 0)
+    numRecords = syntheticRecords;
   printHeader(numRecords, config);
 
   vector<RecordLinkageRule> rules = initRules(config);
 
   RecordLinkageMockManager alice(config), bob(config);
 
-  alice.initRecordsFromFile(getDataSetsDir() + "/er/out1.csv", numRecords);
-  bob.initRecordsFromFile(getDataSetsDir() + "/er/out2.csv", numRecords);
+  string aliceFile = getDataSetsDir() + "/er/out1.csv";
+  string bobFile = getDataSetsDir() + "/er/out2.csv";
+  if (syntheticRecords > 0) {
+    DataGenerator generator(seed);
+    tie(aliceFile, bobFile) = generator.writeErRecordsFiles(syntheticRecords);
+    cout << "Generated two tables of " << syntheticRecords
+         << " records with seed " << seed << endl;
+  }
+  alice.initRecordsFromFile(aliceFile, numRecords);
+  bob.initRecordsFromFile(bobFile, numRecords);
+  if (syntheticRecords > 0) {
+    filesystem::remove(aliceFile);
+    filesystem::remove(bobFile);
+  }
 
   vector<pair<int, int>> resultsForIteration;
   for (RecordLinkageRule& rule : rules)
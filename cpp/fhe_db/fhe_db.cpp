@@ -26,11 +26,18 @@
 #include <iostream>
 #include <fstream>
 #include <chrono>
+#include <sstream>
+#include <cmath>
+#include <functional>
+#include <map>
 #include <assert.h>
 
 #include "helayers/hebase/hebase.h"
 #include "helayers/hebase/seal/SealCkksContext.h"
 #include "helayers/db/Table.h"
+#include "DataGenerator.h"
+#include "EquiJoin.h"
+#include "SampledTable.h"
 
 using namespace std;
 using namespace helayers;
@@ -137,8 +144,287 @@ double stdDevQuery(const Table& t,
   return stdDev;
 }
 
-int main()
+// Plain count, sum and average of the tx_sum values of the rows whose
+// client_id satisfies the comparison, computed from the CSV text of a table.
+struct PlainQueryResults
 {
+  double count = 0;
+  double sum = 0;
+
+  double getAverage() const { return sum / count; }
+};
+
+PlainQueryResults computePlainQuery(const string& csv,
+                                    int compareVal,
+                                    ComparisonType comparisonType)
+{
+  PlainQueryResults res;
+  istringstream in(csv);
+  string line;
+  getline(in, line); // header
+  while (getline(in, line)) {
+    int txId, clientId;
+    double txSum;
+    char comma;
+    istringstream row(line);
+    row >> txId >> comma >> clientId >> comma >> txSum;
+    bool match = comparisonType == IS_EQUAL ? clientId == compareVal
+                                            : clientId > compareVal;
+    if (match) {
+      res.count++;
+      res.sum += txSum;
+    }
+  }
+  return res;
+}
+
+// Runs a query of the approximate mode with the sampled fraction of the
+// chunks and prints the estimate, its confidence interval and its latency.
+// With check, also runs it on all the chunks and prints the exact result and
+// both latencies. query(f) runs the query on a fraction f of the chunks.
+void compareApproximate(
+    const string& description,
+    const function<SampledTable::Estimate(double)>& query,
+    double fraction,
+    bool check)
+{
+  cout << description << endl;
+  SampledTable::Estimate estimate = query(fraction);
+  cout << fixed << "estimate: " << estimate.value << " [" << estimate.low
+       << ", " << estimate.high << "] (+-" << estimate.getRelativeError() * 100
+       << "%) from " << estimate.sampledChunks << " chunks in "
+       << estimate.seconds << " s" << endl;
+  if (!check)
+    return;
+  SampledTable::Estimate exact = query(1);
+  cout << "exact: " << exact.value << " in " << exact.seconds << " s ("
+       << estimate.seconds / exact.seconds * 100 << "% of the latency), "
+       << (estimate.low <= exact.value && exact.value <= estimate.high
+               ? "inside"
+               : "outside")
+       << " the interval" << endl;
+}
+
+// The approximate mode: the queries of the exact mode, on a random fraction
+// of the chunks of the table (see SampledTable.h).
+void runApproximateQueries(const SampledTable& t,
+                           const string& opCol,
+                           const string& compareCol,
+                           double fraction,
+                           uint64_t seed,
+                           double confidence,
+                           bool check)
+{
+  cout << "Sampling " << fraction * 100 << "% of " << t.getNumChunks()
+       << " chunks, " << confidence * 100 << "% confidence intervals"
+       << endl;
+  for (ComparisonType comparisonType : {IS_EQUAL, IS_GREATER}) {
+    int compareVal = comparisonType == IS_EQUAL ? 9 : 50;
+    string where = " WHERE " + compareCol + " " +
+                   compTypeToStr(comparisonType) + " " +
+                   to_string(compareVal);
+    compareApproximate(
+        "COUNT *" + where,
+        [&](double f) {
+          return t.countQuery(
+              compareCol, compareVal, comparisonType, f, seed, confidence);
+        },
+        fraction,
+        check);
+    compareApproximate(
+        "SUM " + opCol + where,
+        [&](double f) {
+          return t.sumQuery(opCol,
+                            compareCol,
+                            compareVal,
+                            comparisonType,
+                            f,
+                            seed,
+                            confidence);
+        },
+        fraction,
+        check);
+    compareApproximate(
+        "AVG " + opCol + where,
+        [&](double f) {
+          return t.averageQuery(opCol,
+                                compareCol,
+                                compareVal,
+                                comparisonType,
+                                f,
+                                seed,
+                                confidence);
+        },
+        fraction,
+        check);
+  }
+}
+
+// The join mode: joins generated transactions with generated client profiles
+// on client_id, with both tables encrypted, and computes
+// SUM tx_sum, COUNT * and AVG tx_sum GROUP BY segment (see EquiJoin.h).
+void runJoinQueries(const HeContext& he,
+                    int numRows,
+                    int numBits,
+                    int numSegments,
+                    uint64_t seed)
+{
+  DataGenerator generator(seed);
+  stringstream transactions, profiles;
+  generator.writeTransactionsCsv(transactions, numRows, numBits);
+  generator.writeClientProfilesCsv(profiles, numBits, numSegments);
+
+  vector<int> clientIds;
+  vector<double> txSums;
+  string line;
+  getline(transactions, line); // header
+  while (getline(transactions, line)) {
+    int txId, clientId;
+    double txSum;
+    char comma;
+    istringstream row(line);
+    row >> txId >> comma >> clientId >> comma >> txSum;
+    clientIds.push_back(clientId);
+    txSums.push_back(txSum);
+  }
+  map<int, int> segmentOf;
+  vector<int> profileIds, segments;
+  getline(profiles, line); // header
+  while (getline(profiles, line)) {
+    int clientId, segment;
+    char comma;
+    istringstream row(line);
+    row >> clientId >> comma >> segment;
+    segmentOf[clientId] = segment;
+    profileIds.push_back(clientId);
+    segments.push_back(segment);
+  }
+  cout << "Joining " << numRows << " transactions with " << profileIds.size()
+       << " client profiles on client_id" << endl;
+
+  EquiJoin join(he, numBits, numSegments);
+  always_assert(join.getDepth() <= he.getTopChainIndex());
+  HELAYERS_TIMER_PUSH("join tables encryption");
+  join.encryptFacts(clientIds, txSums, 50000);
+  join.encryptDimension(profileIds, segments);
+  HELAYERS_TIMER_POP();
+
+  cout << "SUM tx_sum, COUNT *, AVG tx_sum GROUP BY segment over "
+       << join.getNumChunks() << " chunks" << endl;
+  HELAYERS_TIMER_PUSH("join query");
+  EquiJoin::GroupedAggregates res = join.aggregate();
+  HELAYERS_TIMER_POP();
+  vector<double> sums, counts;
+  HELAYERS_TIMER_PUSH("decrypt join query");
+  join.decrypt(res, sums, counts);
+  HELAYERS_TIMER_POP();
+
+  // The expected results, joined in plain.
+  vector<double> expectedSums(numSegments, 0);
+  vector<double> expectedCounts(numSegments, 0);
+  for (size_t i = 0; i < clientIds.size(); ++i) {
+    auto it = segmentOf.find(clientIds[i]);
+    if (it == segmentOf.end())
+      continue;
+    expectedSums[it->second] += txSums[i];
+    expectedCounts[it->second]++;
+  }
+  for (int g = 0; g < numSegments; ++g) {
+    cout << fixed << "segment " << g << ": sum " << sums[g] << ", count "
+         << counts[g] << ", avg " << sums[g] / counts[g] << endl;
+    always_assert(round(counts[g]) == expectedCounts[g]);
+    always_assert(fabs(sums[g] - expectedSums[g]) <=
+                  1e-5 * max(1.0, expectedSums[g]));
+  }
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("join tables encryption");
+  HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("join query");
+}
+
+void usage()
+{
+  cout << "Usage: ./fhe_db [--synthetic <rows>] [--seed <int>]" << endl;
+  cout << "--synthetic <rows>\tQuery a generated table of this many rows "
+          "instead of the table file"
+       << endl;
+  cout << "--seed <int>\t\tSeed of the generated table" << endl;
+  cout << "--approx <fraction>\tEstimate the queries from this fraction of "
+          "the table"
+       << endl;
+  cout << "--approx_seed <int>\tSeed of the sampled chunks" << endl;
+  cout << "--approx_check\t\tAlso run the approximate queries on the whole "
+          "table and compare"
+       << endl;
+  cout << "--chunk_rows <int>\tRows per chunk in the approximate mode "
+          "(default: the number of slots)"
+       << endl;
+  cout << "--confidence <real>\tConfidence level of the intervals (default "
+          "0.95)"
+       << endl;
+  cout << "--join\t\t\tJoin generated transactions with client profiles"
+       << endl;
+  cout << "--join_rows <rows>\tTransactions of the join (default 65536)"
+       << endl;
+  cout << "--join_bits <int>\tBits of the client ids of the join (default 8)"
+       << endl;
+  cout << "--segments <int>\tClient segments of the join (default 4)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+  // Number of rows of a synthetic table to query instead of the table file
+  // (0 for using the file), and the seed generating it.
+  int syntheticRows = 0;
+  uint64_t seed = DataGenerator::DEFAULT_SEED;
+
+  // The approximate mode: the fraction of the chunks that are queried (0 for
+  // the exact mode), the seed drawing them, the rows of a chunk (0 for the
+  // number of slots) and the confidence level of the intervals. With
+  // approxCheck, every query also runs exactly on all the chunks, which costs
+  // the time of the exact query.
+  double approxFraction = 0;
+  uint64_t approxSeed = 1;
+  bool approxCheck = false;
+  int chunkRows = 0;
+  double confidence = 0.95;
+
+  // The join mode: the number of transactions, the bits of their client ids
+  // and the number of client segments.
+  bool joinMode = false;
+  int joinRows = 65536;
+  int joinBits = 8;
+  int numSegments = 4;
+
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--synthetic" && i < argc)
+      syntheticRows = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--approx" && i < argc)
+      approxFraction = stod(argv[i++]);
+    else if (arg == "--approx_seed" && i < argc)
+      approxSeed = stoull(argv[i++]);
+    else if (arg == "--approx_check")
+      approxCheck = true;
+    else if (arg == "--chunk_rows" && i < argc)
+      chunkRows = stoi(argv[i++]);
+    else if (arg == "--confidence" && i < argc)
+      confidence = stod(argv[i++]);
+    else if (arg == "--join")
+      joinMode = true;
+    else if (arg == "--join_rows" && i < argc)
+      joinRows = stoi(argv[i++]);
+    else if (arg == "--join_bits" && i < argc)
+      joinBits = stoi(argv[i++]);
+    else if (arg == "--segments" && i < argc)
+      numSegments = stoi(argv[i++]);
+    else {
+      usage();
+      throw runtime_error("Unsupported argument: " + arg);
+    }
+  }
+
   HeConfigRequirement req;
   req.multiplicationDepth = 9;
   req.numSlots = 16384;
@@ -148,12 +434,45 @@ int main()
   he.init(req);
   he.printSignature(cout);
   Encoder enc(he);
+
+  if (joinMode) {
+    runJoinQueries(he, joinRows, joinBits, numSegments, seed);
+    return 0;
+  }
+
   string tablePath = getDataSetsDir() + "/db/txsmillion11Bits.csv";
-  ifstream ifs(tablePath);
+  ifstream ifs;
+  stringstream syntheticTable;
+  if (syntheticRows > 0) {
+    DataGenerator generator(seed);
+    generator.writeTransactionsCsv(syntheticTable, syntheticRows);
+    cout << "Generated a table of " << syntheticRows << " rows with seed "
+         << seed << endl;
+  } else
+    ifs.open(tablePath);
+  istream& tableIn =
+      syntheticRows > 0 ? static_cast<istream&>(syntheticTable) : ifs;
   string opCol = "tx_sum";
   string compareCol = "client_id";
+
+  if (approxFraction > 0) {
+    HELAYERS_TIMER_PUSH("table encryption");
+    SampledTable sampled(
+        he, tableIn, chunkRows > 0 ? chunkRows : he.slotCount());
+    HELAYERS_TIMER_POP();
+    runApproximateQueries(sampled,
+                          opCol,
+                          compareCol,
+                          approxFraction,
+                          approxSeed,
+                          confidence,
+                          approxCheck);
+    HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("table encryption");
+    return 0;
+  }
+
   HELAYERS_TIMER_PUSH("table encryption");
-  Table t(he, ifs);
+  Table t(he, tableIn);
   HELAYERS_TIMER_POP();
 
   int compareValIsEq = 9;
@@ -186,14 +505,30 @@ int main()
   double stdDevIsGreater = stdDevQuery(
       t, opCol, compareCol, compareValIsGr, compareFieldIsGr, IS_GREATER);
 
-  always_assert(round(countIsEqual) == 9964);
-  always_assert(round(countIsGreater) == 490726);
-  always_assert(round(sumIsEqual) == 246748572);
-  always_assert(round(sumIsGreater) == 12276999495);
-  always_assert(fabs(avgIsEqual - 24764.007627458854) < 0.01);
-  always_assert(fabs(avgIsGreater - 25018.0334748923) < 0.01);
-  always_assert(fabs(stdDevIsEqual - 14360.362655088153) < 0.01);
-  always_assert(fabs(stdDevIsGreater - 14429.498357990333) < 0.01);
+  if (syntheticRows > 0) {
+    // The expected results of a generated table are computed in plain.
+    PlainQueryResults isEqual = computePlainQuery(
+        syntheticTable.str(), compareValIsEq, IS_EQUAL);
+    PlainQueryResults isGreater = computePlainQuery(
+        syntheticTable.str(), compareValIsGr, IS_GREATER);
+    always_assert(round(countIsEqual) == isEqual.count);
+    always_assert(round(countIsGreater) == isGreater.count);
+    always_assert(round(sumIsEqual) == isEqual.sum);
+    always_assert(round(sumIsGreater) == isGreater.sum);
+    always_assert(isEqual.count == 0 ||
+                  fabs(avgIsEqual - isEqual.getAverage()) < 0.01);
+    always_assert(isGreater.count == 0 ||
+                  fabs(avgIsGreater - isGreater.getAverage()) < 0.01);
+  } else {
+    always_assert(round(countIsEqual) == 9964);
+    always_assert(round(countIsGreater) == 490726);
+    always_assert(round(sumIsEqual) == 246748572);
+    always_assert(round(sumIsGreater) == 12276999495);
+    always_assert(fabs(avgIsEqual - 24764.007627458854) < 0.01);
+    always_assert(fabs(avgIsGreater - 25018.0334748923) < 0.01);
+    always_assert(fabs(stdDevIsEqual - 14360.362655088153) < 0.01);
+    always_assert(fabs(stdDevIsGreater - 14429.498357990333) < 0.01);
+  }
 
   HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("table encryption");
   HELAYERS_TIMER_PRINT_MEASURE_SUMMARY("count query IS_EQUAL");
@@ -28,6 +28,9 @@
 #include "helayers/math/TTFunctionEvaluator.h"
 #include "helayers/hebase/openfhe/OpenFheCkksContext.h"
 #include "helayers/hebase/mockup/MockupContext.h"
+#include "CiphertextOps.h"
+#include "LookupTable.h"
+#include "TraceRecorder.h"
 
 using namespace std;
 using namespace chrono;
@@ -39,10 +42,24 @@ int iterations = 1;
 bool verbose = false;
 bool mockup = false;
 bool useLagrange = false;
+string traceFile;
+bool compareEquality = false;
 
 DoubleTensor* plainBoard;
 
 shared_ptr<CTileTensor> tensorBoard; // true board
+// The next board is computed into this tensor, which then trades places with
+// tensorBoard. Swapping the pointers moves no data, while swapping the tile
+// tensors themselves would copy them.
+shared_ptr<CTileTensor> nextBoard;
+// With --lagrange, the neighbour counts are checked with these tables, whose
+// Lagrange coefficients over {0..8} are computed once for all steps.
+const LookupTable isThreeTable({0, 0, 0, 1, 0, 0, 0, 0, 0},
+                               0,
+                               LutMethod::LAGRANGE);
+const LookupTable isTwoTable({0, 0, 1, 0, 0, 0, 0, 0, 0},
+                             0,
+                             LutMethod::LAGRANGE);
 TTShape inputShape;
 
 void printBoard(const string& name, const DoubleTensor& board);
@@ -50,19 +67,16 @@ void printEncryptedBoard(CTileTensor& board);
 
 void cleanTensor(CTileTensor& x) // cleaning the tensor (inplace)
 {
-  CTileTensor square = x.getSquare();
-  CTileTensor cube = square;
-  cube.multiply(x);
-
   // computation of 3x^2-2x^3 which is a rough-but-good-enough approximation of
-  // the sign fucntion
-  x = square;
-  x.add(square);
-  x.add(square);
-  x.sub(cube);
-  x.sub(cube);
-
-  return;
+  // the sign fucntion. It is computed as x^2 * (3-2x), which needs a single
+  // temporary tensor and the same multiplicative depth.
+  CTileTensor factor(x.getHeContext());
+  copyInto(factor, x);
+  factor.multiplyScalar(-2.0);
+  factor.addScalar(3.0);
+
+  x.square();
+  x.multiply(factor);
 }
 
 // Each slot of x becomes 1 if it equals to a, to 0 otherwise
@@ -91,6 +105,33 @@ void checkEqualTensorInPlace(CTileTensor& x, int a, helayers::HeContext& he)
   x.addScalar(+1);
 }
 
+// Times the checks of neighbours for 2 and 3 with computeLagrangeBasis(),
+// which builds the basis of every value from scratch, and with the lookup
+// tables, which share the powers of the neighbour count between both values.
+void compareEqualityChecks(const CTileTensor& neighbours, HeContext& he)
+{
+  auto start = high_resolution_clock::now();
+  for (int a : {2, 3}) {
+    CTileTensor x(neighbours);
+    checkEqualTensorInPlace(x, a, he);
+  }
+  double basisSeconds =
+      duration<double>(high_resolution_clock::now() - start).count();
+
+  start = high_resolution_clock::now();
+  LutInput<CTileTensor> input(neighbours, 8);
+  CTileTensor x(he);
+  for (const LookupTable* table : {&isTwoTable, &isThreeTable})
+    table->evaluate(x, input);
+  double tableSeconds =
+      duration<double>(high_resolution_clock::now() - start).count();
+
+  cout << "  - Equality check per call: " << basisSeconds / 2 * 1000
+       << " ms with computeLagrangeBasis, " << tableSeconds / 2 * 1000
+       << " ms with the lookup tables, saving "
+       << (basisSeconds - tableSeconds) / 2 * 1000 << " ms" << endl;
+}
+
 // Initialize the encrypted board (tensorBoard) and the plaintext board
 // (plainBoard).
 //
@@ -117,6 +158,7 @@ void initBoard(TTEncoder& enc, HeContext& he, DoubleTensor& startingPos)
 
   tensorBoard = make_shared<CTileTensor>(he);
   enc.encodeEncrypt(*tensorBoard, inputShape, startingPos);
+  nextBoard = make_shared<CTileTensor>(he);
 }
 
 // compute plain step (for comparison)
@@ -143,12 +185,13 @@ static inline double computePlainStep(int x, int y)
 // compute one step in the tensor board
 static void tensorStep(HeContext& he)
 {
-  HELAYERS_TIMER_SECTION("iteration");
+  HELAYERS_TRACE_TIMER_SECTION("iteration");
 
   const int strideRows = 1;
   const int strideCols = 1;
 
   cout << "  - Compute plain step" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("plain-step");
   DoubleTensor newPlainBoard({M, N});
   for (int x = 0; x < M; x++) {
     for (int y = 0; y < N; y++) {
@@ -156,6 +199,9 @@ static void tensorStep(HeContext& he)
     }
   }
   *plainBoard = newPlainBoard;
+  HELAYERS_TRACE_TIMER_POP();
+
+  HELAYERS_TRACE_TIMER_PUSH("count-neighbours");
 
   TTConvConfig cc(he, tensorBoard->getShape(), 3, 3, 0, false);
 
@@ -168,36 +214,54 @@ static void tensorStep(HeContext& he)
   cc.setPadding(padding);
 
   // will store the number of neighbours each cell has
-  CTileTensor neighbours(he);
   TTConvFilters cf(cc);
   TTConvolutionInterleaved sumPoolEngine(tensorBoard, cf);
-  neighbours = sumPoolEngine.getConvolution(); // get the number of neighbours
-                                               // with the convolution
+  // get the number of neighbours with the convolution
+  CTileTensor neighbours = sumPoolEngine.getConvolution();
 
   neighbours.sub(*tensorBoard); // sum pooling returns the sum of the
                                 // neighbours with the cell, and we don't want
                                 // the cell status to be included in the sum
+  HELAYERS_TRACE_TIMER_POP();
 
   cout << "  - Check for 2/3 neighbours" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("check-neighbours");
   // if a cell has 3 neighbours, then the corresponding tile in threeCheck will
-  // have a value of 1
-  CTileTensor threeCheck(neighbours);
+  // have a value of 1. This is the next board.
+  CTileTensor& threeCheck = *nextBoard;
   // if a cell has 2 neighbours, then the corresponding tile in twoCheck will
-  // have a value of 1
-  CTileTensor twoCheck(neighbours);
+  // have a value of 1. The neighbour count is not needed anymore, so this
+  // check is computed in place.
+  CTileTensor& twoCheck = neighbours;
 
-  checkEqualTensorInPlace(threeCheck, 3, he);
-  checkEqualTensorInPlace(twoCheck, 2, he);
+  if (useLagrange) {
+    if (compareEquality)
+      compareEqualityChecks(neighbours, he);
+    // Both checks are polynomials of the same neighbour count, so its powers
+    // are computed once, by the first table, for both.
+    LutInput<CTileTensor> input(neighbours, 8);
+    isThreeTable.evaluate(threeCheck, input);
+    isTwoTable.evaluate(twoCheck, input);
+  } else {
+    copyInto(threeCheck, neighbours);
+    checkEqualTensorInPlace(threeCheck, 3, he);
+    checkEqualTensorInPlace(twoCheck, 2, he);
+  }
 
   twoCheck.multiply(*tensorBoard);
   threeCheck.add(twoCheck);
   // the new state of a cell is (N==3) or ((N==2) and oldState==1) where N is
   // the number of alive neighbours, and oldState is the previous state
+  HELAYERS_TRACE_TIMER_POP();
 
   cout << "  - Cleanup" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("cleanup");
   cleanTensor(threeCheck);
+  HELAYERS_TRACE_TIMER_POP();
 
-  *tensorBoard = threeCheck;
+  // The new board takes the place of the old one, whose tensor will hold the
+  // board after it.
+  swap(tensorBoard, nextBoard);
 }
 
 void printBoard(const string& name, const DoubleTensor& board)
@@ -291,6 +355,7 @@ void benchmarkGameOfLife()
     auto start = high_resolution_clock::now();
 
     if ((i != 0) && (useLagrange)) {
+      HELAYERS_TRACE_TIMER_SECTION("bootstrap");
       tensorBoard->bootstrap(); // the best bootsrapping point is here, where
       // there is only one CTileTensor
     }
@@ -305,6 +370,9 @@ void benchmarkGameOfLife()
     // HELAYERS_TIMER_PRINT_MEASURES_SUMMARY();
     // cout << "Exiting after one iteration" << endl;
   }
+  CiphertextCopyCounter::getInstance().printStats(
+      cout, "Steps", iterations, "step");
+  nextBoard.reset();
 }
 
 int main(int argc, char* argv[])
@@ -322,6 +390,10 @@ int main(int argc, char* argv[])
       verbose = true;
     else if (arg == "--mockup")
       mockup = true;
+    else if (arg == "--trace" && i < argc)
+      traceFile = argv[i++];
+    else if (arg == "--compare_equality")
+      compareEquality = useLagrange = true;
     else {
       cerr << "Usage:" << endl;
       cerr << "     --iterations ITER" << endl;
@@ -329,10 +401,18 @@ int main(int argc, char* argv[])
       cerr << "     --mockup" << endl;
       cerr << "     --lagrange" << endl;
       cerr << "     --size N" << endl;
+      cerr << "     --trace FILE" << endl;
+      cerr << "     --compare_equality" << endl;
       throw runtime_error(string("Unknown argument ") + arg);
     }
   }
   plainBoard = new DoubleTensor({M, N});
+  TraceRecorder::getInstance().setEnabled(!traceFile.empty());
 
   benchmarkGameOfLife();
+
+  if (!traceFile.empty()) {
+    TraceRecorder::getInstance().writeChromeTrace(traceFile);
+    cout << "Trace written to " << traceFile << endl;
+  }
 }
\ No newline at end of file
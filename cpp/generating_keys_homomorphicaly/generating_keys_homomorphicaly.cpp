@@ -0,0 +1,180 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "ReEncryptionEngine.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Re-keying options
+int numCiphertexts = 1000;
+int hops = 1;
+uint64_t seed = 17;
+
+// Context options
+uint64_t plaintextModulus = 65537;
+int depth = 2;
+uint32_t ringDimension = 0;
+
+void help()
+{
+  cout << "Usage: ./generating_keys_homomorphicaly [ additional optional "
+          "parameters ]"
+       << endl;
+  cout << endl;
+  cout << "Re-keying options:" << endl;
+  cout << "--ciphertexts n\t\tnumber of ciphertexts to re-key (default: 1000)."
+       << endl;
+  cout << "--hops n\t\tnumber of consecutive key rotations (default: 1)."
+       << endl;
+  cout << "--seed n\t\tseed of the encrypted values (default: 17)." << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--plaintext_modulus n\tBGV plaintext modulus (default: 65537)."
+       << endl;
+  cout << "--depth n\t\tdepth left for computations (default: 2)." << endl;
+  cout << "--ring_dim n\t\tring dimension (default: chosen for 128-bit "
+          "security)."
+       << endl;
+  exit(1);
+}
+
+double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--ciphertexts" && i < argc)
+      numCiphertexts = stoi(argv[i++]);
+    else if (arg == "--hops" && i < argc)
+      hops = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--plaintext_modulus" && i < argc)
+      plaintextModulus = stoull(argv[i++]);
+    else if (arg == "--depth" && i < argc)
+      depth = stoi(argv[i++]);
+    else if (arg == "--ring_dim" && i < argc)
+      ringDimension = stoul(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+  always_assert_msg(numCiphertexts > 0 && hops > 0,
+                    "at least one ciphertext and one hop are required");
+
+  ReEncryptionEngine engine(plaintextModulus, depth, ringDimension);
+  int slots = engine.getSlotCount();
+  cout << "Ring dimension: " << slots << ", plaintext modulus: "
+       << plaintextModulus << endl;
+
+  // === Data owner side ===
+  // The owner of the current key encrypts the data and uploads it.
+  cout << "Encrypting " << numCiphertexts << " ciphertexts . . ." << endl;
+  ReEncryptionEngine::KeyPair keys = engine.generateKeys();
+  // Packed values are decoded into (-p/2, p/2], so the sum computed below
+  // must stay under p/2.
+  mt19937_64 rng(seed);
+  uniform_int_distribution<int64_t> value(0, plaintextModulus / 4 - 1);
+  vector<vector<int64_t>> data(numCiphertexts, vector<int64_t>(slots));
+  vector<ReEncryptionEngine::Ciphertext> ctxts(numCiphertexts);
+  for (int c = 0; c < numCiphertexts; ++c) {
+    for (int64_t& v : data[c])
+      v = value(rng);
+    ctxts[c] = engine.encrypt(keys.publicKey, data[c]);
+  }
+  double megabytes =
+      ReEncryptionEngine::serialize(ctxts[0]).size() / 1e6 * numCiphertexts;
+  cout << "Stored data: " << fixed << setprecision(1) << megabytes << " MB"
+       << endl;
+
+  double reKeySeconds = 0;
+  double reEncryptSeconds = 0;
+  for (int hop = 0; hop < hops; ++hop) {
+    // === Next key owner side ===
+    // Fresh keys for the next key period. Only the public key is shared.
+    ReEncryptionEngine::KeyPair newKeys = engine.generateKeys();
+
+    // === Data owner side ===
+    auto start = chrono::high_resolution_clock::now();
+    ReEncryptionEngine::ReKey reKey =
+        engine.generateReKey(keys.secretKey, newKeys.publicKey);
+    reKeySeconds += secondsSince(start);
+
+    // === Server side ===
+    // The server re-keys the stored ciphertexts without any round trip.
+    start = chrono::high_resolution_clock::now();
+    engine.reEncryptAll(ctxts, reKey);
+    double seconds = secondsSince(start);
+    reEncryptSeconds += seconds;
+    cout << "Hop " << hop + 1 << ": re-keyed in " << setprecision(3) << seconds
+         << " s" << endl;
+
+    // The old key is retired.
+    keys = newKeys;
+  }
+
+  // === Server side ===
+  // The re-keyed ciphertexts are still good for computations.
+  ReEncryptionEngine::Ciphertext sum =
+      engine.getContext()->EvalAdd(ctxts[0], ctxts[numCiphertexts - 1]);
+
+  // === New key owner side ===
+  int errors = 0;
+  for (int c = 0; c < numCiphertexts; ++c)
+    errors += engine.decrypt(keys.secretKey, ctxts[c], slots) != data[c];
+  vector<int64_t> decryptedSum = engine.decrypt(keys.secretKey, sum, slots);
+  for (int s = 0; s < slots; ++s)
+    errors += decryptedSum[s] != data[0][s] + data[numCiphertexts - 1][s];
+
+  cout << endl;
+  cout << "Errors: " << errors << endl;
+  cout << "Re-encryption key generation time (s): " << reKeySeconds / hops
+       << endl;
+  cout << "Re-encryption time (s): " << reEncryptSeconds / hops << endl;
+  cout << "Ciphertexts per second: " << setprecision(0)
+       << numCiphertexts * hops / reEncryptSeconds << endl;
+  cout << "MB per second: " << setprecision(1)
+       << megabytes * hops / reEncryptSeconds << endl;
+  cout << "RAM (MB): " << MemoryUtils::getUsedRam() << endl;
+  always_assert_msg(errors == 0, "re-keyed data differs from the original");
+  return 0;
+}
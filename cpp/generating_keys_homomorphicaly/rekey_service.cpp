@@ -0,0 +1,255 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "key/key-ser.h"
+#include "CiphertextContainer.h"
+#include "ReEncryptionEngine.h"
+#include "ReKeyPipeline.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+const string outDir = getExamplesOutputDir() + "/rekey_service";
+
+// Storage options
+int numFiles = 4;
+int perFile = 256;
+size_t batchSize = 64;
+uint64_t seed = 17;
+
+// Context options
+uint64_t plaintextModulus = 65537;
+int depth = 2;
+uint32_t ringDimension = 0;
+
+void help()
+{
+  cout << "Usage: ./rekey_service [ additional optional parameters ]" << endl;
+  cout << endl;
+  cout << "Storage options:" << endl;
+  cout << "--files n\t\tnumber of bulk container files (default: 4)." << endl;
+  cout << "--per_file n\t\tciphertexts per bulk file (default: 256)." << endl;
+  cout << "--batch n\t\tciphertexts in memory per file (default: 64)."
+       << endl;
+  cout << "--seed n\t\tseed of the encrypted values (default: 17)." << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--plaintext_modulus n\tBGV plaintext modulus (default: 65537)."
+       << endl;
+  cout << "--depth n\t\tdepth left for computations (default: 2)." << endl;
+  cout << "--ring_dim n\t\tring dimension (default: chosen for 128-bit "
+          "security)."
+       << endl;
+  exit(1);
+}
+
+// The values of entry e of bulk file f, regenerated for the check.
+vector<int64_t> bulkValues(int f, int e, int slots)
+{
+  mt19937_64 rng(seed + f * 1000003ULL + e);
+  uniform_int_distribution<int64_t> value(0, plaintextModulus / 2 - 1);
+  vector<int64_t> res(slots);
+  for (int64_t& v : res)
+    v = value(rng);
+  return res;
+}
+
+vector<int64_t> stringToAscii(const string& val)
+{
+  return vector<int64_t>(val.begin(), val.end());
+}
+
+string asciiToString(const vector<int64_t>& vals)
+{
+  string res;
+  for (int64_t v : vals)
+    if (v != 0)
+      res += (char)v;
+  return res;
+}
+
+vector<pair<string, string>> readCountries(int slots)
+{
+  ifstream in = FileUtils::openIfstream(
+      getDataSetsDir() + "/countries/countries.csv", ios_base::in,
+      ifstream::badbit);
+  vector<pair<string, string>> db;
+  string line;
+  while (getline(in, line)) {
+    stringstream ss(line);
+    string country, capital;
+    getline(ss, country, ',');
+    getline(ss, capital, ',');
+    if (country.size() <= slots && capital.size() <= slots)
+      db.emplace_back(country, capital);
+  }
+  return db;
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--files" && i < argc)
+      numFiles = stoi(argv[i++]);
+    else if (arg == "--per_file" && i < argc)
+      perFile = stoi(argv[i++]);
+    else if (arg == "--batch" && i < argc)
+      batchSize = stoul(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--plaintext_modulus" && i < argc)
+      plaintextModulus = stoull(argv[i++]);
+    else if (arg == "--depth" && i < argc)
+      depth = stoi(argv[i++]);
+    else if (arg == "--ring_dim" && i < argc)
+      ringDimension = stoul(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+  always_assert_msg(numFiles >= 0 && perFile > 0,
+                    "the bulk files must hold at least one ciphertext");
+
+  ReEncryptionEngine engine(plaintextModulus, depth, ringDimension);
+  int slots = engine.getSlotCount();
+  cout << "Ring dimension: " << slots << ", plaintext modulus: "
+       << plaintextModulus << endl;
+  FileUtils::createCleanDir(outDir);
+
+  // === Data owner side ===
+  // The stored artefacts: the country database as (country, capital) pairs
+  // of ciphertexts, and bulk files of random data.
+  cout << "Storing encrypted files . . ." << endl;
+  ReEncryptionEngine::KeyPair oldKeys = engine.generateKeys();
+  vector<pair<string, string>> countries = readCountries(slots);
+  always_assert_msg(!countries.empty(), "no countries to store");
+  vector<string> fileNames = {outDir + "/countries.ctc"};
+  CiphertextContainer::create(fileNames[0]);
+  {
+    CiphertextContainer container(fileNames[0]);
+    vector<string> blobs;
+    for (const auto& entry : countries) {
+      blobs.push_back(ReEncryptionEngine::serialize(
+          engine.encrypt(oldKeys.publicKey, stringToAscii(entry.first))));
+      blobs.push_back(ReEncryptionEngine::serialize(
+          engine.encrypt(oldKeys.publicKey, stringToAscii(entry.second))));
+    }
+    container.appendBlobs(blobs);
+  }
+  for (int f = 0; f < numFiles; ++f) {
+    fileNames.push_back(outDir + "/bulk_" + to_string(f) + ".ctc");
+    CiphertextContainer::create(fileNames.back());
+    CiphertextContainer container(fileNames.back());
+    vector<string> blobs(perFile);
+#pragma omp parallel for
+    for (int e = 0; e < perFile; ++e)
+      blobs[e] = ReEncryptionEngine::serialize(
+          engine.encrypt(oldKeys.publicKey, bulkValues(f, e, slots)));
+    container.appendBlobs(blobs);
+  }
+
+  // === New key owner side ===
+  // Fresh keys for the next key period. Only the public key is shared.
+  ReEncryptionEngine::KeyPair newKeys = engine.generateKeys();
+
+  // === Data owner side ===
+  // The re-encryption key is handed to the service as a file.
+  string reKeyFile = outDir + "/rekey";
+  lbcrypto::Serial::SerializeToFile(
+      reKeyFile,
+      engine.generateReKey(oldKeys.secretKey, newKeys.publicKey),
+      lbcrypto::SerType::BINARY);
+
+  // === Service side ===
+  cout << "Re-keying " << fileNames.size() << " files . . ." << endl;
+  ReEncryptionEngine::ReKey reKey;
+  bool loaded = lbcrypto::Serial::DeserializeFromFile(
+      reKeyFile, reKey, lbcrypto::SerType::BINARY);
+  always_assert_msg(loaded, "failed to read the re-encryption key");
+  ReKeyPipeline pipeline(engine, reKey, batchSize);
+  ReKeyStats total;
+  cout << fixed;
+  for (const string& fileName : fileNames) {
+    ReKeyStats stats = pipeline.reKeyFile(fileName);
+    cout << fileName << ": " << stats.ciphertexts << " ciphertexts, "
+         << setprecision(3) << stats.bytesRead / 1e9 << " GB in "
+         << stats.seconds << " s" << endl;
+    total += stats;
+  }
+
+  // === New key owner side ===
+  // Checks the last country and the first and last entries of every bulk
+  // file under the new key.
+  int errors = 0;
+  {
+    CiphertextContainer reader(fileNames[0]);
+    size_t last = reader.size() - 2;
+    string country = asciiToString(engine.decrypt(
+        newKeys.secretKey,
+        ReEncryptionEngine::deserialize(reader.readBlob(last)),
+        slots));
+    string capital = asciiToString(engine.decrypt(
+        newKeys.secretKey,
+        ReEncryptionEngine::deserialize(reader.readBlob(last + 1)),
+        slots));
+    cout << "Last entry: " << country << ", " << capital << endl;
+    errors += country != countries.back().first;
+    errors += capital != countries.back().second;
+  }
+  for (int f = 0; f < numFiles; ++f) {
+    CiphertextContainer reader(fileNames[f + 1]);
+    for (int e : {0, perFile - 1})
+      errors += engine.decrypt(newKeys.secretKey,
+                               ReEncryptionEngine::deserialize(
+                                   reader.readBlob(e)),
+                               slots) != bulkValues(f, e, slots);
+  }
+
+  cout << endl;
+  cout << "Errors: " << errors << endl;
+  cout << "Files: " << total.files << ", ciphertexts: " << total.ciphertexts
+       << endl;
+  cout << "Read (GB): " << setprecision(3) << total.bytesRead / 1e9
+       << ", written (GB): " << total.bytesWritten / 1e9 << endl;
+  cout << "Re-key time (s): " << total.seconds << endl;
+  cout << "GB per hour: " << setprecision(1) << total.getGbPerHour() << endl;
+  cout << "RAM (MB): " << MemoryUtils::getUsedRam() << endl;
+  FileUtils::removeDir(outDir);
+  always_assert_msg(errors == 0, "re-keyed data differs from the original");
+  return 0;
+}
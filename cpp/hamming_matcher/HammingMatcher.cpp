@@ -0,0 +1,226 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "HammingMatcher.h"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "helayers/math/FunctionEvaluator.h"
+
+using namespace std;
+using namespace helayers;
+
+HammingMatcher::HammingMatcher(HeContext& he, int templateBits)
+    : he(he), templateBits(templateBits), templateSlots(1)
+{
+  while (templateSlots < templateBits)
+    templateSlots *= 2;
+  if (templateBits <= 0 || templateSlots > he.slotCount())
+    throw invalid_argument("HammingMatcher: templates of " +
+                           to_string(templateBits) + " bits do not fit in " +
+                           to_string(he.slotCount()) + " slots");
+}
+
+void HammingMatcher::setRotationSteps(HeConfigRequirement& req,
+                                      int templateBits)
+{
+  vector<int> steps;
+  for (int step = 1; step < templateBits; step *= 2)
+    steps.push_back(step);
+  req.publicFunctions.rotate(CUSTOM_ROTATIONS);
+  req.publicFunctions.rotationSteps(steps);
+}
+
+int HammingMatcher::getDepth(bool threshold, int gRep, int fRep)
+{
+  return threshold ? 3 * (gRep + fRep) + 3 : 2;
+}
+
+void HammingMatcher::enrollGallery(const vector<vector<uint8_t>>& templates)
+{
+  for (const auto& t : templates)
+    if (t.size() != templateBits)
+      throw invalid_argument("HammingMatcher: template of " +
+                             to_string(t.size()) + " bits instead of " +
+                             to_string(templateBits));
+
+  int templatesPerCiphertext = getTemplatesPerCiphertext();
+  int numCiphertexts =
+      (templates.size() + templatesPerCiphertext - 1) / templatesPerCiphertext;
+  numTemplates = templates.size();
+  gallery.assign(numCiphertexts, CTile(he));
+
+#pragma omp parallel for
+  for (int c = 0; c < numCiphertexts; ++c) {
+    Encoder enc(he);
+    int first = c * templatesPerCiphertext;
+    int last = min<int>(first + templatesPerCiphertext, templates.size());
+    vector<double> vals(he.slotCount(), 0);
+    for (int i = first; i < last; ++i)
+      for (int bit = 0; bit < templateBits; ++bit)
+        vals[(i - first) * templateSlots + bit] = templates[i][bit];
+    enc.encodeEncrypt(gallery[c], vals);
+  }
+}
+
+CTile HammingMatcher::encryptProbe(const vector<uint8_t>& probe) const
+{
+  if (probe.size() != templateBits)
+    throw invalid_argument("HammingMatcher: probe of " +
+                           to_string(probe.size()) + " bits instead of " +
+                           to_string(templateBits));
+
+  Encoder enc(he);
+  vector<double> vals(he.slotCount(), 0);
+  for (int s = 0; s < he.slotCount(); ++s)
+    if (s % templateSlots < templateBits)
+      vals[s] = probe[s % templateSlots];
+  CTile res(he);
+  enc.encodeEncrypt(res, vals);
+  return res;
+}
+
+void HammingMatcher::rotateBy(CTile& ctile, int steps) const
+{
+  // Only rotations by powers of 2 have keys.
+  for (int step = 1; step <= steps; step *= 2)
+    if (steps & step)
+      ctile.rotate(step);
+}
+
+void HammingMatcher::compact(CTile& res,
+                             const CTile& probe,
+                             int first,
+                             int last) const
+{
+  Encoder enc(he);
+  PTile mask(he);
+  CTile diff(he);
+  for (int c = first; c < last; ++c) {
+    CTile& dest = c == first ? res : diff;
+    dest = gallery[c];
+    dest.sub(probe);
+    dest.square();
+    if (templateSlots > 1)
+      dest.innerSum(1, templateSlots);
+    if (c == first) {
+      vector<double> vals(he.slotCount(), 0);
+      for (int s = 0; s < he.slotCount(); s += templateSlots)
+        vals[s] = 1;
+      enc.encode(mask, vals, dest.getChainIndex());
+    }
+    dest.multiplyPlain(mask);
+    // The distances of earlier ciphertexts move one slot further per
+    // ciphertext, so each ends up in its own slot.
+    if (c > first) {
+      res.rotate(1);
+      res.add(diff);
+    }
+  }
+}
+
+vector<CTile> HammingMatcher::computeDistances(const CTile& probe) const
+{
+  if (gallery.empty())
+    throw logic_error("HammingMatcher: the gallery is not enrolled");
+  int numResults = getNumResultCiphertexts();
+  int numGallery = gallery.size();
+
+  // A result ciphertext compacts up to templateSlots gallery ciphertexts.
+  // These are split into segments compacted in parallel, so that all
+  // threads have work even when there are few result ciphertexts.
+  int threads = omp_get_max_threads();
+  int segments = min(templateSlots, (threads + numResults - 1) / numResults);
+  int segmentLength = (templateSlots + segments - 1) / segments;
+
+  vector<CTile> parts(numResults * segments, CTile(he));
+#pragma omp parallel for schedule(dynamic)
+  for (int p = 0; p < numResults * segments; ++p) {
+    int r = p / segments;
+    int end = min(numGallery, (r + 1) * templateSlots);
+    int first = r * templateSlots + (p % segments) * segmentLength;
+    int last = min(end, first + segmentLength);
+    if (first >= last)
+      continue;
+    compact(parts[p], probe, first, last);
+    // Shift as if the ciphertexts up to end were compacted here as well.
+    rotateBy(parts[p], end - last);
+  }
+
+  vector<CTile> res(numResults, CTile(he));
+#pragma omp parallel for
+  for (int r = 0; r < numResults; ++r) {
+    res[r] = parts[r * segments];
+    for (int s = 1; s < segments; ++s)
+      if (r * templateSlots + s * segmentLength < numGallery)
+        res[r].add(parts[r * segments + s]);
+  }
+  return res;
+}
+
+vector<CTile> HammingMatcher::match(const CTile& probe,
+                                   int threshold,
+                                   int gRep,
+                                   int fRep) const
+{
+  vector<CTile> res = computeDistances(probe);
+
+#pragma omp parallel for
+  for (size_t r = 0; r < res.size(); ++r) {
+    // The extra 0.5 keeps the input of the sign function away from 0,
+    // where it returns 0.5.
+    res[r].negate();
+    res[r].addScalar(threshold + 0.5);
+    FunctionEvaluator fe(he);
+    fe.signInPlace(res[r], gRep, fRep, templateBits, true);
+  }
+  return res;
+}
+
+vector<double> HammingMatcher::decrypt(const vector<CTile>& res) const
+{
+  Encoder enc(he);
+  int slots = he.slotCount();
+  int templatesPerCiphertext = getTemplatesPerCiphertext();
+  vector<double> out(numTemplates);
+  for (size_t r = 0; r < res.size(); ++r) {
+    vector<double> vals = enc.decryptDecodeDouble(res[r]);
+    int first = r * templateSlots;
+    int end = min<int>(gallery.size(), first + templateSlots);
+    for (int c = first; c < end; ++c)
+      for (int v = 0; v < templatesPerCiphertext; ++v) {
+        int index = c * templatesPerCiphertext + v;
+        if (index >= numTemplates)
+          break;
+        int slot = (v * templateSlots - (end - 1 - c)) % slots;
+        out[index] = vals[slot < 0 ? slot + slots : slot];
+      }
+  }
+  return out;
+}
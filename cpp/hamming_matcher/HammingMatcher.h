@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef HAMMING_MATCHER_H_
+#define HAMMING_MATCHER_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Matches an encrypted binary template against an encrypted gallery of
+// templates by Hamming distance.
+//
+// Layout: every template occupies templateSlots consecutive slots, the
+// template length rounded up to a power of 2, so a gallery ciphertext holds
+// slotCount/templateSlots templates. The probe is encrypted once, replicated
+// for all the templates of a ciphertext. For bits a and b, (a - b)^2 is
+// a XOR b, so a subtraction, a square and an innerSum() over templateSlots
+// slots give the distances to all the templates of a ciphertext at once.
+//
+// The distances of a ciphertext are only in its first slot of every
+// template. Before thresholding, the distances of templateSlots gallery
+// ciphertexts are compacted into a single ciphertext: each is masked to
+// these slots and shifted by one slot relative to the previous one. The
+// costly sign evaluation then runs once per templateSlots gallery
+// ciphertexts rather than once per gallery ciphertext.
+class HammingMatcher
+{
+  helayers::HeContext& he;
+  int templateBits;
+  int templateSlots;
+  int numTemplates = 0;
+
+  std::vector<helayers::CTile> gallery;
+
+  // Masks the distances of gallery ciphertexts [first, last) and compacts
+  // them into res.
+  void compact(helayers::CTile& res,
+               const helayers::CTile& probe,
+               int first,
+               int last) const;
+
+  void rotateBy(helayers::CTile& ctile, int steps) const;
+
+public:
+  // templateBits rounded up to a power of 2 must not exceed the slot count.
+  HammingMatcher(helayers::HeContext& he, int templateBits);
+
+  // Adds the rotation steps used by the matcher to req: the powers of 2
+  // below the template length rounded up to a power of 2. These serve both
+  // the inner sums and the compaction, so a template of 2048 bits needs 11
+  // rotation keys regardless of the slot count.
+  static void setRotationSteps(helayers::HeConfigRequirement& req,
+                               int templateBits);
+
+  // Returns the multiplication depth of match(): 2 for the distances, plus
+  // the depth of the sign function when thresholding.
+  static int getDepth(bool threshold, int gRep, int fRep);
+
+  int getTemplatesPerCiphertext() const
+  {
+    return he.slotCount() / templateSlots;
+  }
+  int getNumGalleryCiphertexts() const { return gallery.size(); }
+  int getNumResultCiphertexts() const
+  {
+    return (gallery.size() + templateSlots - 1) / templateSlots;
+  }
+  int getNumTemplates() const { return numTemplates; }
+
+  // Encrypts the gallery. Every template holds templateBits values of 0 or 1.
+  void enrollGallery(const std::vector<std::vector<uint8_t>>& templates);
+
+  // Encrypts a probe template, replicated for all the templates of a
+  // ciphertext.
+  helayers::CTile encryptProbe(const std::vector<uint8_t>& probe) const;
+
+  // Returns getNumResultCiphertexts() ciphertexts holding the Hamming
+  // distances between the probe and all gallery templates, to be read with
+  // decrypt(). The gallery ciphertexts are scanned in parallel.
+  std::vector<helayers::CTile> computeDistances(
+      const helayers::CTile& probe) const;
+
+  // Like computeDistances(), followed by an encrypted threshold decision:
+  // the result holds about 1 for templates within threshold of the probe,
+  // and about 0 for the others. gRep and fRep set the accuracy of the sign
+  // function, see FunctionEvaluator::signInPlace().
+  std::vector<helayers::CTile> match(const helayers::CTile& probe,
+                                     int threshold,
+                                     int gRep = 2,
+                                     int fRep = 1) const;
+
+  // Decrypts the output of computeDistances() or match() into one value per
+  // gallery template.
+  std::vector<double> decrypt(const std::vector<helayers::CTile>& res) const;
+};
+
+#endif
@@ -0,0 +1,221 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "HammingMatcher.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Matching options
+int gallerySize = 100000;
+int templateBits = 512;
+int threshold = 10;
+bool encryptedThreshold = false;
+int gRep = 2;
+int fRep = 1;
+uint64_t seed = 17;
+
+// Context options
+bool mockupContext = false;
+int numSlots = pow(2, 14);
+
+void help()
+{
+  cout << "Usage: ./hamming_matcher [ additional optional parameters ]"
+       << endl;
+  cout << endl;
+  cout << "Matching options:" << endl;
+  cout << "--gallery n\t\tnumber of gallery templates (default: 100000)."
+       << endl;
+  cout << "--bits n\t\ttemplate length in bits (default: 512)." << endl;
+  cout << "--threshold n\t\tlargest Hamming distance of a match (default: 10)."
+       << endl;
+  cout << "--encrypted_threshold\tdecides the matches under encryption."
+       << endl;
+  cout << "--f_rep n, --g_rep n\taccuracy of --encrypted_threshold." << endl;
+  cout << "--seed n\t\tseed of the generated templates (default: 17)."
+       << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--mockup\t\truns the example with a mockup context for simulation."
+       << endl;
+  cout << "--slots n\t\tsets the number of slots in the HE context." << endl;
+  exit(1);
+}
+
+shared_ptr<HeContext> initContext()
+{
+  // Distances up to templateBits need 1 + log2(templateBits) integer bits.
+  // The sign function needs a deeper circuit and a better precision.
+  int intBits = 1 + ceil(log2(templateBits));
+  HeConfigRequirement req(numSlots,
+                          HammingMatcher::getDepth(encryptedThreshold, gRep,
+                                                   fRep),
+                          encryptedThreshold ? 48 : 40,
+                          intBits);
+  // Only the rotations the matcher uses get keys.
+  HammingMatcher::setRotationSteps(req, templateBits);
+
+  shared_ptr<HeContext> he = make_shared<SealCkksContext>();
+  if (mockupContext) {
+    shared_ptr<MockupContext> mockup = make_shared<MockupContext>();
+    mockup->setEstimatedMeasures(he->getEstimatedMeasures());
+    he = mockup;
+    req.securityLevel = 0;
+  }
+  he->init(req);
+  return he;
+}
+
+double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+int hammingDistance(const vector<uint8_t>& a, const vector<uint8_t>& b)
+{
+  int res = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    res += a[i] != b[i];
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--gallery" && i < argc)
+      gallerySize = stoi(argv[i++]);
+    else if (arg == "--bits" && i < argc)
+      templateBits = stoi(argv[i++]);
+    else if (arg == "--threshold" && i < argc)
+      threshold = stoi(argv[i++]);
+    else if (arg == "--encrypted_threshold")
+      encryptedThreshold = true;
+    else if (arg == "--g_rep" && i < argc)
+      gRep = stoi(argv[i++]);
+    else if (arg == "--f_rep" && i < argc)
+      fRep = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--mockup")
+      mockupContext = true;
+    else if (arg == "--slots" && i < argc)
+      numSlots = stoi(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+  always_assert_msg(threshold + 3 < templateBits && gallerySize > 0,
+                    "the threshold must be below the template length");
+
+  shared_ptr<HeContext> he = initContext();
+  he->printSignature(cout);
+
+  // Random templates. The probe is a noisy copy of template 0, and a few
+  // templates are planted around the threshold to check the decision where
+  // it is hardest.
+  cout << "Generating " << gallerySize << " templates of " << templateBits
+       << " bits . . ." << endl;
+  mt19937_64 rng(seed);
+  bernoulli_distribution bit(0.5);
+  vector<vector<uint8_t>> gallery(gallerySize, vector<uint8_t>(templateBits));
+  for (auto& t : gallery)
+    for (uint8_t& b : t)
+      b = bit(rng);
+  vector<uint8_t> probe = gallery[0];
+  for (int b = 0; b < threshold / 2; ++b)
+    probe[b] ^= 1;
+  for (int d = -1; d <= 2; ++d) {
+    int index = (d + 2) * gallerySize / 5;
+    if (index == 0)
+      continue;
+    gallery[index] = probe;
+    for (int b = 0; b < threshold + d; ++b)
+      gallery[index][templateBits - 1 - b] ^= 1;
+  }
+
+  HammingMatcher matcher(*he, templateBits);
+  cout << "Enrolling the gallery . . ." << endl;
+  auto start = chrono::high_resolution_clock::now();
+  matcher.enrollGallery(gallery);
+  double enrollSeconds = secondsSince(start);
+  cout << "Gallery: " << matcher.getNumGalleryCiphertexts() << " ciphertexts, "
+       << matcher.getTemplatesPerCiphertext() << " templates each" << endl;
+
+  CTile encryptedProbe = matcher.encryptProbe(probe);
+
+  cout << "Matching . . ." << endl;
+  start = chrono::high_resolution_clock::now();
+  vector<CTile> res = encryptedThreshold
+                          ? matcher.match(encryptedProbe, threshold, gRep, fRep)
+                          : matcher.computeDistances(encryptedProbe);
+  double matchSeconds = secondsSince(start);
+
+  // Only the owner of the secret key can do this.
+  vector<double> decrypted = matcher.decrypt(res);
+  int matches = 0;
+  int errors = 0;
+  for (int t = 0; t < gallerySize; ++t) {
+    int distance = hammingDistance(gallery[t], probe);
+    if (encryptedThreshold) {
+      bool actual = decrypted[t] > 0.5;
+      matches += actual;
+      errors += actual != (distance <= threshold);
+    } else {
+      // Without --encrypted_threshold the decision is made after decryption.
+      matches += round(decrypted[t]) <= threshold;
+      errors += round(decrypted[t]) != distance;
+    }
+  }
+
+  cout << endl;
+  cout << "Result ciphertexts: " << res.size() << endl;
+  cout << "Matches: " << matches << ", errors: " << errors << endl;
+  cout << fixed << setprecision(3);
+  cout << "Enroll time (s): " << enrollSeconds << endl;
+  cout << "Match time (s): " << matchSeconds << endl;
+  cout << "Matches per second: " << setprecision(0)
+       << gallerySize / matchSeconds << endl;
+  cout << "RAM (MB): " << MemoryUtils::getUsedRam() << endl;
+  always_assert_msg(mockupContext || errors == 0,
+                    "encrypted results differ from the plain ones");
+  return 0;
+}
@@ -0,0 +1,255 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "KnnSearch.h"
+
+#include <stdexcept>
+
+#include "helayers/math/FunctionEvaluator.h"
+
+using namespace std;
+using namespace helayers;
+
+static bool isPowerOf2(int x) { return x > 0 && (x & (x - 1)) == 0; }
+
+KnnSearch::KnnSearch(HeContext& he, int dim, int groupSize)
+    : he(he), dim(dim), groupSize(groupSize)
+{
+  if (!isPowerOf2(dim) || !isPowerOf2(groupSize) || groupSize > dim ||
+      groupSize > he.slotCount())
+    throw invalid_argument("KnnSearch: dim and groupSize must be powers of 2, "
+                           "with groupSize dividing dim and the slot count");
+}
+
+void KnnSearch::setRotationSteps(HeConfigRequirement& req,
+                                 int groupSize,
+                                 bool topK)
+{
+  vector<int> steps;
+  for (int step = 1; step < groupSize; step *= 2)
+    steps.push_back(step);
+  if (topK)
+    for (int step = groupSize; step < req.numSlots; step *= 2)
+      steps.push_back(step);
+  req.publicFunctions.rotate(CUSTOM_ROTATIONS);
+  req.publicFunctions.rotationSteps(steps);
+}
+
+void KnnSearch::encryptDatabase(const vector<vector<double>>& vectors)
+{
+  for (const auto& vec : vectors)
+    if (vec.size() > dim)
+      throw invalid_argument("KnnSearch: vector longer than " +
+                             to_string(dim));
+
+  int vectorsPerCiphertext = getVectorsPerCiphertext();
+  int numBlocks =
+      (vectors.size() + vectorsPerCiphertext - 1) / vectorsPerCiphertext;
+  numVectors = vectors.size();
+  database.clear();
+  database.resize(numBlocks);
+
+#pragma omp parallel for
+  for (int b = 0; b < numBlocks; ++b) {
+    Encoder enc(he);
+    int first = b * vectorsPerCiphertext;
+    int last = min<int>(first + vectorsPerCiphertext, vectors.size());
+    for (int c = 0; c < getNumGroups(); ++c) {
+      vector<double> vals(he.slotCount(), 0);
+      for (int i = first; i < last; ++i)
+        for (int t = 0; t < groupSize; ++t) {
+          size_t coord = c * groupSize + t;
+          if (coord < vectors[i].size())
+            vals[(i - first) * groupSize + t] = vectors[i][coord];
+        }
+      CTile ctile(he);
+      enc.encodeEncrypt(ctile, vals);
+      database[b].push_back(std::move(ctile));
+    }
+  }
+}
+
+vector<CTile> KnnSearch::encryptQuery(const vector<double>& query) const
+{
+  if (query.size() > dim)
+    throw invalid_argument("KnnSearch: query longer than " + to_string(dim));
+
+  Encoder enc(he);
+  vector<CTile> res;
+  for (int c = 0; c < getNumGroups(); ++c) {
+    vector<double> vals(he.slotCount(), 0);
+    for (int s = 0; s < he.slotCount(); ++s) {
+      size_t coord = c * groupSize + s % groupSize;
+      if (coord < query.size())
+        vals[s] = query[coord];
+    }
+    CTile ctile(he);
+    enc.encodeEncrypt(ctile, vals);
+    res.push_back(std::move(ctile));
+  }
+  return res;
+}
+
+vector<CTile> KnnSearch::computeDistances(const vector<CTile>& query) const
+{
+  if (query.size() != getNumGroups())
+    throw invalid_argument("KnnSearch: query has " + to_string(query.size()) +
+                           " ciphertexts instead of " +
+                           to_string(getNumGroups()));
+
+  vector<CTile> res(database.size(), CTile(he));
+
+#pragma omp parallel for
+  for (size_t b = 0; b < database.size(); ++b) {
+    CTile& acc = res[b];
+    CTile diff(he);
+    for (int c = 0; c < getNumGroups(); ++c) {
+      CTile& dest = c == 0 ? acc : diff;
+      dest = database[b][c];
+      dest.sub(query[c]);
+      dest.square();
+      if (c > 0)
+        acc.add(diff);
+    }
+    // Sum the groupSize slots of every vector into its first slot.
+    if (groupSize > 1)
+      acc.innerSum(1, groupSize);
+  }
+  return res;
+}
+
+vector<double> KnnSearch::decryptDistances(const vector<CTile>& distances) const
+{
+  Encoder enc(he);
+  vector<double> res;
+  for (const CTile& ctile : distances) {
+    vector<double> vals = enc.decryptDecodeDouble(ctile);
+    for (int v = 0; v < getVectorsPerCiphertext() && res.size() < numVectors;
+         ++v)
+      res.push_back(vals[v * groupSize]);
+  }
+  return res;
+}
+
+void KnnSearch::minInPlace(CTile& a,
+                           const CTile& b,
+                           double range,
+                           int gRep,
+                           int fRep) const
+{
+  FunctionEvaluator fe(he);
+  // About 1 where a > b, 0 where a < b.
+  CTile aIsGreater = fe.compare(a, b, gRep, fRep, range);
+  CTile diff(b);
+  diff.sub(a);
+  diff.multiply(aIsGreater);
+  a.add(diff);
+}
+
+vector<CTile> KnnSearch::computeTopK(const vector<CTile>& distances,
+                                    int k,
+                                    double maxDistance,
+                                    int gRep,
+                                    int fRep) const
+{
+  // Selected vectors are moved out of the way by adding maxDistance, so
+  // values may grow up to twice maxDistance.
+  const double range = 2 * maxDistance;
+  const double tolerance = getTolerance(maxDistance);
+  int vectorsPerCiphertext = getVectorsPerCiphertext();
+
+  vector<CTile> d = distances;
+
+  // Slots of missing vectors in the last block start at maxDistance, so
+  // that they are never selected before a real vector.
+  int missing = database.size() * vectorsPerCiphertext - numVectors;
+  if (missing > 0) {
+    vector<double> pad(he.slotCount(), 0);
+    for (int v = vectorsPerCiphertext - missing; v < vectorsPerCiphertext; ++v)
+      pad[v * groupSize] = maxDistance;
+    Encoder enc(he);
+    CTile padding(he);
+    enc.encodeEncrypt(padding, pad);
+    d.back().add(padding);
+  }
+
+  vector<CTile> mask(d.size(), CTile(he));
+  for (int iter = 0; iter < k; ++iter) {
+    // The minimum over all blocks, by a pairwise tree reduction: every value
+    // goes through log2(getNumBlocks()) approximate minimums, whose errors
+    // add up, rather than up to getNumBlocks() - 1.
+    vector<CTile> level = d;
+    while (level.size() > 1) {
+      int pairs = level.size() / 2;
+#pragma omp parallel for
+      for (int i = 0; i < pairs; ++i)
+        minInPlace(level[2 * i], level[2 * i + 1], range, gRep, fRep);
+      for (int i = 1; i < pairs; ++i)
+        level[i] = std::move(level[2 * i]);
+      if (level.size() % 2 == 1)
+        level[pairs] = std::move(level.back());
+      level.erase(level.begin() + (level.size() + 1) / 2, level.end());
+    }
+    CTile minimum = std::move(level[0]);
+    // Then the minimum over the vectors of a block, also a tree. The
+    // rotations are multiples of groupSize, so the first slots of vectors
+    // are only compared with each other.
+    for (int shift = groupSize; shift < he.slotCount(); shift *= 2) {
+      CTile rotated(minimum);
+      rotated.rotate(shift);
+      minInPlace(minimum, rotated, range, gRep, fRep);
+    }
+    minimum.addScalar(tolerance);
+
+#pragma omp parallel for
+    for (size_t b = 0; b < d.size(); ++b) {
+      FunctionEvaluator fe(he);
+      // About 1 for the nearest remaining vector, 0 for all others.
+      CTile selected = fe.compare(minimum, d[b], gRep, fRep, range);
+      if (iter == 0)
+        mask[b] = selected;
+      else
+        mask[b].add(selected);
+      selected.multiplyScalar(maxDistance);
+      d[b].add(selected);
+    }
+  }
+  return mask;
+}
+
+vector<int> KnnSearch::decryptTopK(const vector<CTile>& mask) const
+{
+  Encoder enc(he);
+  vector<int> res;
+  for (size_t b = 0; b < mask.size(); ++b) {
+    vector<double> vals = enc.decryptDecodeDouble(mask[b]);
+    for (int v = 0; v < getVectorsPerCiphertext(); ++v) {
+      int index = b * getVectorsPerCiphertext() + v;
+      if (index < numVectors && vals[v * groupSize] > 0.5)
+        res.push_back(index);
+    }
+  }
+  return res;
+}
@@ -0,0 +1,126 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef KNN_SEARCH_H_
+#define KNN_SEARCH_H_
+
+#include <memory>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+
+// Nearest-neighbour search over an encrypted database of vectors.
+//
+// Layout: every vector occupies groupSize consecutive slots, so a ciphertext
+// holds slotCount/groupSize vectors, and a vector of dim coordinates is split
+// into dim/groupSize coordinate groups stored in separate ciphertexts. The
+// database is thus a grid of ciphertexts: one row per block of vectors, one
+// column per coordinate group. The query is encrypted the same way, with its
+// coordinate groups replicated for all vectors of a block.
+//
+// The squared distances of a block are computed in one SIMD pass: the
+// squared differences of all coordinate groups are added up first, and only
+// then the groupSize slots of each vector are summed by innerSum(). The
+// log2(groupSize) rotations are thus paid once per block rather than once
+// per coordinate group. groupSize trades rotations for query size:
+// groupSize == dim needs a single query ciphertext and log2(dim) rotations
+// per block, groupSize == 1 needs dim query ciphertexts and no rotations.
+class KnnSearch
+{
+  helayers::HeContext& he;
+  int dim;
+  int groupSize;
+  int numVectors = 0;
+
+  // database[block][group]
+  std::vector<std::vector<helayers::CTile>> database;
+
+  void minInPlace(helayers::CTile& a,
+                  const helayers::CTile& b,
+                  double range,
+                  int gRep,
+                  int fRep) const;
+
+public:
+  // dim and groupSize must be powers of 2, with groupSize dividing dim and
+  // the slot count.
+  KnnSearch(helayers::HeContext& he, int dim, int groupSize);
+
+  // Adds the rotation steps used by the search to req: the powers of 2
+  // below groupSize for the inner sums, and when topK is set, the multiples
+  // of groupSize used to find the minimum of a ciphertext.
+  static void setRotationSteps(helayers::HeConfigRequirement& req,
+                               int groupSize,
+                               bool topK);
+
+  int getVectorsPerCiphertext() const { return he.slotCount() / groupSize; }
+  int getNumGroups() const { return dim / groupSize; }
+  int getNumBlocks() const { return database.size(); }
+  int getNumVectors() const { return numVectors; }
+
+  // Encrypts the database. Vectors shorter than dim are padded with zeros.
+  void encryptDatabase(const std::vector<std::vector<double>>& vectors);
+
+  // Encrypts a query vector into getNumGroups() ciphertexts.
+  std::vector<helayers::CTile> encryptQuery(
+      const std::vector<double>& query) const;
+
+  // Returns one ciphertext per block. The squared distance between the query
+  // and vector i is in slot (i % getVectorsPerCiphertext()) * groupSize of
+  // ciphertext i / getVectorsPerCiphertext(). The other slots hold partial
+  // sums.
+  std::vector<helayers::CTile> computeDistances(
+      const std::vector<helayers::CTile>& query) const;
+
+  // Decrypts the output of computeDistances() into one value per vector.
+  std::vector<double> decryptDistances(
+      const std::vector<helayers::CTile>& distances) const;
+
+  // Selects the k nearest vectors under encryption. Returns one ciphertext
+  // per block with the same layout as computeDistances(), holding about 1 in
+  // the slots of the k nearest vectors and about 0 in the slots of other
+  // vectors. maxDistance must bound all squared distances. gRep and fRep set
+  // the accuracy of the approximate comparisons, see
+  // FunctionEvaluator::compare(). Every selected vector costs about
+  // 2 * getNumBlocks() + log2(getVectorsPerCiphertext()) comparisons.
+  std::vector<helayers::CTile> computeTopK(
+      const std::vector<helayers::CTile>& distances,
+      int k,
+      double maxDistance,
+      int gRep = 4,
+      int fRep = 1) const;
+
+  // Returns how close to the minimum a distance must be for computeTopK() to
+  // select it with the minimum. Vectors whose distances are within this of
+  // the k-th smallest distance may or may not be selected, so that fewer or
+  // more than k vectors may be selected when such near-ties exist.
+  static double getTolerance(double maxDistance) { return maxDistance / 500; }
+
+  // Decrypts the output of computeTopK() into the indices of the selected
+  // vectors.
+  std::vector<int> decryptTopK(const std::vector<helayers::CTile>& mask) const;
+};
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/openfhe/OpenFheCkksContext.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "KnnSearch.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Search options
+vector<int> sizes = {10000};
+int dim = 128;
+int groupSize = 8;
+int topK = 0;
+int gRep = 4;
+int fRep = 1;
+uint64_t seed = 17;
+
+// Context options
+bool mockupContext = false;
+int numSlots = pow(2, 14);
+
+void help()
+{
+  cout << "Usage: ./knn_search [ additional optional parameters ]" << endl;
+  cout << endl;
+  cout << "Search options:" << endl;
+  cout << "--vectors <list>\tcomma separated database sizes to benchmark "
+          "(default: 10000)."
+       << endl;
+  cout << "--dim n\t\t\tvector dimension, a power of 2 (default: 128)."
+       << endl;
+  cout << "--group n\t\tslots per vector in each ciphertext, a power of 2 "
+          "up to dim (default: 8)."
+       << endl;
+  cout << "--top_k n\t\talso select the n nearest vectors under encryption "
+          "(default: 0)."
+       << endl;
+  cout << "--f_rep n, --g_rep n\taccuracy of the comparisons of --top_k."
+       << endl;
+  cout << "--seed n\t\tseed of the generated vectors (default: 17)." << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--mockup\t\truns the example with a mockup context for simulation."
+       << endl;
+  cout << "--slots n\t\tsets the number of slots in the HE context." << endl;
+  exit(1);
+}
+
+shared_ptr<HeContext> initContext()
+{
+  // Distances need a single multiplication. Selecting the top-k compares
+  // values many times, which requires bootstrapping.
+  HeConfigRequirement req =
+      topK > 0 ? HeConfigRequirement(numSlots, 20, 42, 7)
+               : HeConfigRequirement(numSlots, 1, 40, 10);
+  if (topK > 0) {
+    req.bootstrappable = true;
+    req.automaticBootstrapping = true;
+    BootstrapConfig bsConfig;
+    bsConfig.range = EXTENDED_RANGE;
+    req.bootstrapConfig = bsConfig;
+  }
+  // Only the rotations the search uses get keys.
+  KnnSearch::setRotationSteps(req, groupSize, topK > 0);
+
+  shared_ptr<HeContext> he = make_shared<OpenFheCkksContext>();
+  if (mockupContext) {
+    shared_ptr<MockupContext> mockup = make_shared<MockupContext>();
+    mockup->setEstimatedMeasures(he->getEstimatedMeasures());
+    he = mockup;
+    req.securityLevel = 0;
+    if (topK > 0) {
+      req.bootstrapConfig = BootstrapConfig();
+      req.bootstrapConfig->targetChainIndex = 12;
+      req.bootstrapConfig->minChainIndexForBootstrapping = 3;
+    }
+  }
+  he->init(req);
+  if (topK > 0)
+    he->setAutomaticBootstrapping(true);
+  return he;
+}
+
+// Random vectors of norm at most 1, so squared distances are at most 4.
+vector<vector<double>> generateVectors(mt19937_64& rng, int num)
+{
+  normal_distribution<double> normal(0, 1);
+  uniform_real_distribution<double> uniform(0, 1);
+  vector<vector<double>> res(num, vector<double>(dim));
+  for (auto& vec : res) {
+    double norm = 0;
+    for (double& x : vec) {
+      x = normal(rng);
+      norm += x * x;
+    }
+    double scale = uniform(rng) / sqrt(norm);
+    for (double& x : vec)
+      x *= scale;
+  }
+  return res;
+}
+
+double squaredDistance(const vector<double>& a, const vector<double>& b)
+{
+  double res = 0;
+  for (size_t i = 0; i < a.size(); ++i)
+    res += (a[i] - b[i]) * (a[i] - b[i]);
+  return res;
+}
+
+struct RunResult
+{
+  int vectors;
+  int ciphertexts;
+  double encryptSeconds;
+  double searchSeconds;
+  double topKSeconds;
+  double maxError;
+  bool topKCorrect;
+  long ramMb;
+};
+
+double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+RunResult runSearch(HeContext& he, int numVectors)
+{
+  cout << endl << "*** " << numVectors << " vectors ***" << endl;
+  mt19937_64 rng(seed);
+  vector<vector<double>> vectors = generateVectors(rng, numVectors);
+  // The query is close to one of the vectors.
+  vector<double> query = vectors[numVectors / 2];
+  for (double& x : query)
+    x += 0.01;
+
+  RunResult res;
+  res.vectors = numVectors;
+
+  KnnSearch search(he, dim, groupSize);
+  cout << "Encrypting the database . . ." << endl;
+  auto start = chrono::high_resolution_clock::now();
+  search.encryptDatabase(vectors);
+  res.encryptSeconds = secondsSince(start);
+  res.ciphertexts = search.getNumBlocks() * search.getNumGroups();
+
+  vector<CTile> encryptedQuery = search.encryptQuery(query);
+
+  cout << "Computing distances . . ." << endl;
+  start = chrono::high_resolution_clock::now();
+  vector<CTile> distances = search.computeDistances(encryptedQuery);
+  res.searchSeconds = secondsSince(start);
+
+  vector<double> plainDistances(numVectors);
+  for (int i = 0; i < numVectors; ++i)
+    plainDistances[i] = squaredDistance(vectors[i], query);
+
+  vector<double> decrypted = search.decryptDistances(distances);
+  res.maxError = 0;
+  for (int i = 0; i < numVectors; ++i)
+    res.maxError = max(res.maxError, abs(decrypted[i] - plainDistances[i]));
+
+  res.topKSeconds = 0;
+  res.topKCorrect = true;
+  if (topK > 0) {
+    cout << "Selecting the " << topK << " nearest vectors . . ." << endl;
+    start = chrono::high_resolution_clock::now();
+    vector<CTile> mask = search.computeTopK(distances, topK, 4, gRep, fRep);
+    res.topKSeconds = secondsSince(start);
+
+    vector<int> selected = search.decryptTopK(mask);
+    vector<double> sorted = plainDistances;
+    nth_element(sorted.begin(), sorted.begin() + topK - 1, sorted.end());
+    double kth = sorted[topK - 1];
+    // Vectors within the tolerance of the k-th distance may go either way,
+    // all others must be selected if and only if they are nearer.
+    double tolerance = KnnSearch::getTolerance(4);
+    vector<bool> isSelected(numVectors, false);
+    for (int i : selected)
+      isSelected[i] = true;
+    res.topKCorrect = true;
+    for (int i = 0; i < numVectors; ++i)
+      if (isSelected[i] ? plainDistances[i] > kth + tolerance
+                        : plainDistances[i] < kth - tolerance)
+        res.topKCorrect = false;
+    cout << "Selected:";
+    for (int i : selected)
+      cout << " " << i;
+    cout << (res.topKCorrect ? " (correct)" : " (expected different vectors)")
+         << endl;
+  }
+  res.ramMb = MemoryUtils::getUsedRam();
+  return res;
+}
+
+vector<int> parseList(const string& list)
+{
+  vector<int> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(stoi(item));
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--vectors" && i < argc)
+      sizes = parseList(argv[i++]);
+    else if (arg == "--dim" && i < argc)
+      dim = stoi(argv[i++]);
+    else if (arg == "--group" && i < argc)
+      groupSize = stoi(argv[i++]);
+    else if (arg == "--top_k" && i < argc)
+      topK = stoi(argv[i++]);
+    else if (arg == "--g_rep" && i < argc)
+      gRep = stoi(argv[i++]);
+    else if (arg == "--f_rep" && i < argc)
+      fRep = stoi(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--mockup")
+      mockupContext = true;
+    else if (arg == "--slots" && i < argc)
+      numSlots = stoi(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+
+  shared_ptr<HeContext> he = initContext();
+  he->printSignature(cout);
+  cout << "Dimension: " << dim << ", slots per vector: " << groupSize
+       << ", query ciphertexts: " << dim / groupSize << endl;
+
+  vector<RunResult> results;
+  for (int numVectors : sizes)
+    results.push_back(runSearch(*he, numVectors));
+
+  cout << endl;
+  cout << "   vectors  ciphertexts  encrypt (s)  distances (s)    vectors/s"
+          "   max error";
+  if (topK > 0)
+    cout << "  top-k (s)";
+  cout << "   RAM (MB)" << endl;
+  bool ok = true;
+  for (const RunResult& r : results) {
+    cout << setw(10) << r.vectors << setw(13) << r.ciphertexts << setw(13)
+         << r.encryptSeconds << setw(15) << r.searchSeconds << setw(13)
+         << r.vectors / r.searchSeconds << setw(12) << r.maxError;
+    if (topK > 0)
+      cout << setw(11) << r.topKSeconds;
+    cout << setw(11) << r.ramMb << endl;
+    ok = ok && r.topKCorrect && (mockupContext || r.maxError < 1e-3);
+  }
+  always_assert_msg(ok, "encrypted results differ from the plain ones");
+  return 0;
+}
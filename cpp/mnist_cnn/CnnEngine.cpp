@@ -0,0 +1,303 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#include "CnnEngine.h"
+
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+#include "helayers/math/TTConvolutionInterleaved.h"
+#include "helayers/math/TTEncoder.h"
+
+using namespace std;
+using namespace helayers;
+
+CnnEngine::CnnEngine(HeContext& he,
+                     int rows,
+                     int cols,
+                     int channels,
+                     int tileSize)
+    : he(he),
+      rows(rows),
+      cols(cols),
+      channels(channels),
+      tileSize(tileSize),
+      outRows(rows),
+      outCols(cols),
+      outChannels(channels)
+{
+  if (tileSize <= 0 || (tileSize & (tileSize - 1)) != 0 ||
+      he.slotCount() % (tileSize * tileSize) != 0)
+    throw invalid_argument("CnnEngine: the square of the tile size must "
+                           "divide the slot count");
+}
+
+void CnnEngine::addConv(const string& name,
+                        const DoubleTensor& filters,
+                        const DoubleTensor& biases,
+                        int stride)
+{
+  if (filters.order() != 4 || filters.getDimSize(2) != outChannels ||
+      filters.getDimSize(0) > outRows || filters.getDimSize(1) > outCols)
+    throw invalid_argument("CnnEngine: filters of " + name +
+                           " do not match the output of the previous layer");
+  if (biases.size() != filters.getDimSize(3))
+    throw invalid_argument("CnnEngine: " + name + " needs one bias per filter");
+  Layer layer;
+  layer.name = name;
+  layer.type = CONV;
+  layer.filters = filters;
+  layer.biases = biases;
+  layer.stride = stride;
+  layers.push_back(layer);
+  outRows = (outRows - filters.getDimSize(0)) / stride + 1;
+  outCols = (outCols - filters.getDimSize(1)) / stride + 1;
+  outChannels = filters.getDimSize(3);
+}
+
+void CnnEngine::addSquare(const string& name)
+{
+  Layer layer;
+  layer.name = name;
+  layer.type = SQUARE;
+  layers.push_back(layer);
+}
+
+void CnnEngine::addPoly(const string& name, const vector<double>& coefs)
+{
+  if (coefs.size() != 3)
+    throw invalid_argument("CnnEngine: " + name +
+                           " must be a polynomial of degree 2");
+  Layer layer;
+  layer.name = name;
+  layer.type = POLY;
+  layer.coefs = coefs;
+  layers.push_back(layer);
+}
+
+void CnnEngine::addAvgPool(const string& name, int poolSize)
+{
+  if (poolSize <= 0 || poolSize > outRows || poolSize > outCols)
+    throw invalid_argument("CnnEngine: pooling window of " + name +
+                           " is larger than its input");
+  Layer layer;
+  layer.name = name;
+  layer.type = AVG_POOL;
+  layer.poolSize = poolSize;
+  layers.push_back(layer);
+  outRows /= poolSize;
+  outCols /= poolSize;
+}
+
+int CnnEngine::getDepth() const
+{
+  int depth = 0;
+  for (const Layer& layer : layers)
+    // c0 + x * (c1 + c2 * x) multiplies twice.
+    depth += layer.type == POLY ? 2 : 1;
+  return depth;
+}
+
+shared_ptr<CTileTensor> CnnEngine::encryptImages(
+    const DoubleTensor& images) const
+{
+  int batch = images.getDimSize(0);
+  if (images.order() != 4 || images.getDimSize(1) != rows ||
+      images.getDimSize(2) != cols || images.getDimSize(3) != channels ||
+      batch > getBatchSize())
+    throw invalid_argument("CnnEngine: images do not match the network");
+
+  // [batch, rows, cols, channels] to [channels, rows, cols, 1, batch].
+  DoubleTensor input({channels, rows, cols, 1, batch});
+  for (int b = 0; b < batch; ++b)
+    for (int r = 0; r < rows; ++r)
+      for (int c = 0; c < cols; ++c)
+        for (int ch = 0; ch < channels; ++ch)
+          input.at(((ch * rows + r) * cols + c) * batch + b) =
+              images.at(b, r, c, ch);
+
+  TTShape baseShape{1, tileSize, tileSize, 1, getBatchSize()};
+  TTShape shape = baseShape.getWithDuplicatedDim(3);
+  shape.setOriginalSizes({channels, rows, cols, 1, batch});
+  shape.getDim(1).setInterleaved(true, 1);
+  shape.getDim(2).setInterleaved(true, 1);
+
+  TTEncoder enc(he);
+  shared_ptr<CTileTensor> res = make_shared<CTileTensor>(he);
+  enc.encodeEncrypt(*res, shape, input);
+  return res;
+}
+
+void CnnEngine::applyLayer(const Layer& layer,
+                           shared_ptr<CTileTensor>& x) const
+{
+  switch (layer.type) {
+  case CONV: {
+    TTConvConfig cc(he,
+                    x->getShape(),
+                    layer.filters.getDimSize(0),
+                    layer.filters.getDimSize(1),
+                    layer.filters.getDimSize(3),
+                    true);
+    cc.setStrides(layer.stride, layer.stride);
+    cc.setDefaultDims(true); // cxyfb = true
+    TTConvFilters cf(cc, layer.filters, layer.biases);
+    TTConvolutionInterleaved conv(x, cf);
+    x = make_shared<CTileTensor>(conv.getConvolution());
+    break;
+  }
+  case SQUARE:
+    x->square();
+    break;
+  case POLY: {
+    CTileTensor factor(*x);
+    factor.multiplyScalar(layer.coefs[2]);
+    factor.addScalar(layer.coefs[1]);
+    x->multiply(factor);
+    x->addScalar(layer.coefs[0]);
+    break;
+  }
+  case AVG_POOL: {
+    // Sum pooling is a convolution without filters.
+    TTConvConfig cc(
+        he, x->getShape(), layer.poolSize, layer.poolSize, 0, false);
+    cc.setStrides(layer.poolSize, layer.poolSize);
+    cc.setDefaultDims(true);
+    TTConvFilters cf(cc);
+    TTConvolutionInterleaved sumPool(x, cf);
+    x = make_shared<CTileTensor>(sumPool.getConvolution());
+    x->multiplyScalar(1.0 / (layer.poolSize * layer.poolSize));
+    break;
+  }
+  }
+}
+
+void CnnEngine::predict(shared_ptr<CTileTensor>& x)
+{
+  layerSeconds.resize(layers.size(), 0);
+  for (size_t i = 0; i < layers.size(); ++i) {
+    HELAYERS_TIMER_PUSH(layers[i].name);
+    auto start = chrono::high_resolution_clock::now();
+    applyLayer(layers[i], x);
+    layerSeconds[i] += chrono::duration<double>(
+                           chrono::high_resolution_clock::now() - start)
+                           .count();
+    HELAYERS_TIMER_POP();
+  }
+}
+
+DoubleTensor CnnEngine::decryptOutput(const CTileTensor& x,
+                                      int numImages) const
+{
+  TTEncoder enc(he);
+  // [outputs, 1, 1, 1, batch]
+  DoubleTensor output = enc.decryptDecodeDouble(x);
+  int batch = output.getDimSize(4);
+  DoubleTensor res({numImages, outChannels});
+  for (int b = 0; b < numImages; ++b)
+    for (int o = 0; o < outChannels; ++o)
+      res.at(b, o) = output.at(o * batch + b);
+  return res;
+}
+
+DoubleTensor CnnEngine::predictPlain(const DoubleTensor& images) const
+{
+  int batch = images.getDimSize(0);
+  int r = rows, c = cols, ch = channels;
+  DoubleTensor x = images;
+  for (const Layer& layer : layers) {
+    switch (layer.type) {
+    case CONV: {
+      int fr = layer.filters.getDimSize(0);
+      int fc = layer.filters.getDimSize(1);
+      int nf = layer.filters.getDimSize(3);
+      int s = layer.stride;
+      int nr = (r - fr) / s + 1, nc = (c - fc) / s + 1;
+      DoubleTensor y({batch, nr, nc, nf});
+      for (int b = 0; b < batch; ++b)
+        for (int i = 0; i < nr; ++i)
+          for (int j = 0; j < nc; ++j)
+            for (int f = 0; f < nf; ++f) {
+              double sum = layer.biases.at(f);
+              for (int di = 0; di < fr; ++di)
+                for (int dj = 0; dj < fc; ++dj)
+                  for (int k = 0; k < ch; ++k)
+                    sum += x.at(b, i * s + di, j * s + dj, k) *
+                           layer.filters.at(di, dj, k, f);
+              y.at(b, i, j, f) = sum;
+            }
+      x = y;
+      r = nr;
+      c = nc;
+      ch = nf;
+      break;
+    }
+    case SQUARE:
+    case POLY: {
+      vector<double> coefs =
+          layer.type == SQUARE ? vector<double>{0, 0, 1} : layer.coefs;
+      for (int i = 0; i < x.size(); ++i)
+        x.at(i) = coefs[0] + x.at(i) * (coefs[1] + coefs[2] * x.at(i));
+      break;
+    }
+    case AVG_POOL: {
+      int p = layer.poolSize;
+      DoubleTensor y({batch, r / p, c / p, ch});
+      for (int b = 0; b < batch; ++b)
+        for (int i = 0; i < r / p; ++i)
+          for (int j = 0; j < c / p; ++j)
+            for (int k = 0; k < ch; ++k) {
+              double sum = 0;
+              for (int di = 0; di < p; ++di)
+                for (int dj = 0; dj < p; ++dj)
+                  sum += x.at(b, i * p + di, j * p + dj, k);
+              y.at(b, i, j, k) = sum / (p * p);
+            }
+      x = y;
+      r /= p;
+      c /= p;
+      break;
+    }
+    }
+  }
+  x.reshape({batch, r * c * ch});
+  return x;
+}
+
+void CnnEngine::printLayerTimes(ostream& out, int numImages) const
+{
+  double total = 0;
+  for (double seconds : layerSeconds)
+    total += seconds;
+  out << "layer             time (s)   per image (ms)    share" << endl;
+  for (size_t i = 0; i < layerSeconds.size(); ++i)
+    out << left << setw(12) << layers[i].name << right << setw(14)
+        << layerSeconds[i] << setw(17) << layerSeconds[i] * 1000 / numImages
+        << setw(8) << lround(100 * layerSeconds[i] / total) << "%" << endl;
+  out << left << setw(12) << "total" << right << setw(14) << total << setw(17)
+      << total * 1000 / numImages << endl;
+}
@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+
+#ifndef CNN_ENGINE_H_
+#define CNN_ENGINE_H_
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "helayers/hebase/hebase.h"
+#include "helayers/math/CTileTensor.h"
+#include "helayers/math/DoubleTensor.h"
+
+// Inference of a convolutional network over encrypted batches of images.
+//
+// A batch of images is encrypted as a tile tensor of shape
+// [channels, rows, cols, 1, batch], in tiles of tileSize x tileSize pixels of
+// slotCount / tileSize^2 images. The row and column dimensions are
+// interleaved, so TTConvolutionInterleaved computes a convolution or a
+// pooling window of all the images of a tile with rotations and SIMD
+// additions, without moving images between ciphertexts. The batch dimension
+// is never reduced, so the whole network runs on all the images of a batch at
+// once and its cost per image drops as the batch grows.
+//
+// Supported layers are convolutions with real filters and biases (a dense
+// layer is a convolution whose filters cover its whole input), polynomial
+// activations of degree 2, and average pooling.
+class CnnEngine
+{
+public:
+  enum LayerType
+  {
+    CONV,
+    SQUARE,
+    POLY,
+    AVG_POOL
+  };
+
+  struct Layer
+  {
+    std::string name;
+    LayerType type;
+    // CONV: filters of shape [rows, cols, channels, filters], one bias per
+    // filter.
+    helayers::DoubleTensor filters;
+    helayers::DoubleTensor biases;
+    int stride = 1;
+    // POLY: c0 + c1 * x + c2 * x^2.
+    std::vector<double> coefs;
+    // AVG_POOL: the window size, also its stride.
+    int poolSize = 0;
+  };
+
+private:
+  helayers::HeContext& he;
+  int rows;
+  int cols;
+  int channels;
+  int tileSize;
+  // The output shape of the last layer added.
+  int outRows;
+  int outCols;
+  int outChannels;
+  std::vector<Layer> layers;
+  // Prediction time per layer, summed over all calls to predict().
+  std::vector<double> layerSeconds;
+
+  void applyLayer(const Layer& layer,
+                  std::shared_ptr<helayers::CTileTensor>& x) const;
+
+public:
+  // Images have the given number of rows, columns and channels. tileSize
+  // must be a power of 2 whose square divides the slot count.
+  CnnEngine(helayers::HeContext& he,
+            int rows,
+            int cols,
+            int channels,
+            int tileSize = 16);
+
+  void addConv(const std::string& name,
+               const helayers::DoubleTensor& filters,
+               const helayers::DoubleTensor& biases,
+               int stride = 1);
+  void addSquare(const std::string& name);
+  void addPoly(const std::string& name, const std::vector<double>& coefs);
+  void addAvgPool(const std::string& name, int poolSize);
+
+  const std::vector<Layer>& getLayers() const { return layers; }
+
+  // Returns the multiplication depth of predict().
+  int getDepth() const;
+
+  // Returns the number of images encrypted in every ciphertext.
+  int getBatchSize() const { return he.slotCount() / (tileSize * tileSize); }
+
+  // Encrypts images of shape [batch, rows, cols, channels], with up to
+  // getBatchSize() images.
+  std::shared_ptr<helayers::CTileTensor> encryptImages(
+      const helayers::DoubleTensor& images) const;
+
+  // Runs all layers on x, replacing it with the output.
+  void predict(std::shared_ptr<helayers::CTileTensor>& x);
+
+  // Decrypts the output of predict() for numImages images into a tensor of
+  // shape [numImages, outputs].
+  helayers::DoubleTensor decryptOutput(const helayers::CTileTensor& x,
+                                       int numImages) const;
+
+  // Runs the network in plain on images of shape [batch, rows, cols,
+  // channels]. Returns a tensor of shape [batch, outputs].
+  helayers::DoubleTensor predictPlain(
+      const helayers::DoubleTensor& images) const;
+
+  // Prints the prediction time of every layer, and per image over
+  // numImages images.
+  void printLayerTimes(std::ostream& out, int numImages) const;
+};
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <H5Cpp.h>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "helayers/ai/DatasetPlain.h"
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "CnnEngine.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Inference options
+int numBatches = 1;
+int tileSize = 16;
+bool randomWeights = false;
+bool pooling = false;
+uint64_t seed = 17;
+
+// Context options
+bool mockupContext = false;
+int numSlots = pow(2, 14);
+
+// The network of python/notebooks/09_Neural_network_MNIST.ipynb, on images of
+// 28x28 pixels padded to 29x29.
+const int imageSize = 29;
+const int numClasses = 10;
+
+void help()
+{
+  cout << "Usage: ./mnist_cnn [ additional optional parameters ]" << endl;
+  cout << endl;
+  cout << "Inference options:" << endl;
+  cout << "--batches n\t\tnumber of encrypted batches to predict (default: 1)."
+       << endl;
+  cout << "--tile n\t\ttile size in pixels, a power of 2; every ciphertext "
+          "holds slots/n^2 images (default: 16)."
+       << endl;
+  cout << "--random\t\tuses random weights instead of the trained model."
+       << endl;
+  cout << "--pool\t\t\tadds a 2x2 average pooling layer (implies --random)."
+       << endl;
+  cout << "--seed n\t\tseed of the random weights and images (default: 17)."
+       << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--mockup\t\truns the example with a mockup context for simulation."
+       << endl;
+  cout << "--slots n\t\tsets the number of slots in the HE context." << endl;
+  exit(1);
+}
+
+// Reads the weights of a Keras model, in the order of the layers. The
+// weights of every layer are sorted by name, so that its bias comes before
+// its kernel.
+void readWeights(const H5::Group& group, vector<DoubleTensor>& weights)
+{
+  for (hsize_t i = 0; i < group.getNumObjs(); ++i) {
+    string name = group.getObjnameByIdx(i);
+    if (group.getObjTypeByIdx(i) == H5G_GROUP) {
+      readWeights(group.openGroup(name), weights);
+      continue;
+    }
+    H5::DataSet dataset = group.openDataSet(name);
+    H5::DataSpace space = dataset.getSpace();
+    vector<hsize_t> dims(space.getSimpleExtentNdims());
+    space.getSimpleExtentDims(dims.data());
+    vector<DimInt> shape(dims.begin(), dims.end());
+    DoubleTensor tensor(shape);
+    vector<double> vals(tensor.size());
+    dataset.read(vals.data(), H5::PredType::NATIVE_DOUBLE);
+    for (size_t j = 0; j < vals.size(); ++j)
+      tensor.at(j) = vals[j];
+    weights.push_back(tensor);
+  }
+}
+
+DoubleTensor randomTensor(mt19937_64& rng,
+                          const vector<DimInt>& shape,
+                          double scale)
+{
+  uniform_real_distribution<double> uniform(-scale, scale);
+  DoubleTensor res(shape);
+  for (int i = 0; i < res.size(); ++i)
+    res.at(i) = uniform(rng);
+  return res;
+}
+
+void buildNetwork(CnnEngine& engine, const string& modelFile)
+{
+  if (!randomWeights) {
+    // conv2d (bias, kernel), dense (bias, kernel), dense_1 (bias, kernel).
+    vector<DoubleTensor> weights;
+    H5::H5File file(modelFile, H5F_ACC_RDONLY);
+    readWeights(file, weights);
+    always_assert_msg(weights.size() == 6, "unexpected layers in model.h5");
+    // The dense layers are convolutions whose filters cover their input.
+    // Flatten orders the features of a 13x13x5 tensor by row, column and
+    // channel, which is the order of the filter dimensions as well.
+    weights[3].reshape({13, 13, 5, 100});
+    weights[5].reshape({1, 1, 100, numClasses});
+    engine.addConv("conv", weights[1], weights[0], 2);
+    engine.addSquare("square1");
+    engine.addConv("dense1", weights[3], weights[2]);
+    engine.addSquare("square2");
+    engine.addConv("dense2", weights[5], weights[4]);
+    return;
+  }
+
+  // Random weights of the same network, scaled to keep the values small.
+  mt19937_64 rng(seed);
+  engine.addConv("conv",
+                 randomTensor(rng, {5, 5, 1, 5}, 0.2),
+                 randomTensor(rng, {5}, 0.1),
+                 2);
+  engine.addSquare("square1");
+  int size = 13;
+  if (pooling) {
+    engine.addAvgPool("pool", 2);
+    size = 6;
+  }
+  engine.addConv("dense1",
+                 randomTensor(rng, {size, size, 5, 100}, 0.05),
+                 randomTensor(rng, {100}, 0.1));
+  engine.addSquare("square2");
+  engine.addConv("dense2",
+                 randomTensor(rng, {1, 1, 100, numClasses}, 0.1),
+                 randomTensor(rng, {numClasses}, 0.1));
+}
+
+shared_ptr<HeContext> initContext(int depth)
+{
+  shared_ptr<HeContext> he;
+  HeConfigRequirement req;
+  if (mockupContext) {
+    he = make_shared<MockupContext>();
+    req = HeConfigRequirement::insecure(numSlots, depth, 40, 12);
+  } else {
+    he = make_shared<SealCkksContext>();
+    req = HeConfigRequirement(numSlots, depth, 40, 12);
+  }
+  he->init(req);
+  return he;
+}
+
+int argmax(const DoubleTensor& scores, int row)
+{
+  int res = 0;
+  for (int c = 1; c < scores.getDimSize(1); ++c)
+    if (scores.at(row, c) > scores.at(row, res))
+      res = c;
+  return res;
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--batches" && i < argc)
+      numBatches = stoi(argv[i++]);
+    else if (arg == "--tile" && i < argc)
+      tileSize = stoi(argv[i++]);
+    else if (arg == "--random")
+      randomWeights = true;
+    else if (arg == "--pool")
+      pooling = randomWeights = true;
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--mockup")
+      mockupContext = true;
+    else if (arg == "--slots" && i < argc)
+      numSlots = stoi(argv[i++]);
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+
+  string inputPath = getDataSetsDir() + "/net_mnist";
+  if (!randomWeights && !filesystem::exists(inputPath + "/model.h5")) {
+    cout << "No trained model in " << inputPath
+         << ", using random weights (see the readme file)" << endl;
+    randomWeights = true;
+  }
+
+  // The depth is known before the context exists: every layer but the
+  // polynomial ones costs one multiplication.
+  int depth = pooling ? 6 : 5;
+  shared_ptr<HeContext> he = initContext(depth);
+  he->printSignature(cout);
+
+  CnnEngine engine(*he, imageSize, imageSize, 1, tileSize);
+  buildNetwork(engine, inputPath + "/model.h5");
+  always_assert(engine.getDepth() == depth);
+  int batchSize = engine.getBatchSize();
+  cout << "Images per batch: " << batchSize << endl;
+
+  // The test images of the notebook are repeated to fill the batches. With
+  // random weights, the images are random as well.
+  DoubleTensor images({batchSize, imageSize, imageSize, 1});
+  DoubleTensor labels;
+  if (randomWeights) {
+    mt19937_64 rng(seed + 1);
+    images = randomTensor(rng, {batchSize, imageSize, imageSize, 1}, 1);
+  } else {
+    DatasetPlain ds(16);
+    ds.loadFromH5(inputPath + "/x_test.h5",
+                  "x_test",
+                  inputPath + "/y_test.h5",
+                  "y_test");
+    DoubleTensor samples = ds.getSamples(0);
+    labels = ds.getLabels(0);
+    int sampleSize = samples.size() / 16;
+    for (int j = 0; j < images.size(); ++j)
+      images.at(j) = samples.at(j % (16 * sampleSize));
+  }
+  DoubleTensor expected = engine.predictPlain(images);
+
+  double encryptSeconds = 0, predictSeconds = 0, maxError = 0;
+  int correct = 0, agree = 0;
+  for (int b = 0; b < numBatches; ++b) {
+    cout << "Batch " << b + 1 << " of " << numBatches << " . . ." << endl;
+    auto start = chrono::high_resolution_clock::now();
+    shared_ptr<CTileTensor> x = engine.encryptImages(images);
+    encryptSeconds += chrono::duration<double>(
+                          chrono::high_resolution_clock::now() - start)
+                          .count();
+
+    start = chrono::high_resolution_clock::now();
+    engine.predict(x);
+    predictSeconds += chrono::duration<double>(
+                          chrono::high_resolution_clock::now() - start)
+                          .count();
+
+    DoubleTensor scores = engine.decryptOutput(*x, batchSize);
+    for (int j = 0; j < batchSize; ++j) {
+      for (int c = 0; c < numClasses; ++c)
+        maxError = max(maxError, abs(scores.at(j, c) - expected.at(j, c)));
+      agree += argmax(scores, j) == argmax(expected, j);
+      if (!randomWeights)
+        correct += argmax(scores, j) == argmax(labels, j % 16);
+    }
+  }
+
+  int numImages = numBatches * batchSize;
+  cout << endl;
+  engine.printLayerTimes(cout, numImages);
+  cout << endl;
+  cout << "Images: " << numImages << endl;
+  cout << "Encrypt time (s): " << encryptSeconds << endl;
+  cout << "Predict time (s): " << predictSeconds << endl;
+  cout << "Images per second: " << numImages / predictSeconds << endl;
+  cout << "Max error vs. plain inference: " << maxError << endl;
+  cout << "Predictions equal to plain inference: " << agree << "/"
+       << numImages << endl;
+  if (!randomWeights)
+    cout << "Accuracy: " << (double)correct / numImages << endl;
+  cout << "used RAM = " << MemoryUtils::getUsedRam() << " (MB)" << endl;
+  always_assert_msg(mockupContext || agree == numImages,
+                    "encrypted predictions differ from the plain ones");
+  return 0;
+}
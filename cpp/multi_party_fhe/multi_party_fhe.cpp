@@ -37,6 +37,7 @@
 #include "helayers/ai/HeModel.h"
 #include "helayers/ai/AiGlobals.h"
 #include "helayers/math/MathGlobals.h"
+#include "TraceRecorder.h"
 
 #include <vector>
 #include <numeric>
@@ -84,6 +85,9 @@ int numSamplesEachParty = 100000;
 
 bool useMockup = false;
 
+// If not empty, a Chrome trace of the protocol rounds is written to this file.
+string traceFile;
+
 shared_ptr<HeContext> getUninitializedContext();
 void setupParticipant(shared_ptr<HeContext> he,
                       const string& name,
@@ -95,8 +99,22 @@ void generateEncryptAndSaveInputs(shared_ptr<HeContext> he,
                                   shared_ptr<HeModel> lr);
 void readMessagesAndExecuteRound(shared_ptr<HeContext> he, Protocol& protocol);
 
-int main()
+int main(int argc, char* argv[])
 {
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--trace" && i < argc)
+      traceFile = argv[i++];
+    else {
+      cerr << "Usage:" << endl;
+      cerr << "     --trace FILE" << endl;
+      throw runtime_error("Unsupported argument: " + arg);
+    }
+  }
+  TraceRecorder::getInstance().setEnabled(!traceFile.empty());
+  TraceRecorder::getInstance().setThreadName("main");
+
   cout << "*** Starting multi-party FHE demo ***" << endl;
 
   // These are HE requirements shared by the participants.
@@ -121,6 +139,7 @@ int main()
 
   // ====== Initialization protocol ======
   cout << "*** Initialization protocol ***" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("init-protocol");
   FileUtils::createCleanDir(outDir);
 
   // === Alice side ===
@@ -148,6 +167,7 @@ int main()
     thBob.join();
     thServer.join();
   }
+  HELAYERS_TRACE_TIMER_POP();
   // ====== End of Initialization Protocol ======
 
   // At this point all parties have the public keys, and they can encrypt and
@@ -156,6 +176,7 @@ int main()
   // server.
 
   cout << "*** Encrypt inputs ***" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("encrypt-inputs");
 
   FileUtils::createCleanDir(outDir);
 
@@ -185,11 +206,13 @@ int main()
   // === Bob side ===
   shared_ptr<HeModel> lrBob = setupHeModel(heBob, hyperParams);
   generateEncryptAndSaveInputs(heBob, "bob", lrBob);
+  HELAYERS_TRACE_TIMER_POP();
 
   // The server initializes an empty HE model, loads Alice's and Bob's encrypted
   // inputs and trains the model.
 
   cout << "*** Train encrypted model ***" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("train");
 
   // === Server side ===
   EncryptedData ed0(*heServer), ed1(*heServer);
@@ -204,6 +227,7 @@ int main()
 
   // The server extracts the encrypted internals of the trained model.
   EncryptedData encryptedModelInternals = lrServer->getEncryptedInternals();
+  HELAYERS_TRACE_TIMER_POP();
 
   // Now, Alice and Bob wish to decrypt the model. Alice will be the
   // plaintext-aggregator (i.e., the one who gets the decrypted model first),
@@ -211,6 +235,7 @@ int main()
 
   // ====== Decryption Protocol ======
   cout << "*** Decryption protocol ***" << endl;
+  HELAYERS_TRACE_TIMER_PUSH("decrypt-protocol");
 
   // Clear the directory
   FileUtils::createCleanDir(outDir);
@@ -253,6 +278,7 @@ int main()
   // Alice gets the output
   vector<DoubleTensorCPtr> decodedModelInternals =
       decryptProtocolAlice.getOutputVectorDoubleTensorCPtr();
+  HELAYERS_TRACE_TIMER_POP();
   // ====== End of Decrypt Protocol ======
 
   // Alice uses the decoded model internals to build a plain model.
@@ -280,6 +306,11 @@ int main()
 
   FileUtils::removeDir(outDir);
 
+  if (!traceFile.empty()) {
+    TraceRecorder::getInstance().writeChromeTrace(traceFile);
+    cout << "Trace written to " << traceFile << endl;
+  }
+
   return 0;
 }
 
@@ -353,8 +384,15 @@ void generateEncryptAndSaveInputs(shared_ptr<HeContext> he,
 
 void readMessagesAndExecuteRound(shared_ptr<HeContext> he, Protocol& protocol)
 {
+  const MultiPartyConfig& mpConfig =
+      *he->getHeConfigRequirement().multiPartyConfig;
+  TraceRecorder::getInstance().setThreadName(
+      "participant " + to_string(mpConfig.participantId));
+  HELAYERS_TRACE_SECTION("round " + to_string(protocol.getCurrentRound()));
+
   vector<ProtocolMessage> inputMessages, outputMessages;
 
+  TraceRecorder::getInstance().begin("read-messages");
   // Read messages from directory (here we load every message and check its
   // metadata from the message object in memory. In other implementation we
   // can keep the metadata in the file name and save the loading of unneeded
@@ -363,8 +401,6 @@ void readMessagesAndExecuteRound(shared_ptr<HeContext> he, Protocol& protocol)
     string filename = entry.path().filename().generic_string();
 
     // Skip irrelevant messages
-    const MultiPartyConfig& mpConfig =
-        *he->getHeConfigRequirement().multiPartyConfig;
     if (filename.find("round_" + to_string(protocol.getCurrentRound()) + "_") ==
             string::npos ||
         filename.find("source_id_" + to_string(mpConfig.participantId) + "_") !=
@@ -383,11 +419,16 @@ void readMessagesAndExecuteRound(shared_ptr<HeContext> he, Protocol& protocol)
     }
   }
 
+  TraceRecorder::getInstance().end();
+
   // Execute round
+  TraceRecorder::getInstance().begin("execute-round");
   bool result = protocol.executeNextRound(outputMessages, inputMessages);
   always_assert(result == true);
+  TraceRecorder::getInstance().end();
 
   // Upload messages to directory
+  HELAYERS_TRACE_SECTION("write-messages");
   int i = 0;
   for (ProtocolMessage& message : outputMessages) {
     message.saveToFile(outDir + "/" + message.getMetadataAsString(true) +
@@ -0,0 +1,218 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 International Business Machines
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <sstream>
+
+#include "helayers/ai/AiGlobals.h"
+#include "helayers/ai/HeModel.h"
+#include "helayers/ai/logistic_regression/LogisticRegressionPlain.h"
+#include "helayers/hebase/hebase.h"
+#include "helayers/hebase/seal/SealCkksContext.h"
+#include "helayers/hebase/mockup/MockupContext.h"
+#include "helayers/hebase/utils/MemoryUtils.h"
+#include "helayers/math/TTEncoder.h"
+#include "OneHotEncoder.h"
+
+using namespace std;
+using namespace helayers;
+
+// See more information about this demo in the readme file.
+
+// Pipeline options
+int numSamples = 4096;
+vector<int> numCategories = {4, 8, 3, 6};
+uint64_t seed = 17;
+
+// Context options
+bool mockupContext = false;
+
+void help()
+{
+  cout << "Usage: ./one_hot_encoding [ additional optional parameters ]"
+       << endl;
+  cout << endl;
+  cout << "Pipeline options:" << endl;
+  cout << "--samples n\t\tnumber of samples (default: 4096)." << endl;
+  cout << "--categories <list>\tcomma separated number of categories of "
+          "every feature (default: 4,8,3,6)."
+       << endl;
+  cout << "--seed n\t\tseed of the generated samples and model (default: 17)."
+       << endl;
+  cout << endl;
+  cout << "Context options:" << endl;
+  cout << "--mockup\t\truns the example with a mockup context for simulation."
+       << endl;
+  exit(1);
+}
+
+vector<int> parseList(const string& list)
+{
+  vector<int> res;
+  stringstream ss(list);
+  string item;
+  while (getline(ss, item, ','))
+    res.push_back(stoi(item));
+  return res;
+}
+
+double secondsSince(chrono::high_resolution_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+int main(int argc, char* argv[])
+{
+  int i = 1;
+  while (i < argc) {
+    string arg = argv[i++];
+    if (arg == "--samples" && i < argc)
+      numSamples = stoi(argv[i++]);
+    else if (arg == "--categories" && i < argc)
+      numCategories = parseList(argv[i++]);
+    else if (arg == "--seed" && i < argc)
+      seed = stoull(argv[i++]);
+    else if (arg == "--mockup")
+      mockupContext = true;
+    else {
+      cout << "Unsupported argument: " << arg << endl;
+      help();
+    }
+  }
+
+  // The depth of the one-hot encoding depends only on the largest number of
+  // categories.
+  int maxCategories = 1;
+  for (int n : numCategories)
+    maxCategories = max(maxCategories, n);
+  int oneHotDepth = maxCategories == 1 ? 0 : 2 + ceil(log2(maxCategories - 1));
+  int numColumns = 0;
+  for (int n : numCategories)
+    numColumns += n;
+
+  // A random logistic regression model over the one-hot columns, as trained
+  // for example by logistic_regression_training.
+  mt19937_64 rng(seed);
+  uniform_real_distribution<double> uniform(-1, 1);
+  DoubleTensor weights({numColumns, 1, 1});
+  for (int j = 0; j < numColumns; ++j)
+    weights.at(j) = uniform(rng);
+  PlainModelHyperParams hp;
+  hp.logisticRegressionActivation(LR_ACTIVATION_SIGMOID_POLY_3_APPROXIMATION);
+  LogisticRegressionPlain lrPlain;
+  lrPlain.initFromTensor(hp, weights, uniform(rng));
+
+  // Compile the model, then again with the depth of the one-hot encoding
+  // added, since the encoding runs on the inputs of the model before predict.
+  HeRunRequirements heRunReq;
+  if (mockupContext)
+    heRunReq.setHeContextOptions({make_shared<MockupContext>()});
+  else
+    heRunReq.setHeContextOptions({make_shared<SealCkksContext>()});
+  heRunReq.optimizeForBatchSize(numSamples);
+  optional<HeProfile> profile = HeModel::compile(lrPlain, heRunReq);
+  always_assert(profile.has_value());
+  HeConfigRequirement req = profile->requirement;
+  req.multiplicationDepth += oneHotDepth;
+  if (mockupContext)
+    req.securityLevel = 0;
+  heRunReq.setExplicitHeConfigRequirement(req);
+  profile = HeModel::compile(lrPlain, heRunReq);
+  always_assert_msg(profile.has_value(),
+                    "no HE configuration fits the one-hot encoding and the "
+                    "model");
+
+  shared_ptr<HeContext> he = HeModel::createContext(*profile);
+  he->printSignature(cout);
+  shared_ptr<HeModel> lr = lrPlain.getEmptyHeModel(*he);
+  lr->encodeEncrypt(lrPlain, *profile);
+  ModelIoEncoder modelIoEncoder(*lr);
+
+  OneHotEncoder oneHot(*he, numCategories);
+  always_assert(oneHot.getDepth() == oneHotDepth);
+  cout << "Features: " << numCategories.size()
+       << ", one-hot columns: " << oneHot.getNumColumns() << endl;
+
+  // Random categorical samples.
+  vector<vector<int>> codes(numSamples);
+  for (auto& sample : codes)
+    for (int n : numCategories)
+      sample.push_back(uniform_int_distribution<int>(0, n - 1)(rng));
+
+  // Data owner: encrypt the codes with the IO encoder of the model, so that
+  // they are in the tile layout of its inputs.
+  auto start = chrono::high_resolution_clock::now();
+  EncryptedData inputs(*he);
+  modelIoEncoder.encodeEncrypt(
+      inputs, {make_shared<DoubleTensor>(oneHot.getCodesTensor(codes))});
+  double encryptSeconds = secondsSince(start);
+
+  // Server: one-hot encode the inputs in place, then predict with the model.
+  cout << "One-hot encoding . . ." << endl;
+  shared_ptr<CTileTensor> x = inputs.getCTileTensor(0);
+  start = chrono::high_resolution_clock::now();
+  oneHot.encode(*x);
+  double encodeSeconds = secondsSince(start);
+
+  TTEncoder enc(*he);
+  DoubleTensor expectedOneHot = oneHot.encodePlain(codes);
+  DoubleTensor decryptedOneHot = enc.decryptDecodeDouble(*x);
+  double oneHotError = 0;
+  for (int j = 0; j < expectedOneHot.size(); ++j)
+    oneHotError =
+        max(oneHotError, abs(decryptedOneHot.at(j) - expectedOneHot.at(j)));
+
+  cout << "Predicting . . ." << endl;
+  EncryptedData predictions(*he);
+  start = chrono::high_resolution_clock::now();
+  lr->predict(predictions, inputs);
+  double predictSeconds = secondsSince(start);
+
+  DoubleTensorCPtr scores = modelIoEncoder.decryptDecodeOutput(predictions);
+  DoubleTensorCPtr expectedScores =
+      lrPlain.predict({make_shared<DoubleTensor>(expectedOneHot)}).at(0);
+  double scoreError = 0;
+  for (int s = 0; s < numSamples; ++s)
+    scoreError = max(scoreError, abs(scores->at(s) - expectedScores->at(s)));
+
+  cout << endl;
+  cout << "Samples: " << numSamples << endl;
+  cout << "Encrypt time (s): " << encryptSeconds << endl;
+  cout << "One-hot time (s): " << encodeSeconds << endl;
+  cout << "Predict time (s): " << predictSeconds << endl;
+  cout << "One-hot / predict: " << encodeSeconds / predictSeconds << endl;
+  cout << "One-hot encodings per second: " << numSamples / encodeSeconds
+       << endl;
+  cout << "Max error of the one-hot encoding: " << oneHotError << endl;
+  cout << "Max error of the scores: " << scoreError << endl;
+  cout << "used RAM = " << MemoryUtils::getUsedRam() << " (MB)" << endl;
+  always_assert_msg(mockupContext || (oneHotError < 1e-3 && scoreError < 1e-2),
+                    "encrypted results differ from the plain ones");
+  return 0;
+}
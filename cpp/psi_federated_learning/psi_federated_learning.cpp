@@ -75,6 +75,9 @@ void help()
   cout << "--verbose\tAn optional flag sets the verbosity level to high "
           "verbosity."
        << endl;
+  cout << "--seed\tAn optional integer flag that seeds the generated UIDs, "
+          "making runs reproducible."
+       << endl;
   exit(1);
 }
 
@@ -101,6 +104,8 @@ void cleanData(DoubleTensor& data)
 int main(int argc, char* argv[])
 {
   int numSamples = DEFAULT_NUM_SAMPLES;
+  // Seed of the generated UIDs, or -1 for a random seed.
+  long long seed = -1;
 
   Verbosity verbosity = VERBOSITY_LOW;
   int i = 1;
@@ -110,6 +115,8 @@ int main(int argc, char* argv[])
       numSamples = stoi(argv[i++]);
     else if (arg == "--verbose")
       verbosity = VERBOSITY_REGULAR;
+    else if (arg == "--seed" && i < argc)
+      seed = stoll(argv[i++]);
     else
       help();
   }
@@ -140,7 +147,7 @@ int main(int argc, char* argv[])
   // hash table to the aggregator.
 
   std::random_device rd;
-  std::mt19937 gen(rd());
+  std::mt19937 gen(seed >= 0 ? seed : rd());
   std::uniform_int_distribution<> distribution(1, 2147483647);
 
   vector<uint64_t> aliceUids(numSamples);
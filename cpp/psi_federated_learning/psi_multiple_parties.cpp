@@ -53,6 +53,10 @@ const int DOUG_RTS_ID = 4;
 
 const int DEFAULT_NUM_SAMPLES = 3;
 
+// Generates the UIDs of all participants. Seeded in main(), either with the
+// --seed argument or randomly.
+mt19937 uidRng;
+
 void help()
 {
   cout << "--num_samples is an optional integer flag that sets the number of "
@@ -66,6 +70,9 @@ void help()
   cout << "--verbose\tAn optional flag sets the verbosity level to high "
           "verbosity."
        << endl;
+  cout << "--seed\tAn optional integer flag that seeds the generated UIDs, "
+          "making runs reproducible."
+       << endl;
   exit(1);
 }
 
@@ -82,15 +89,13 @@ void printHeader(int numSamples)
 
 void initRandomUids(vector<u_int64_t>& uids)
 {
-  random_device dev;
-  mt19937 rng(dev());
   uniform_int_distribution<mt19937::result_type> dist(1, 100);
 
-  uids[0] = dist(rng);
+  uids[0] = dist(uidRng);
   for (size_t i = 1; i < uids.size(); i++)
-    uids[i] = uids[i - 1] + dist(rng);
+    uids[i] = uids[i - 1] + dist(uidRng);
 
-  shuffle(uids.begin(), uids.end(), rng);
+  shuffle(uids.begin(), uids.end(), uidRng);
 }
 
 vector<uint64_t> runOtherParty(HeContext& he,
@@ -123,6 +128,7 @@ vector<uint64_t> runOtherParty(HeContext& he,
 int main(int argc, char* argv[])
 {
   int numSamples = DEFAULT_NUM_SAMPLES;
+  long long seed = -1;
 
   Verbosity verbosity = VERBOSITY_LOW;
   int i = 1;
@@ -132,9 +138,12 @@ int main(int argc, char* argv[])
       numSamples = stoi(argv[i++]);
     else if (arg == "--verbose")
       verbosity = VERBOSITY_REGULAR;
+    else if (arg == "--seed" && i < argc)
+      seed = stoll(argv[i++]);
     else
       help();
   }
+  uidRng.seed(seed >= 0 ? seed : random_device()());
 
   printHeader(numSamples);
 